@@ -1,6 +1,7 @@
 #include "AdhocStatement.h"
 #include "DatabaseEnvFwd.h"
 #include <cstdlib>
+#include <cstring>
 #include "MySQLConnection.h"
 #include "QueryResult.h"
 
@@ -8,7 +9,7 @@ namespace DATABASE
 {
 
 BasicStatementTask::BasicStatementTask(const char * sql, bool async) :
-    sql_(sql),
+    sql_(strdup(sql)),
     hasResult_(async)
 {
     if (async) 
@@ -19,6 +19,7 @@ public:
     ~BasicStatementTask();
 
     bool execute() override;
+    const char* getBatchableSql() const override { return hasResult_ ? nullptr : sql_; }
     QueryResultFuture getFuture() const { return result_->get_future(); }
 
 private:
@@ -0,0 +1,132 @@
+#include "BulkInsert.h"
+#include <type_traits>
+#include <variant>
+
+#include "MySQLConnection.h"
+
+
+namespace DATABASE
+{
+
+BulkInsertBase::BulkInsertBase(uint32_t index, uint8_t columnCount) :
+    index_(index),
+    rowCount_(0),
+    columns_(columnCount)
+{
+}
+
+
+void BulkInsertBase::reserve(std::size_t rows)
+{
+    for (auto& column : columns_)
+    {
+        column.reserve(rows);
+    }
+}
+
+
+void BulkInsertBase::addRow()
+{
+    for (auto& column : columns_)
+    {
+        column.emplace_back();
+    }
+    ++rowCount_;
+}
+
+
+void BulkInsertBase::setNull(uint8_t index)
+{
+    columns_[index].back().data = nullptr;
+}
+void BulkInsertBase::setBool(uint8_t index, bool value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setUInt8(uint8_t index, uint8_t value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setUInt16(uint8_t index, uint16_t value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setUInt32(uint8_t index, uint32_t value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setUInt64(uint8_t index, uint64_t value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setInt8(uint8_t index, int8_t value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setInt16(uint8_t index, int16_t value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setInt32(uint8_t index, int32_t value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setInt64(uint8_t index, int64_t value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setFloat(uint8_t index, float value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setDouble(uint8_t index, double value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setString(uint8_t index, std::string const& value)
+{
+    columns_[index].back().data = value;
+}
+void BulkInsertBase::setBinary(uint8_t index, std::vector<uint8_t> const& value)
+{
+    columns_[index].back().data = value;
+}
+
+
+std::size_t BulkInsertBase::estimateRowBytes(std::size_t row) const
+{
+    //每个参数有2字节的类型和1位的NULL标记 字符串和二进制还有最多9字节的长度前缀
+    std::size_t bytes = 0;
+    for (auto const& column : columns_)
+    {
+        bytes += 3;
+        std::visit([&bytes](auto const& value) {
+            using Type = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<Type, std::string> || std::is_same_v<Type, std::vector<uint8_t>>)
+                bytes += value.size() + 9;
+            else if constexpr (!std::is_same_v<Type, std::nullptr_t>)
+                bytes += sizeof(Type);
+        }, column[row].data);
+    }
+
+    return bytes;
+}
+
+
+BulkInsertTask::BulkInsertTask(BulkInsertBase* bulk) :
+    bulk_(bulk)
+{
+}
+
+BulkInsertTask::~BulkInsertTask()
+{
+    delete bulk_;
+}
+
+bool BulkInsertTask::execute()
+{
+    return conn_->ExecuteBulkInsert(bulk_);
+}
+
+
+}// namespace DATABASE
@@ -0,0 +1,109 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PreparedStatement.h"
+#include "SQLOperation.h"
+
+#define BULK_INSERT_MAX_PLACEHOLDERS 65535      //一条预处理语句最多的参数个数 由mysql协议决定
+#define BULK_INSERT_DEFAULT_PACKET (4 * 1024 * 1024)    //查不到max_allowed_packet时的默认值 mysql5.7的默认值
+#define BULK_INSERT_STATEMENT_CACHE 8           //每个连接缓存多少条不同行数的多行INSERT预处理语句
+
+/**
+* @file BulkInsert.h
+* @brief 批量插入 用多行INSERT ... VALUES (...),(...)一次插入一批数据
+*/
+
+namespace DATABASE
+{
+
+
+/**
+* @class BulkInsertBase
+* @brief 按列保存要插入的多行数据
+* @details index是一条只有一组VALUES (?, ...)的INSERT预处理语句 比如INSERT INTO mail VALUES (?, ?, ?)
+*          执行的时候复制VALUES后面的那一组 拼成多行INSERT 每一批按max_allowed_packet和65535个参数的限制切分
+*          每一批只执行一次 多于一批的时候所有批次在一个事务里 任何一批失败整体回滚
+*/
+class BulkInsertBase
+{
+public:
+    using ptr = std::shared_ptr<BulkInsertBase>;
+
+public:
+    /**
+    * @brief 构造函数
+    * @param index INSERT预处理语句的索引
+    * @param columnCount 每行的参数个数 要和预处理语句的参数个数一致
+    */
+    BulkInsertBase(uint32_t index, uint8_t columnCount);
+    virtual ~BulkInsertBase() {}
+
+    void reserve(std::size_t rows);
+
+    //添加新的一行 之后用setXXX设置这一行每一列的值
+    void addRow();
+
+    //设置最后一行第index列的值
+    void setNull(uint8_t index);
+    void setBool(uint8_t index, bool value);
+    void setUInt8(uint8_t index, uint8_t value);
+    void setUInt16(uint8_t index, uint16_t value);
+    void setUInt32(uint8_t index, uint32_t value);
+    void setUInt64(uint8_t index, uint64_t value);
+    void setInt8(uint8_t index, int8_t value);
+    void setInt16(uint8_t index, int16_t value);
+    void setInt32(uint8_t index, int32_t value);
+    void setInt64(uint8_t index, int64_t value);
+    void setFloat(uint8_t index, float value);
+    void setDouble(uint8_t index, double value);
+    void setString(uint8_t index, std::string const& value);
+    void setBinary(uint8_t index, std::vector<uint8_t> const& value);
+
+    uint32_t GetIndex() const { return index_; }
+    std::size_t GetRowCount() const { return rowCount_; }
+    std::size_t GetColumnCount() const { return columns_.size(); }
+    PreparedStatementData const& GetValue(std::size_t row, std::size_t column) const { return columns_[column][row]; }
+
+    //估计第row行在执行包里占用的字节数 用来按max_allowed_packet切分
+    std::size_t estimateRowBytes(std::size_t row) const;
+
+protected:
+    uint32_t index_;    //INSERT预处理语句的索引
+    std::size_t rowCount_;
+    std::vector<std::vector<PreparedStatementData>> columns_;   //每列一个数组
+};
+
+
+template<typename T>
+class BulkInsert : public BulkInsertBase
+{
+public:
+    BulkInsert(uint32_t index, uint8_t columnCount) : BulkInsertBase(index, columnCount)
+    {
+    }
+};
+
+
+/**
+* @class BulkInsertTask
+* @brief 在异步连接上执行批量插入 执行完之后释放数据
+*/
+class BulkInsertTask : public SQLOperation
+{
+public:
+    explicit BulkInsertTask(BulkInsertBase* bulk);
+    ~BulkInsertTask();
+
+    bool execute() override;
+
+private:
+    BulkInsertBase* bulk_;
+};
+
+
+}// namespace DATABASE
@@ -17,5 +17,9 @@ using PreparedQueryResult = std::shared_ptr<PreparedResultSet>;
 using PreparedQueryResultFuture = std::future<PreparedQueryResult>;
 using PreparedQueryResultPromise = std::promise<PreparedQueryResult>;
 
+//异步事务的结果 是否提交成功
+using TransactionFuture = std::future<bool>;
+using TransactionPromise = std::promise<bool>;
+
 
 }
\ No newline at end of file
@@ -2,13 +2,17 @@
 #include "SQLOperation.h"
 #include <fcntl.h>
 #include <thread>
+#include <utility>
+#include <vector>
 
 
 namespace DATABASE 
 {
 
-DatabaseWorker::DatabaseWorker(MysqlConnection* conn, THREADING::ProducerConsumerQueue<SQLOperation*>* sqlQueue):
+DatabaseWorker::DatabaseWorker(MysqlConnection* conn, SQLQueue* sqlQueue):
     cancel_(false),
+    idleMs_(DATABASE_WORKER_IDLE_MS),
+    idleHook_([](MysqlConnection* conn) { conn->ping(); }),
     conn_(conn),
     sqlQueue_(sqlQueue)
 {
@@ -23,6 +27,25 @@ DatabaseWorker::~DatabaseWorker()
     workerThread_.join();
 }
 
+
+void DatabaseWorker::setIdleHook(std::chrono::milliseconds idleTime, IdleHook hook)
+{
+    std::lock_guard<std::mutex> lock(hookMutex_);
+    idleHook_ = std::move(hook);
+    idleMs_ = idleHook_ ? idleTime.count() : 0;
+}
+
+
+void DatabaseWorker::onIdle()
+{
+    std::lock_guard<std::mutex> lock(hookMutex_);
+    if (idleHook_)
+    {
+        idleHook_(conn_);
+    }
+}
+
+
 void DatabaseWorker::WorkerThread()
 {
     if (!sqlQueue_) 
@@ -30,24 +53,74 @@ void DatabaseWorker::WorkerThread()
         return;
     }
 
+    std::vector<SQLOperation*> ops;
+    ops.reserve(DATABASE_WORKER_BATCH_SIZE);
 
-    while (true) 
+    //一次取出一批 只加一次锁 空闲超时调用空闲回调 队列停止之后退出
+    while (!cancel_) 
     {
-        SQLOperation *op = nullptr;
+        ops.clear();
+        int64_t idleMs = idleMs_;
+        if (idleMs <= 0)
+        {
+            if (!sqlQueue_->get(ops, DATABASE_WORKER_BATCH_SIZE))
+            {
+                break;
+            }
+        }
+        else if (!sqlQueue_->getFor(ops, DATABASE_WORKER_BATCH_SIZE, std::chrono::milliseconds(idleMs)))
+        {
+            if (cancel_ || sqlQueue_->isStopped())
+            {
+                break;
+            }
+
+            onIdle();
+            continue;
+        }
+
+        executeBatch(ops);
+    }
+}
+
 
-        if (cancel_ || sqlQueue_->get(op))
+void DatabaseWorker::executeBatch(std::vector<SQLOperation*>& ops)
+{
+    //连续的不需要结果的普通语句攒起来一起发送 遇到其他操作之前先发送 保证执行顺序
+    std::vector<const char*> sqls;
+    std::vector<SQLOperation*> batched;
+    auto flush = [&]() {
+        if (sqls.empty())
         {
+            return;
+        }
 
+        conn_->ExecuteBatch(sqls);
+        for (SQLOperation* op : batched)
+        {
+            delete op;
         }
+        sqls.clear();
+        batched.clear();
+    };
 
-        if (op) 
+    for (SQLOperation* op : ops)
+    {
+        if (const char* sql = op->getBatchableSql())
         {
-            op->setConnection(conn_);
-            op->call();
+            sqls.push_back(sql);
+            batched.push_back(op);
+            continue;
         }
 
-        op = nullptr;
+        flush();
+
+        op->setConnection(conn_);
+        op->call();
+        delete op;
     }
+
+    flush();
 }
 
 
@@ -3,9 +3,17 @@
 
 #include "MySQLConnection.h"
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 
+#define DATABASE_WORKER_BATCH_SIZE 8     //工作线程一次从队列取出的最大任务数 其中连续的普通写入合并成一次往返 太大会让其他工作线程闲着
+#define DATABASE_WORKER_IDLE_MS 30000    //队列空闲多久执行一次空闲回调 默认回调是ping保持连接
+
 namespace DATABASE
 {
 
@@ -15,18 +23,34 @@ class DatabaseWorker
 {
 public:
     using ptr = std::shared_ptr<DatabaseWorker>;
+    using IdleHook = std::function<void(MysqlConnection*)>;
 
 public:
-    DatabaseWorker(MysqlConnection* conn, THREADING::ProducerConsumerQueue<SQLOperation*>* sqlQueue);
+    DatabaseWorker(MysqlConnection* conn, SQLQueue* sqlQueue);
     ~DatabaseWorker();
 
+    /**
+    * @brief 设置空闲回调
+    * @details 队列连续空闲idleTime之后在工作线程里调用hook 一直空闲就每隔idleTime调用一次
+    *          可以用来保持连接 刷新统计之类 idleTime为0表示不调用
+    */
+    void setIdleHook(std::chrono::milliseconds idleTime, IdleHook hook);
+
 private:
     void WorkerThread();
 
+    void onIdle();
+
+    //执行一批操作 执行完之后释放
+    void executeBatch(std::vector<SQLOperation*>& ops);
+
 private:
     std::atomic<bool> cancel_;
+    std::atomic<int64_t> idleMs_;   //空闲多少毫秒调用回调 0表示不调用
+    std::mutex hookMutex_;
+    IdleHook idleHook_;
     MysqlConnection* conn_;
-    THREADING::ProducerConsumerQueue<SQLOperation*>* sqlQueue_; // sql队列
+    SQLQueue* sqlQueue_; // sql队列
     std::thread workerThread_;
 
 };    
@@ -1,5 +1,5 @@
 #include "DatabaseWorkerPool.h"
-#include "../Threading/ProducerConsumerQueue.h"
+#include "SQLQueue.h"
 #include "DatabaseEnvFwd.h"
 #include "DatabaseWorker.h"
 #include <cstddef>
@@ -15,25 +15,17 @@
 namespace DATABASE
 {
 
-class PingOperation : public SQLOperation
-{
-    //! Operation for idle delaythreads
-    bool execute() override
-    {
-        conn_->ping();
-        return true;
-    }
-};
-
-
-
 template<typename T>
 DatabaseWorkerPool<T>::DatabaseWorkerPool() :
-    queue_(new THREADING::ProducerConsumerQueue<SQLOperation*>),
+    queue_(new SQLQueue),
+    acquireTimeout_(std::chrono::milliseconds(SQL_SYNC_ACQUIRE_TIMEOUT_MS)),
     asyncThreadCount_(0),
     syncThreadCount_(0)
 {
     mysql_thread_safe();
+
+    setAgingThreshold(SQL_PRIORITY_NORMAL, std::chrono::milliseconds(SQL_NORMAL_AGING_MS));
+    setAgingThreshold(SQL_PRIORITY_BACKGROUND, std::chrono::milliseconds(SQL_BACKGROUND_AGING_MS));
 }
 
 
@@ -45,9 +37,44 @@ DatabaseWorkerPool<T>::~DatabaseWorkerPool()
 
 
 template<typename T>
-void DatabaseWorkerPool<T>::enterQueue(SQLOperation* sqlOp)
+void DatabaseWorkerPool<T>::enterQueue(SQLOperation* sqlOp, SQLPriority priority)
+{
+    sqlOp->setPriority(priority);
+    //队列已经停止 和stop清空队列时一样释放掉
+    if (!queue_->push(sqlOp))
+        delete sqlOp;
+}
+
+
+template<typename T>
+size_t DatabaseWorkerPool<T>::QueueSize(SQLPriority priority) const
 {
-    queue_->push(sqlOp);
+#ifdef USE_LOCKFREE_SQL_QUEUE
+    return priority == SQL_PRIORITY_NORMAL ? queue_->size() : 0;
+#else
+    return queue_->size(priority);
+#endif
+}
+
+
+template<typename T>
+uint64_t DatabaseWorkerPool<T>::AgedCount(SQLPriority priority) const
+{
+#ifdef USE_LOCKFREE_SQL_QUEUE
+    return 0;
+#else
+    return queue_->getAgedCount(priority);
+#endif
+}
+
+
+template<typename T>
+void DatabaseWorkerPool<T>::setAgingThreshold(SQLPriority priority, std::chrono::milliseconds threshold)
+{
+#ifndef USE_LOCKFREE_SQL_QUEUE
+    queue_->setAgingThreshold(priority, threshold.count() ?
+        std::chrono::duration_cast<SQLQueue::clock::duration>(threshold) : SQLQueue::clock::duration::max());
+#endif
 }
 
 
@@ -69,6 +96,8 @@ template<typename T>
 void DatabaseWorkerPool<T>::close()
 {
     spdlog::info("DatabaseWorkerPool:close close");
+    //先让还在等连接的同步操作返回
+    syncPool_.clear();
     connections_[IDX_ASYNC].clear();
     connections_[IDX_SYNC].clear();
 }
@@ -89,7 +118,13 @@ uint32_t DatabaseWorkerPool<T>::open()
     error = openConnections(IDX_SYNC, syncThreadCount_);
 
     if (!error)
+    {
+        for (auto& conn : connections_[IDX_SYNC])
+        {
+            syncPool_.add(conn.get());
+        }
         spdlog::info("DatabaseWorkerPool: open {} connections", asyncThreadCount_ + syncThreadCount_);
+    }
     else
         spdlog::error("DatabaseWorkerPool:open  fail");
     
@@ -103,13 +138,13 @@ uint32_t DatabaseWorkerPool<T>::openConnections(uint8_t type, uint8_t count)
 {
     for (int i = 0; i < count; ++i) 
     {
-        auto connection = [&]{
+        auto connection = [&]() -> std::unique_ptr<T> {
             switch (type) 
             {
             case IDX_SYNC:
-                return std::make_unique<T>(connectionInfo_.get());
+                return std::make_unique<T>(*connectionInfo_);
             case IDX_ASYNC:
-                return std::make_unique<T>(queue_.get(), connectionInfo_.get());
+                return std::make_unique<T>(queue_.get(), *connectionInfo_);
             default:
                 return nullptr;
             }
@@ -122,7 +157,7 @@ uint32_t DatabaseWorkerPool<T>::openConnections(uint8_t type, uint8_t count)
         }
         else
         {
-            connections_[type].push_back(std::move(connection()));
+            connections_[type].push_back(std::move(connection));
         }
     }
 
@@ -137,56 +172,67 @@ uint32_t DatabaseWorkerPool<T>::openConnections(uint8_t type, uint8_t count)
 template<typename T>
 T * DatabaseWorkerPool<T>::getFreeConnection()
 {
-    std::array<std::vector<std::unique_ptr<T>>, IDX_SIZE> connections_;
-
-    auto &conns = connections_[IDX_SYNC];
-
-    uint8_t i = 0;
-    std::size_t nums = conns.size();
-    T* connection = nullptr;
-    for (;;) 
+    std::chrono::milliseconds timeout = acquireTimeout_.load();
+    T* connection = static_cast<T*>(syncPool_.acquire(timeout));
+    if (!connection)
     {
-        connection = conns[++i%nums].get();
-        if (connection->LockIfReady()) 
-        {
-            break;
-        }
+        spdlog::error("DatabaseWorkerPool:getFreeConnection no free connection in {}ms", timeout.count());
     }
 
     return connection;
 }
 
+
+template<typename T>
+void DatabaseWorkerPool<T>::releaseConnection(T* connection)
+{
+    syncPool_.release(connection);
+}
+
+
 template<typename T>
 void DatabaseWorkerPool<T>::keepAlive()
 {
-    for (auto& conn : connections_[IDX_SYNC]) 
+    //只ping空闲的连接 有人排队的时候不占用
+    std::vector<T*> idle;
+    while (T* conn = static_cast<T*>(syncPool_.tryAcquire()))
     {
-        if (conn->LockIfReady()) 
-        {
-            conn->ping();
-            conn->Unlock();
-        }
+        idle.push_back(conn);
     }
 
-    auto const count = connections_[IDX_ASYNC].size();
-    for (uint8_t i = 0; i < count; ++i)
-        enterQueue(new PingOperation); 
+    for (T* conn : idle)
+    {
+        conn->ping();
+        syncPool_.release(conn);
+    }
+}
 
+
+template<typename T>
+void DatabaseWorkerPool<T>::setIdleHook(std::chrono::milliseconds idleTime, std::function<void(MysqlConnection*)> hook)
+{
+    for (auto& conn : connections_[IDX_ASYNC]) 
+    {
+        if (DatabaseWorker* worker = conn->getWorker())
+        {
+            worker->setIdleHook(idleTime, hook);
+        }
+    }
 }
 
 template<typename T>
-void DatabaseWorkerPool<T>::Execute(const char * sql)
+void DatabaseWorkerPool<T>::Execute(const char * sql, SQLPriority priority)
 {
     BasicStatementTask * task = new BasicStatementTask(sql);
-    enterQueue(task);
+    enterQueue(task, priority);
 }
 
 
 template<typename T>
-void DatabaseWorkerPool<T>::Execute(PreparedStatement<T>* stmt)
+void DatabaseWorkerPool<T>::Execute(PreparedStatement<T>* stmt, SQLPriority priority)
 {
     PreparedStatementTask * task = new PreparedStatementTask(stmt);
-    enterQueue(task);
+    enterQueue(task, priority);
 }
 
 
@@ -196,9 +242,13 @@ void DatabaseWorkerPool<T>::DirectExecute(const char * sql)
 {
 
     T* conn = getFreeConnection();
+    if (!conn)
+    {
+        return;
+    }
 
     conn->Execute(sql);
-    conn->Unlock();;
+    releaseConnection(conn);
 }
 
 
@@ -207,20 +257,32 @@ void DatabaseWorkerPool<T>::DirectExecute(PreparedStatement<T>* stmt)
 {
 
     T* conn = getFreeConnection();
+    if (conn)
+    {
+        conn->Execute(stmt);
+        releaseConnection(conn);
+    }
 
-    conn->Execute(stmt);
-    conn->Unlock();;
     delete stmt;
 }
 template<typename T>
 QueryResult DatabaseWorkerPool<T>::Query(char const* sql, T* connection)
 {
+    //调用者给的连接由调用者自己管理
+    T* owned = nullptr;
     if (!connection) 
     {   
-        connection = getFreeConnection();
+        connection = owned = getFreeConnection();
+        if (!connection)
+        {
+            return QueryResult(nullptr);
+        }
     }
     ResultSet* result = connection->Query(sql);
-    connection->Unlock();
+    if (owned)
+    {
+        releaseConnection(owned);
+    }
     if (!result || !result->GetRowCount() || !result->nextRow())
     {
         delete result;
@@ -235,9 +297,14 @@ PreparedQueryResult DatabaseWorkerPool<T>::Query(PreparedStatement<T>* stmt)
 {
 
     T * connection = getFreeConnection();
+    if (!connection)
+    {
+        delete stmt;
+        return PreparedQueryResult(nullptr);
+    }
     
     PreparedResultSet* result = connection->Query(stmt);
-    connection->Unlock();
+    releaseConnection(connection);
 
     delete stmt;
     if (!result  || !result->GetRowCount())
@@ -250,21 +317,80 @@ PreparedQueryResult DatabaseWorkerPool<T>::Query(PreparedStatement<T>* stmt)
 }
 
 template<typename T>
-QueryCallback DatabaseWorkerPool<T>::AsyncQuery(char const* sql)
+QueryCallback DatabaseWorkerPool<T>::AsyncQuery(char const* sql, SQLPriority priority)
 {
     BasicStatementTask * task = new BasicStatementTask(sql, true);
-    enterQueue(task);
+    //入队之后工作线程随时可能执行完并释放task 先取future
+    QueryResultFuture result = task->getFuture();
+    enterQueue(task, priority);
 
-    return QueryCallback(task->getFuture());
+    return QueryCallback(std::move(result));
 }
 
 
 template<typename T>
-QueryCallback DatabaseWorkerPool<T>::AsyncQuery(PreparedStatement<T>* stmt)
+QueryCallback DatabaseWorkerPool<T>::AsyncQuery(PreparedStatement<T>* stmt, SQLPriority priority)
 {
     PreparedStatementTask * task = new PreparedStatementTask(stmt, true);
-    enterQueue(task);
-    return QueryCallback(task->getFuture());
+    PreparedQueryResultFuture result = task->getFuture();
+    enterQueue(task, priority);
+    return QueryCallback(std::move(result));
+}
+
+
+
+template<typename T>
+void DatabaseWorkerPool<T>::CommitTransaction(typename Transaction<T>::ptr trans, SQLPriority priority)
+{
+    enterQueue(new TransactionTask(std::move(trans)), priority);
+}
+
+
+template<typename T>
+TransactionCallback DatabaseWorkerPool<T>::AsyncCommitTransaction(typename Transaction<T>::ptr trans, SQLPriority priority)
+{
+    TransactionTask * task = new TransactionTask(std::move(trans), true);
+    TransactionFuture future = task->getFuture();
+    enterQueue(task, priority);
+    return TransactionCallback(std::move(future));
+}
+
+
+template<typename T>
+bool DatabaseWorkerPool<T>::DirectCommitTransaction(typename Transaction<T>::ptr trans)
+{
+    T* conn = getFreeConnection();
+    if (!conn)
+    {
+        return false;
+    }
+
+    bool success = TransactionTask::executeWithRetry(conn, trans.get());
+    releaseConnection(conn);
+    return success;
+}
+
+
+
+template<typename T>
+void DatabaseWorkerPool<T>::ExecuteBulkInsert(BulkInsert<T>* bulk, SQLPriority priority)
+{
+    enterQueue(new BulkInsertTask(bulk), priority);
+}
+
+
+template<typename T>
+bool DatabaseWorkerPool<T>::DirectExecuteBulkInsert(BulkInsert<T>* bulk)
+{
+    bool success = false;
+    if (T* conn = getFreeConnection())
+    {
+        success = conn->ExecuteBulkInsert(bulk);
+        releaseConnection(conn);
+    }
+
+    delete bulk;
+    return success;
 }
 
 
@@ -2,20 +2,23 @@
 
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
 #include "MySQLConnection.h"
 #include "SQLOperation.h"
 #include "QueryCallback.h"
+#include "SyncConnectionPool.h"
+#include "Transaction.h"
+#include "BulkInsert.h"
 
-namespace THREADING
-{
-template<typename T>
-class ProducerConsumerQueue;
-    
-}
+#define SQL_NORMAL_AGING_MS 200         //普通优先级的操作最多等待多久就插到交互查询前面
+#define SQL_BACKGROUND_AGING_MS 2000    //后台优先级的操作最多等待多久就插队
+#define SQL_SYNC_ACQUIRE_TIMEOUT_MS 0   //同步操作等待空闲连接的超时 0表示一直等
 
 namespace DATABASE
 {
@@ -60,12 +63,43 @@ public:
     //! Prepares all prepared statements
     bool prepareStatements();
     
+    //同步连接ping一次 异步连接由工作线程在空闲的时候自己ping
     void keepAlive();
+
+    /**
+    * @brief 设置异步连接工作线程的空闲回调 替换默认的ping
+    * @param idleTime 队列空闲多久调用一次 0表示不调用
+    */
+    void setIdleHook(std::chrono::milliseconds idleTime, std::function<void(MysqlConnection*)> hook);
+
     size_t QueueSize() const { return queue_->size(); }
 
+    //某个优先级排队的操作个数 无锁队列不区分优先级 全部算作普通优先级
+    size_t QueueSize(SQLPriority priority) const;
+
+    //某个优先级因为等待超时而插队执行的次数
+    uint64_t AgedCount(SQLPriority priority) const;
+
+    /**
+    * @brief 设置某个优先级的老化时间 排在最前面的操作等待超过该时间之后先于高优先级执行
+    * @param threshold 0表示不老化
+    */
+    void setAgingThreshold(SQLPriority priority, std::chrono::milliseconds threshold);
+
+    /**
+    * @brief 设置同步操作等待空闲连接的超时
+    * @param timeout 0表示一直等 超时之后同步操作不执行 查询返回空结果
+    */
+    void setAcquireTimeout(std::chrono::milliseconds timeout) { acquireTimeout_ = timeout; }
+
+    //同步连接的等待时间和占用率 用来确定syncThreadCount
+    SyncPoolStats getSyncPoolStats() { return syncPool_.getStats(); }
+
+    void resetSyncPoolStats() { syncPool_.resetStats(); }
+
     //异步执行一条sql语句
-    void Execute(const char * sql);
-    void Execute(PreparedStatement<T>* stmt);
+    void Execute(const char * sql, SQLPriority priority = SQL_PRIORITY_NORMAL);
+    void Execute(PreparedStatement<T>* stmt, SQLPriority priority = SQL_PRIORITY_NORMAL);
 
     //在调用线程直接执行sql语句
     void DirectExecute(const char * sql);
@@ -76,25 +110,47 @@ public:
     PreparedQueryResult Query(PreparedStatement<T>* stmt);
 
     //异步查询
-    QueryCallback AsyncQuery(char const* sql);
-    QueryCallback AsyncQuery(PreparedStatement<T>* stmt);
+    QueryCallback AsyncQuery(char const* sql, SQLPriority priority = SQL_PRIORITY_NORMAL);
+    QueryCallback AsyncQuery(PreparedStatement<T>* stmt, SQLPriority priority = SQL_PRIORITY_NORMAL);
+
+    typename Transaction<T>::ptr BeginTransaction() { return std::make_shared<Transaction<T>>(); }
+
+    //异步提交事务 不关心结果
+    void CommitTransaction(typename Transaction<T>::ptr trans, SQLPriority priority = SQL_PRIORITY_NORMAL);
+
+    //异步提交事务 在逻辑线程轮询返回值的InvokeIfReady得到是否提交成功
+    TransactionCallback AsyncCommitTransaction(typename Transaction<T>::ptr trans, SQLPriority priority = SQL_PRIORITY_NORMAL);
+
+    //在调用线程用同步连接提交事务 返回是否提交成功
+    bool DirectCommitTransaction(typename Transaction<T>::ptr trans);
+
+    //异步批量插入 接管bulk 执行完之后释放
+    void ExecuteBulkInsert(BulkInsert<T>* bulk, SQLPriority priority = SQL_PRIORITY_NORMAL);
+
+    //在调用线程用同步连接批量插入 接管bulk 返回是否全部插入成功
+    bool DirectExecuteBulkInsert(BulkInsert<T>* bulk);
 private:
     uint32_t openConnections(uint8_t type, uint8_t count);
 
-    void enterQueue(SQLOperation* sqlOp);
+    void enterQueue(SQLOperation* sqlOp, SQLPriority priority = SQL_PRIORITY_NORMAL);
 
     /**
-    * @brief 获取一个空闲的连接
-    * @return 空闲的连接
-    * @details 会一直等待 直到拿到空闲的连接
+    * @brief 获取一个空闲的同步连接
+    * @return 空闲的连接 等待超时返回nullptr
+    * @details 没有空闲连接的时候按先来后到排队 用完之后调用releaseConnection归还
     */
     T * getFreeConnection();
 
+    void releaseConnection(T* connection);
+
 private:
     //所有异步sql操作放到队列里面
-    std::unique_ptr<THREADING::ProducerConsumerQueue<SQLOperation*>> queue_;
+    std::unique_ptr<SQLQueue> queue_;
     //异步连接+同步连接
     std::array<std::vector<std::unique_ptr<T>>, IDX_SIZE> connections_;
+    //同步连接的空闲列表
+    SyncConnectionPool syncPool_;
+    std::atomic<std::chrono::milliseconds> acquireTimeout_;
     //连接信息
     std::unique_ptr<MysqlConnectionInfo> connectionInfo_;
     std::vector<uint8_t> preparedStatementSize_;
@@ -1,6 +1,8 @@
+#include <cctype>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <memory>
 #include <mysql/mysqld_error.h>
 #include <mysql/errmsg.h>
@@ -14,6 +16,8 @@
 #include "QueryResult.h"
 #include "MySQLPreparedStatement.h"
 #include "DatabaseWorker.h"
+#include "Transaction.h"
+#include "BulkInsert.h"
 
 
 namespace DATABASE 
@@ -47,9 +51,11 @@ MysqlConnection::MysqlConnection(MysqlConnectionInfo& info) :
     prepareError_(false),
     mysqlHandler_(nullptr),
     connectionInfo_(info),
-    connectionFlags_(CONNECTION_SYNCH)
+    connectionFlags_(CONNECTION_SYNCH),
+    inTransaction_(false),
+    multiStatements_(false),
+    maxAllowedPacket_(0)
 {
-
 }
 
 
@@ -58,30 +64,47 @@ MysqlConnection::MysqlConnection(MysqlConnectionInfo& info) :
 * @param queue sql任务队列
 * @param info 数据库连接信息 异步
 */
-MysqlConnection::MysqlConnection(THREADING::ProducerConsumerQueue<SQLOperation*>* queue,
+MysqlConnection::MysqlConnection(SQLQueue* queue,
      MysqlConnectionInfo& info) :
     reconnecting_(false),
     prepareError_(false),
     mysqlHandler_(nullptr),
     connectionInfo_(info),
     connectionFlags_(CONNECTION_ASYNC),
-    sqlQueue_(queue)
+    sqlQueue_(queue),
+    inTransaction_(false),
+    multiStatements_(false),
+    maxAllowedPacket_(0)
 {  
-    worker_ = std::make_unique<DatabaseWorker>(this, sqlQueue_);
 }
 
 
 MysqlConnection::~MysqlConnection()
 {
+    //先停止工作线程 空闲回调里的ping不能碰到正在释放的句柄
+    worker_.reset();
     close();
 }
 
+
+void MysqlConnection::startWorker()
+{
+    if ((connectionFlags_ & CONNECTION_ASYNC) && !worker_)
+    {
+        worker_ = std::make_unique<DatabaseWorker>(this, sqlQueue_);
+    }
+}
+
 /**
 * @brief 打开数据库连接
 * @return uint32_t 连接状态
 */
 uint32_t MysqlConnection::open()
 {
+    //重连之后旧连接上预处理的多行INSERT已经失效
+    bulkStatements_.clear();
+    maxAllowedPacket_ = 0;
+
     MYSQL * mysqlInit;
     mysqlInit = mysql_init(nullptr);
     if (!mysqlInit)
@@ -130,9 +153,13 @@ uint32_t MysqlConnection::open()
         }
 
         mysql_autocommit(mysqlHandler_, 1);
+        multiStatements_ = false;
 
         //设置当前连接的默认字符集
         mysql_set_character_set(mysqlHandler_, "utf8mb4");
+
+        //连接成功之后才启动工作线程 空闲回调看到的总是打开的句柄 重连的时候工作线程已经存在
+        startWorker();
         return 0;
     }
     else
@@ -149,6 +176,7 @@ uint32_t MysqlConnection::open()
 
 void MysqlConnection::close()
 {
+    bulkStatements_.clear();
     if (mysqlHandler_) 
     {
         mysql_close(mysqlHandler_);
@@ -164,6 +192,18 @@ void MysqlConnection::close()
 * @return bool 执行结果
 */
 bool MysqlConnection::Execute(const char * sql)
+{
+    //ExecuteBatch留下的多语句要先关掉 调用者的sql不能被注入的分号拼出第二条语句
+    if (!setMultiStatements(false))
+    {
+        return false;
+    }
+
+    return _Execute(sql);
+}
+
+
+bool MysqlConnection::_Execute(const char* sql)
 {
     if (!mysqlHandler_) 
     {
@@ -177,9 +217,10 @@ bool MysqlConnection::Execute(const char * sql)
         spdlog::error("Execute sql.sql  [{}] {}", errorCode, mysql_error(mysqlHandler_));
 
         //根据错误码 处理错误 如果返回结果是true,那么尝试再次执行sql
-        if (_HandleMySQLErrno(errorCode)) 
+        //事务中不能重连之后单独重试 由ExecuteTransaction回滚整个事务
+        if (!inTransaction_ && _HandleMySQLErrno(errorCode)) 
         {
-            return Execute(sql);
+            return _Execute(sql);
         }
 
         return false;
@@ -231,7 +272,7 @@ ResultSet * MysqlConnection::Query(const char * sql)
 */
 bool MysqlConnection::_Query(char const* sql, MySQLResult** pResult, MySQLField** pFields, uint64_t* pRowCount, uint32_t* pFieldCount)
 {
-    if (!mysqlHandler_) 
+    if (!mysqlHandler_ || !setMultiStatements(false)) 
     {
         return false;
     }
@@ -453,7 +494,7 @@ bool MysqlConnection::Execute(PreparedStatementBase * base)
         uint32_t lErrno = mysql_errno(mysqlHandler_);
         spdlog::error("MysqlConnection::Execute mysql_stmt_bind_param   [ERROR]: [{}] {}", lErrno, mysql_stmt_error(msqlSTMT));
 
-        if (_HandleMySQLErrno(lErrno)) 
+        if (!inTransaction_ && _HandleMySQLErrno(lErrno)) 
         {
             return Execute(base);
         }
@@ -467,7 +508,7 @@ bool MysqlConnection::Execute(PreparedStatementBase * base)
         uint32_t lErrno = mysql_errno(mysqlHandler_);
         spdlog::error("MysqlConnection::Execute mysql_stmt_execute   [ERROR]: [{}] {}", lErrno, mysql_stmt_error(msqlSTMT));
 
-        if (_HandleMySQLErrno(lErrno)) 
+        if (!inTransaction_ && _HandleMySQLErrno(lErrno)) 
         {
             return Execute(base);
         }
@@ -484,16 +525,457 @@ bool MysqlConnection::Execute(PreparedStatementBase * base)
 
 
 
+std::size_t MysqlConnection::ExecuteBatch(std::vector<const char*> const& sqls)
+{
+    std::size_t failed = 0;
+    std::size_t next = 0;
+    std::string batch;
+
+    while (next < sqls.size()) 
+    {
+        //多语句已经打开的时候两条就可以合并 还没打开的时候语句太少 打开的往返省不回来
+        std::size_t remaining = sqls.size() - next;
+        bool worthBatching = remaining > 1 && (multiStatements_ || remaining >= SQL_BATCH_MIN_STATEMENTS);
+
+        //逐条执行的语句和合并发送的是同一批 不需要为它们关掉多语句
+        if (!(connectionFlags_ & CONNECTION_ASYNC) || !worthBatching || !mysqlHandler_ || !setMultiStatements(true)) 
+        {
+            failed += _Execute(sqls[next++]) ? 0 : 1;
+            continue;
+        }
+
+        //拼接语句 去掉结尾的分号和空白 否则会出现空语句
+        batch.clear();
+        std::size_t count = 0;
+        for (std::size_t i = next; i < sqls.size(); ++i) 
+        {
+            std::size_t length = strlen(sqls[i]);
+            while (length && (sqls[i][length - 1] == ';' || isspace((unsigned char)sqls[i][length - 1])))
+            {
+                --length;
+            }
+
+            if (count && batch.size() + length + 2 > SQL_BATCH_MAX_BYTES) 
+            {
+                break;
+            }
+
+            if (count)
+            {
+                batch.append(";\n");
+            }
+            batch.append(sqls[i], length);
+            ++count;
+        }
+
+        //第几条语句失败了 count表示全部成功
+        std::size_t errorIndex = count;
+        uint32_t errorCode = 0;
+        if (mysql_real_query(mysqlHandler_, batch.data(), batch.size())) 
+        {
+            errorIndex = 0;
+            errorCode = mysql_errno(mysqlHandler_);
+        }
+        else
+        {
+            //每条语句一个结果 读完所有结果之后连接才能执行下一条命令
+            for (std::size_t i = 0; ; ++i) 
+            {
+                if (MYSQL_RES* result = mysql_store_result(mysqlHandler_)) 
+                {
+                    mysql_free_result(result);
+                }
+
+                int status = mysql_next_result(mysqlHandler_);
+                if (status > 0) 
+                {
+                    errorIndex = i + 1;
+                    errorCode = mysql_errno(mysqlHandler_);
+                    break;
+                }
+
+                if (status < 0) 
+                {
+                    break;
+                }
+            }
+        }
+
+        if (errorIndex == count) 
+        {
+            spdlog::debug("MysqlConnection::ExecuteBatch succ {} statements", count);
+            next += count;
+            continue;
+        }
+
+        char const* sql = sqls[next + errorIndex];
+        spdlog::error("ExecuteBatch sql.sql SQL: {}", sql);
+        spdlog::error("ExecuteBatch sql.sql  [{}] {}", errorCode, mysql_error(mysqlHandler_));
+
+        //失败之前的语句已经执行了 重连成功的话从失败的语句重新开始 否则跳过它
+        //新的连接没有打开多语句 下一轮重新打开
+        next += errorIndex;
+        if (!_HandleMySQLErrno(errorCode)) 
+        {
+            ++failed;
+            ++next;
+        }
+    }
+
+    return failed;
+}
+
+
+bool MysqlConnection::setMultiStatements(bool enable)
+{
+    if (multiStatements_ == enable)
+    {
+        return true;
+    }
+
+    if (!mysqlHandler_)
+    {
+        return false;
+    }
+
+    if (mysql_set_server_option(mysqlHandler_, enable ? MYSQL_OPTION_MULTI_STATEMENTS_ON : MYSQL_OPTION_MULTI_STATEMENTS_OFF))
+    {
+        uint32_t errorCode = mysql_errno(mysqlHandler_);
+        spdlog::warn("MysqlConnection::setMultiStatements({}) failed [{}] {}", enable, errorCode, mysql_error(mysqlHandler_));
+
+        //连接断开的话重连 新的连接默认就是关闭的
+        if (!enable && !inTransaction_ && _HandleMySQLErrno(errorCode))
+        {
+            return !multiStatements_;
+        }
+        return false;
+    }
+
+    multiStatements_ = enable;
+    return true;
+}
+
+
+bool MysqlConnection::ExecuteBulkInsert(BulkInsertBase* bulk)
+{
+    std::size_t rowCount = bulk->GetRowCount();
+    std::size_t columnCount = bulk->GetColumnCount();
+    if (!rowCount)
+    {
+        return true;
+    }
+
+    if (!mysqlHandler_ || !columnCount)
+    {
+        return false;
+    }
+
+    //留出语句头和参数类型表的余量
+    std::size_t packetBudget = getMaxAllowedPacket() * 3 / 4;
+    std::size_t maxRows = BULK_INSERT_MAX_PLACEHOLDERS / columnCount;
+
+    //先把每一批的行数算出来 多于一批的时候放在一个事务里
+    std::vector<std::size_t> chunks;
+    for (std::size_t row = 0; row < rowCount; )
+    {
+        std::size_t rows = 0;
+        std::size_t bytes = 0;
+        while (row + rows < rowCount && rows < maxRows)
+        {
+            std::size_t rowBytes = bulk->estimateRowBytes(row + rows);
+            if (rows && bytes + rowBytes > packetBudget)
+            {
+                break;
+            }
+            bytes += rowBytes;
+            ++rows;
+        }
+
+        chunks.push_back(rows);
+        row += rows;
+    }
+
+    //多批的时候COMMIT不能重连之后单独重试 否则前面的批次已经随旧连接回滚 COMMIT却返回成功
+    bool transaction = chunks.size() > 1;
+    if (transaction)
+    {
+        inTransaction_ = true;
+        if (!Execute("START TRANSACTION"))
+        {
+            rollbackTransaction(getLastError());
+            return false;
+        }
+    }
+
+    std::size_t firstRow = 0;
+    for (std::size_t rows : chunks)
+    {
+        MySQLPreparedStatement* pMysqlStmt = getBulkStatement(bulk->GetIndex(), columnCount, rows);
+        if (!pMysqlStmt)
+        {
+            if (transaction)
+            {
+                rollbackTransaction(getLastError());
+            }
+            return false;
+        }
+
+        pMysqlStmt->bindRows(bulk, firstRow, rows);
+        MYSQL_STMT* msqlSTMT = pMysqlStmt->getSTMT();
+        MYSQL_BIND* msqlBIND = pMysqlStmt->getBind();
+
+        if (mysql_stmt_bind_param(msqlSTMT, msqlBIND) || mysql_stmt_execute(msqlSTMT))
+        {
+            uint32_t lErrno = mysql_stmt_errno(msqlSTMT);
+            spdlog::error("MysqlConnection::ExecuteBulkInsert rows {}-{} [ERROR]: [{}] {}", 
+                firstRow, firstRow + rows, lErrno, mysql_stmt_error(msqlSTMT));
+            pMysqlStmt->clearParameters();
+
+            //重连之后前面的批次已经随旧连接回滚 不在这里重试 由调用者决定
+            if (transaction)
+            {
+                rollbackTransaction(lErrno);
+            }
+            else
+            {
+                _HandleMySQLErrno(lErrno);
+            }
+            return false;
+        }
+
+        pMysqlStmt->clearParameters();
+        firstRow += rows;
+    }
+
+    if (transaction)
+    {
+        if (!Execute("COMMIT"))
+        {
+            rollbackTransaction(getLastError());
+            return false;
+        }
+        inTransaction_ = false;
+    }
+
+    spdlog::debug("MysqlConnection::ExecuteBulkInsert SUCC index {} rows {} chunks {}", bulk->GetIndex(), rowCount, chunks.size());
+    return true;
+}
+
+
+uint64_t MysqlConnection::getMaxAllowedPacket()
+{
+    if (maxAllowedPacket_)
+    {
+        return maxAllowedPacket_;
+    }
+
+    maxAllowedPacket_ = BULK_INSERT_DEFAULT_PACKET;
+    if (mysqlHandler_ && !mysql_query(mysqlHandler_, "SELECT @@max_allowed_packet"))
+    {
+        if (MYSQL_RES* result = mysql_store_result(mysqlHandler_))
+        {
+            MYSQL_ROW row = mysql_fetch_row(result);
+            if (row && row[0])
+            {
+                maxAllowedPacket_ = strtoull(row[0], nullptr, 10);
+            }
+            mysql_free_result(result);
+        }
+    }
+
+    return maxAllowedPacket_;
+}
+
+
+MySQLPreparedStatement* MysqlConnection::getBulkStatement(uint32_t index, std::size_t columnCount, std::size_t rowCount)
+{
+    auto key = std::make_pair(index, rowCount);
+    auto it = bulkStatements_.find(key);
+    if (it != bulkStatements_.end())
+    {
+        return it->second.get();
+    }
+
+    MySQLPreparedStatement* single = index < preparedStatements_.size() ? GetPreparedStatement(index) : nullptr;
+    if (!single)
+    {
+        spdlog::error("MysqlConnection::getBulkStatement statement {} is not prepared on this connection", index);
+        return nullptr;
+    }
+
+    //找到VALUES后面的那一组括号 复制rowCount次 前后的部分保持不变 比如ON DUPLICATE KEY UPDATE
+    std::string const& sql = single->getQueryString();
+    std::string upper(sql);
+    for (char& c : upper)
+    {
+        c = char(toupper((unsigned char)c));
+    }
+
+    std::size_t values = upper.find("VALUES");
+    std::size_t open = values == std::string::npos ? values : sql.find('(', values);
+    std::size_t close = std::string::npos;
+    //括号里可能有NOW()之类的函数调用 按层数找配对的右括号 跳过引号里的内容
+    char quote = 0;
+    for (std::size_t i = open, depth = 0; open != std::string::npos && i < sql.size(); ++i)
+    {
+        char c = sql[i];
+        if (quote)
+        {
+            quote = c == quote ? 0 : quote;
+        }
+        else if (c == '\'' || c == '"')
+        {
+            quote = c;
+        }
+        else if (c == '(')
+        {
+            ++depth;
+        }
+        else if (c == ')' && --depth == 0)
+        {
+            close = i;
+            break;
+        }
+    }
+
+    if (close == std::string::npos || single->getParamCount() != columnCount)
+    {
+        spdlog::error("MysqlConnection::getBulkStatement statement {} is not INSERT ... VALUES (?...) with {} parameters: {}", 
+            index, columnCount, sql);
+        return nullptr;
+    }
+
+    std::string tuple = sql.substr(open, close + 1 - open);
+    std::string bulkSql = sql.substr(0, open);
+    bulkSql.reserve(sql.size() + (tuple.size() + 1) * rowCount);
+    for (std::size_t i = 0; i < rowCount; ++i)
+    {
+        if (i)
+        {
+            bulkSql.push_back(',');
+        }
+        bulkSql.append(tuple);
+    }
+    bulkSql.append(sql, close + 1, std::string::npos);
+
+    MYSQL_STMT* stmt = mysql_stmt_init(mysqlHandler_);
+    if (!stmt)
+    {
+        spdlog::error("MysqlConnection::getBulkStatement Could not initialize statement {}", mysql_error(mysqlHandler_));
+        return nullptr;
+    }
+
+    if (mysql_stmt_prepare(stmt, bulkSql.c_str(), bulkSql.size()))
+    {
+        spdlog::error("MysqlConnection::getBulkStatement prepare {} rows failed: {}", rowCount, mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+
+    //不同的行数太多的时候整个清掉 通常只有满批和最后一批两种
+    if (bulkStatements_.size() >= BULK_INSERT_STATEMENT_CACHE)
+    {
+        bulkStatements_.clear();
+    }
+
+    auto& cached = bulkStatements_[key];
+    cached = std::make_unique<MySQLPreparedStatement>(reinterpret_cast<MySQLStmt*>(stmt), bulkSql);
+    return cached.get();
+}
+
+
 void MysqlConnection::ping()
 {
+    //重连失败之后句柄可能为空 异步连接的ping和重连都在工作线程里 同步连接的ping在持有连接的线程里
+    if (!mysqlHandler_)
+    {
+        return;
+    }
+
     mysql_ping(mysqlHandler_);
 }
 
 uint32_t MysqlConnection::getLastError() const
 {
+    if (!mysqlHandler_)
+    {
+        return CR_SERVER_GONE_ERROR;
+    }
+
     return mysql_errno(mysqlHandler_);
 }
 
+
+uint32_t MysqlConnection::ExecuteTransaction(TransactionBase* transaction)
+{
+    if (transaction->sqls_.empty())
+    {
+        return 0;
+    }
+
+    //事务里的语句失败之后不重连重试 否则重连之后回到自动提交 前面的语句已经回滚 后面的语句各自提交
+    inTransaction_ = true;
+
+    if (!Execute("START TRANSACTION"))
+    {
+        return rollbackTransaction(getLastError());
+    }
+
+    for (auto const& sql : transaction->sqls_)
+    {
+        bool success = sql.type == SQL_ELEMENT_PREPARED ? 
+            Execute(sql.element.stmt) : Execute(sql.element.query);
+
+        if (!success)
+        {
+            return rollbackTransaction(getLastError());
+        }
+    }
+
+    //COMMIT返回错误的时候服务器已经回滚了 再ROLLBACK一次也没有影响
+    //但是连接断开的时候COMMIT可能已经在服务器上执行了 重放会把事务执行两次
+    if (!Execute("COMMIT"))
+    {
+        uint32_t errorCode = rollbackTransaction(getLastError());
+        return isConnectionError(errorCode) ? TRANSACTION_COMMIT_UNKNOWN : errorCode;
+    }
+
+    inTransaction_ = false;
+    return 0;
+}
+
+
+uint32_t MysqlConnection::rollbackTransaction(uint32_t errorCode)
+{
+    inTransaction_ = false;
+    errorCode = errorCode ? errorCode : CR_UNKNOWN_ERROR;
+
+    //连接断开的时候服务器已经回滚了 重连之后由调用者从START TRANSACTION开始重放整个事务
+    if (isConnectionError(errorCode))
+    {
+        _HandleMySQLErrno(errorCode);
+        return errorCode;
+    }
+
+    Execute("ROLLBACK");
+    return errorCode;
+}
+
+
+bool MysqlConnection::isConnectionError(uint32_t errNo)
+{
+    switch (errNo)
+    {
+        case CR_SERVER_GONE_ERROR:
+        case CR_SERVER_LOST:
+        case CR_SERVER_LOST_EXTENDED:
+        case CR_CONN_HOST_ERROR:
+            return true;
+        default:
+            return false;
+    }
+}
+
 /**
 * @brief 获取预处理语句
 * @param index 预处理语句的索引
@@ -595,6 +1077,8 @@ bool MysqlConnection::_HandleMySQLErrno(uint32_t errNo, uint8_t attempts)
         
         case ER_LOCK_DEADLOCK:
         //表示发生了死锁
+        case ER_LOCK_WAIT_TIMEOUT:
+        //等待行锁超时 和死锁一样由事务整体重试
         {
             return false;
         }
@@ -2,6 +2,7 @@
 
 
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -10,7 +11,11 @@
 
 #include "MySQLHacks.h"
 #include "PreparedStatement.h"
-#include "../Threading/ProducerConsumerQueue.h"
+#include "SQLQueue.h"
+
+#define SQL_BATCH_MAX_BYTES (1024 * 1024)   //合并执行的语句一次最多发送多少字节 要小于服务器的max_allowed_packet
+#define SQL_BATCH_MIN_STATEMENTS 4          //多语句还没打开的时候 至少有这么多条语句才值得多一次往返去打开
+#define TRANSACTION_COMMIT_UNKNOWN 0xFFFFFFFF   //ExecuteTransaction的返回值 COMMIT发出之后连接断开 不知道服务器有没有提交
 
 /**
 * @file MySQLConnection.h
@@ -24,6 +29,8 @@ namespace  DATABASE
 
 class DatabaseWorker;
 class ResultSet;
+class TransactionBase;
+class BulkInsertBase;
 class MySQLPreparedStatement;
 
 struct MysqlConnectionInfo
@@ -73,7 +80,7 @@ public:
     * @param queue sql任务队列
     * @param info 数据库连接信息 异步
     */
-    MysqlConnection(THREADING::ProducerConsumerQueue<SQLOperation*>* queue, MysqlConnectionInfo& connInfo);
+    MysqlConnection(SQLQueue* queue, MysqlConnectionInfo& connInfo);
 
     virtual ~MysqlConnection();
 
@@ -104,6 +111,26 @@ public:
     */
     bool Execute(PreparedStatementBase * base);
 
+    /**
+    * @brief 用尽量少的往返按顺序执行多条不需要结果的sql语句
+    * @param sqls 待执行的sql语句
+    * @return 执行失败的语句条数
+    * @details 异步连接在这里打开多语句 语句用分号拼起来一次发送 每次不超过SQL_BATCH_MAX_BYTES
+    *          打开之后一直保持 直到Execute/Query执行调用者的sql之前才关掉 所以连续的批次不用每次切换
+    *          多语句还没打开并且语句少于SQL_BATCH_MIN_STATEMENTS条的时候逐条执行 省掉切换的往返
+    *          服务器在第一条失败的语句处停下 这条语句单独报错 后面的语句接着下一次发送
+    *          同步连接逐条执行
+    */
+    std::size_t ExecuteBatch(std::vector<const char*> const& sqls);
+
+    /**
+    * @brief 用多行INSERT插入bulk的所有行
+    * @return 是否全部插入成功
+    * @details 每一批的行数受参数个数和max_allowed_packet限制 每一批执行一次
+    *          多于一批的时候在一个事务里执行 失败的时候全部回滚
+    */
+    bool ExecuteBulkInsert(BulkInsertBase* bulk);
+
     /**
     * @brief 新增预处理sql语句
     * @param index 预处理语句的索引
@@ -160,9 +187,24 @@ public:
     */
     bool _Query(char const* sql, MySQLResult** pResult, MySQLField** pFields, uint64_t* pRowCount, uint32_t* pFieldCount);
 
+    /**
+    * @brief 在一个事务里执行transaction的所有语句 出错的时候回滚
+    * @return 0表示提交成功 TRANSACTION_COMMIT_UNKNOWN表示COMMIT的时候连接断开 否则是导致回滚的mysql错误码
+    * @details 不重试 死锁之类的重试由TransactionTask::executeWithRetry处理
+    *          COMMIT之前连接断开的时候服务器一定已经回滚 可以重放 COMMIT的时候断开服务器可能已经提交 不能重放
+    */
+    uint32_t ExecuteTransaction(TransactionBase* transaction);
+
     void ping();
 
+    //连接已经断开的时候返回CR_SERVER_GONE_ERROR
     uint32_t getLastError() const;
+
+    //是否是连接断开之类需要重连的错误
+    static bool isConnectionError(uint32_t errNo);
+
+    //异步连接的工作线程 同步连接或者还没有打开的时候返回nullptr
+    DatabaseWorker* getWorker() const { return worker_.get(); }
 private:
     /**
     * @brief 处理mysql错误
@@ -172,38 +214,61 @@ private:
     */
     bool _HandleMySQLErrno(uint32_t errNo, uint8_t attempts = 5);
 
+    //执行sql语句 不检查多语句的开关 ExecuteBatch逐条执行的时候用
+    bool _Execute(const char* sql);
+
+    /**
+    * @brief 打开或者关闭多语句 已经是这个状态的时候不发送请求
+    * @return 是否已经切换到了这个状态
+    */
+    bool setMultiStatements(bool enable);
+
+    /**
+    * @brief 事务中的语句失败之后回滚
+    * @param errorCode 失败语句的错误码
+    * @return 失败语句的错误码 连接断开的时候已经重连 不回滚
+    */
+    uint32_t rollbackTransaction(uint32_t errorCode);
+
+    //服务器的max_allowed_packet 第一次用的时候查询
+    uint64_t getMaxAllowedPacket();
+
+    /**
+    * @brief 获取rowCount行的多行INSERT预处理语句 没有的时候预处理一条
+    * @param index 单行INSERT预处理语句的索引
+    * @return 单行语句不存在或者不是INSERT ... VALUES (...)的时候返回nullptr
+    */
+    MySQLPreparedStatement* getBulkStatement(uint32_t index, std::size_t columnCount, std::size_t rowCount);
+
 protected:
     /**
     * @brief 预处理sql语句
     */
     virtual void doPrepareStatements(); 
 
+    //异步连接打开成功之后启动工作线程 已经启动的时候什么都不做 重写open的子类需要自己调用
+    void startWorker();
+
     /**
     * @brief 获取预处理语句
     * @param index 预处理语句的索引
     * @return MySQLPreparedStatement* 预处理语句
     */
     MySQLPreparedStatement* GetPreparedStatement(uint32_t index);
-    bool LockIfReady()
-    {
-        return mutex_.try_lock();
-    }
-
-    void Unlock()
-    {
-        mutex_.unlock();
-    }
 protected:
     bool reconnecting_;                        // 是否正在重连
     bool prepareError_;                        // 预处理语句是否有错误
     PreparedStatementContainer preparedStatements_; // 预处理语句容器
 private:
-    std::mutex mutex_;                          // 互斥锁
     MySQLHandle * mysqlHandler_;                //数据库的句柄
     MysqlConnectionInfo& connectionInfo_;       // 数据库连接信息
     ConnectionFlags connectionFlags_;           // 连接标志 
-    THREADING::ProducerConsumerQueue<SQLOperation*>* sqlQueue_; // sql队列
+    SQLQueue* sqlQueue_; // sql队列
     std::unique_ptr<DatabaseWorker> worker_;    // 数据库工作线程
+    bool inTransaction_;                        // 正在执行事务 语句失败之后不重连重试
+    bool multiStatements_;                      // 当前是否打开了多语句 新连接默认关闭
+    uint64_t maxAllowedPacket_;                 // 服务器的max_allowed_packet 0表示还没有查询
+    std::map<std::pair<uint32_t, std::size_t>, std::unique_ptr<MySQLPreparedStatement>> bulkStatements_;   // (索引 行数) -> 多行INSERT
 };
 
 
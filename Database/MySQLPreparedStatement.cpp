@@ -1,6 +1,7 @@
 #include "MySQLPreparedStatement.h"
 #include "MySQLHacks.h"
 #include "PreparedStatement.h"
+#include "BulkInsert.h"
 #include <cstdint>
 #include <mysql/mysql.h>
 #include <memory.h>
@@ -25,7 +26,7 @@ template<> struct MySQLType<double> : std::integral_constant<enum_field_types, M
 
 
 
-void MySQLPreparedStatement::setParameter(uint8_t index, std::nullptr_t)
+void MySQLPreparedStatement::setParameter(uint32_t index, std::nullptr_t)
 {
     paramsSet_[index] = true;
     MYSQL_BIND* param = &bind_[index];
@@ -38,13 +39,13 @@ void MySQLPreparedStatement::setParameter(uint8_t index, std::nullptr_t)
     param->length = nullptr;
 }
 
-void MySQLPreparedStatement::setParameter(uint8_t index, bool value)
+void MySQLPreparedStatement::setParameter(uint32_t index, bool value)
 {
     setParameter(index, uint8_t(value ? 1 : 0));
 }
 
 template<typename T>
-void MySQLPreparedStatement::setParameter(uint8_t index, T value)
+void MySQLPreparedStatement::setParameter(uint32_t index, T value)
 {
     paramsSet_[index] = true;
     MYSQL_BIND* param = &bind_[index];
@@ -60,7 +61,7 @@ void MySQLPreparedStatement::setParameter(uint8_t index, T value)
     memcpy(param->buffer, &value, len);
 }
 
-void MySQLPreparedStatement::setParameter(uint8_t index, std::string const& value)
+void MySQLPreparedStatement::setParameter(uint32_t index, std::string const& value)
 {
     paramsSet_[index] = true;
     MYSQL_BIND* param = &bind_[index];
@@ -77,7 +78,7 @@ void MySQLPreparedStatement::setParameter(uint8_t index, std::string const& valu
     memcpy(param->buffer, value.c_str(), len);
 }
 
-void MySQLPreparedStatement::setParameter(uint8_t index, std::vector<uint8_t> const& value)
+void MySQLPreparedStatement::setParameter(uint32_t index, std::vector<uint8_t> const& value)
 {
     paramsSet_[index] = true;
     MYSQL_BIND* param = &bind_[index];
@@ -152,4 +153,24 @@ void MySQLPreparedStatement::bindPrameters(PreparedStatementBase *  base)
     }
 }
 
+
+
+void MySQLPreparedStatement::bindRows(BulkInsertBase const* bulk, std::size_t firstRow, std::size_t rowCount)
+{
+    uint32_t pos = 0;
+    std::size_t columnCount = bulk->GetColumnCount();
+
+    for (std::size_t row = firstRow; row < firstRow + rowCount; ++row)
+    {
+        for (std::size_t column = 0; column < columnCount; ++column)
+        {
+            std::visit([&](auto&& param)
+            {
+                setParameter(pos, param);
+            }, bulk->GetValue(row, column).data);
+            ++pos;
+        }
+    }
+}
+
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -11,6 +12,7 @@ namespace DATABASE
 
 class MysqlConnection;
 class PreparedStatementBase;
+class BulkInsertBase;
 
 
 class MySQLPreparedStatement
@@ -26,14 +28,17 @@ public:
     uint32_t getParamCount() const { return paramCount_; }
     //将参数绑定到stmt_上
     void bindPrameters(PreparedStatementBase *  base);
+    //把bulk从firstRow开始的rowCount行按行依次绑定到多行INSERT的参数上
+    void bindRows(BulkInsertBase const* bulk, std::size_t firstRow, std::size_t rowCount);
 
 protected:
-    void setParameter(uint8_t index, std::nullptr_t);
-    void setParameter(uint8_t index, bool value);
+    //多行INSERT的参数超过255个 下标用uint32_t
+    void setParameter(uint32_t index, std::nullptr_t);
+    void setParameter(uint32_t index, bool value);
     template<typename T>
-    void setParameter(uint8_t index, T value);
-    void setParameter(uint8_t index, std::string const& value);
-    void setParameter(uint8_t index, std::vector<uint8_t> const& value);
+    void setParameter(uint32_t index, T value);
+    void setParameter(uint32_t index, std::string const& value);
+    void setParameter(uint32_t index, std::vector<uint8_t> const& value);
 
     MySQLStmt* getSTMT() { return stmt_; }
     MySQLBind* getBind() { return bind_; }
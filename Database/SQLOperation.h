@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include <cstdint>
 #include <memory>
 
 namespace DATABASE 
@@ -28,13 +29,22 @@ struct SQLElementData
 
 class MysqlConnection;
 
+//异步sql操作的优先级 工作线程先处理高优先级的 低优先级等待超过老化时间之后插队
+enum SQLPriority : uint8_t
+{
+    SQL_PRIORITY_INTERACTIVE,   //玩家在等结果的查询 比如登录
+    SQL_PRIORITY_NORMAL,        //默认
+    SQL_PRIORITY_BACKGROUND,    //日志 统计之类可以延后的写入
+    SQL_PRIORITY_COUNT
+};
+
 
 class SQLOperation
 {
 public: 
     using ptr = std::shared_ptr<SQLOperation>;
 public:
-    SQLOperation(): conn_(nullptr) { }
+    SQLOperation(): conn_(nullptr), priority_(SQL_PRIORITY_NORMAL) { }
     virtual ~SQLOperation() { }
 
     virtual int call()
@@ -47,8 +57,15 @@ public:
 
     virtual void setConnection(MysqlConnection* con) { conn_ = con;}
 
+    //不需要结果的普通sql语句返回语句本身 工作线程把连续的这类操作合并成一次往返 其他操作返回nullptr
+    virtual const char* getBatchableSql() const { return nullptr; }
+
+    void setPriority(SQLPriority priority) { priority_ = priority; }
+    SQLPriority getPriority() const { return priority_; }
+
 
     MysqlConnection* conn_;
+    SQLPriority priority_;
 };
 
 }
\ No newline at end of file
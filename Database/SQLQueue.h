@@ -0,0 +1,28 @@
+#pragma once
+
+
+#include "SQLOperation.h"
+
+//定义USE_LOCKFREE_SQL_QUEUE之后 异步sql队列换成无锁队列 此时不区分优先级 按提交顺序执行
+//否则使用按SQLPriority分级的PriorityProducerConsumerQueue
+#ifdef USE_LOCKFREE_SQL_QUEUE
+#include "../Threading/LockFreeQueue.h"
+#else
+#include "../Threading/PriorityProducerConsumerQueue.h"
+#endif
+
+namespace DATABASE
+{
+
+struct SQLOperationPriority
+{
+    std::size_t operator()(SQLOperation* op) const { return op->getPriority(); }
+};
+
+#ifdef USE_LOCKFREE_SQL_QUEUE
+using SQLQueue = THREADING::LockFreeQueue<SQLOperation*>;
+#else
+using SQLQueue = THREADING::PriorityProducerConsumerQueue<SQLOperation*, SQLOperationPriority, SQL_PRIORITY_COUNT>;
+#endif
+
+}
@@ -0,0 +1,216 @@
+#include "SyncConnectionPool.h"
+#include <algorithm>
+#include <mutex>
+#include <spdlog/spdlog.h>
+
+
+namespace DATABASE
+{
+
+SyncConnectionPool::SyncConnectionPool() :
+    size_(0),
+    inUse_(0),
+    statsStart_(clock::now()),
+    lastChange_(statsStart_),
+    busyConnSeconds_(0)
+{
+    THREADING::nameMutex(mutex_, "SyncConnectionPool");
+}
+
+
+SyncConnectionPool::~SyncConnectionPool()
+{
+    clear();
+}
+
+
+void SyncConnectionPool::add(MysqlConnection* conn)
+{
+    std::lock_guard<THREADING::Mutex> lock(mutex_);
+    ++size_;
+
+    //有人在等的时候直接交给他
+    bool handOver = !waiters_.empty();
+    checkedOut_[conn] = handOver;
+    if (handOver)
+    {
+        accumulateBusy(clock::now());
+        ++inUse_;
+
+        Waiter* waiter = waiters_.front();
+        waiters_.pop_front();
+        waiter->conn_ = conn;
+        waiter->cond_.notify_one();
+        return;
+    }
+
+    free_.push_back(conn);
+}
+
+
+void SyncConnectionPool::clear()
+{
+    std::lock_guard<THREADING::Mutex> lock(mutex_);
+    for (Waiter* waiter : waiters_)
+    {
+        waiter->cancelled_ = true;
+        waiter->cond_.notify_one();
+    }
+
+    waiters_.clear();
+    free_.clear();
+    checkedOut_.clear();
+    size_ = 0;
+
+    //还没有归还的连接随之作废 之后的release直接丢掉
+    accumulateBusy(clock::now());
+    inUse_ = 0;
+}
+
+
+MysqlConnection* SyncConnectionPool::tryAcquire()
+{
+    std::lock_guard<THREADING::Mutex> lock(mutex_);
+    if (free_.empty() || !waiters_.empty())
+    {
+        return nullptr;
+    }
+
+    MysqlConnection* conn = free_.back();
+    free_.pop_back();
+    onAcquired(conn);
+    return conn;
+}
+
+
+MysqlConnection* SyncConnectionPool::acquire(std::chrono::milliseconds timeout)
+{
+    clock::time_point start = clock::now();
+
+    std::unique_lock<THREADING::Mutex> lock(mutex_);
+
+    //排在别人后面的时候不能插队
+    if (!free_.empty() && waiters_.empty())
+    {
+        MysqlConnection* conn = free_.back();
+        free_.pop_back();
+        onAcquired(conn);
+        return conn;
+    }
+
+    if (!size_)
+    {
+        return nullptr;
+    }
+
+    Waiter waiter;
+    waiters_.push_back(&waiter);
+
+    auto handedOver = [&waiter]() { return waiter.conn_ || waiter.cancelled_; };
+    if (timeout.count())
+    {
+        waiter.cond_.wait_until(lock, start + timeout, handedOver);
+    }
+    else
+    {
+        waiter.cond_.wait(lock, handedOver);
+    }
+
+    if (!waiter.conn_)
+    {
+        //超时 release/add还没有把我们从队列里拿走
+        if (!waiter.cancelled_)
+        {
+            waiters_.erase(std::find(waiters_.begin(), waiters_.end(), &waiter));
+            ++stats_.timeouts;
+        }
+        return nullptr;
+    }
+
+    //交接的时候inUse_已经算过了 这里只记录等待
+    uint64_t waitUs = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+    ++stats_.acquisitions;
+    ++stats_.waited;
+    stats_.totalWaitUs += waitUs;
+    stats_.maxWaitUs = std::max(stats_.maxWaitUs, waitUs);
+    stats_.peakInUse = std::max(stats_.peakInUse, inUse_);
+    return waiter.conn_;
+}
+
+
+void SyncConnectionPool::release(MysqlConnection* conn)
+{
+    std::lock_guard<THREADING::Mutex> lock(mutex_);
+
+    //clear之后才归还的连接已经不属于连接池了 可能已经被释放 不能放回空闲列表
+    auto it = checkedOut_.find(conn);
+    if (it == checkedOut_.end() || !it->second)
+    {
+        spdlog::warn("SyncConnectionPool::release connection is not checked out from this pool, dropped");
+        return;
+    }
+
+    //直接交给排在最前面的等待者 占用数不变
+    if (!waiters_.empty())
+    {
+        Waiter* waiter = waiters_.front();
+        waiters_.pop_front();
+        waiter->conn_ = conn;
+        waiter->cond_.notify_one();
+        return;
+    }
+
+    accumulateBusy(clock::now());
+    --inUse_;
+    it->second = false;
+    free_.push_back(conn);
+}
+
+
+SyncPoolStats SyncConnectionPool::getStats()
+{
+    std::lock_guard<THREADING::Mutex> lock(mutex_);
+
+    clock::time_point now = clock::now();
+    accumulateBusy(now);
+
+    SyncPoolStats stats = stats_;
+    stats.size = size_;
+    stats.inUse = inUse_;
+    stats.waiting = waiters_.size();
+
+    double elapsed = std::chrono::duration<double>(now - statsStart_).count();
+    stats.utilization = size_ && elapsed > 0 ? busyConnSeconds_ / (elapsed * size_) : 0;
+    return stats;
+}
+
+
+void SyncConnectionPool::resetStats()
+{
+    std::lock_guard<THREADING::Mutex> lock(mutex_);
+    stats_ = SyncPoolStats();
+    stats_.peakInUse = inUse_;
+    statsStart_ = clock::now();
+    lastChange_ = statsStart_;
+    busyConnSeconds_ = 0;
+}
+
+
+void SyncConnectionPool::onAcquired(MysqlConnection* conn)
+{
+    checkedOut_[conn] = true;
+    accumulateBusy(clock::now());
+    ++inUse_;
+    stats_.peakInUse = std::max(stats_.peakInUse, inUse_);
+    ++stats_.acquisitions;
+}
+
+
+void SyncConnectionPool::accumulateBusy(clock::time_point now)
+{
+    busyConnSeconds_ += inUse_ * std::chrono::duration<double>(now - lastChange_).count();
+    lastChange_ = now;
+}
+
+
+}// namespace DATABASE
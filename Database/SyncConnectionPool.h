@@ -0,0 +1,144 @@
+#pragma once
+
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../Threading/ProfiledMutex.h"
+
+/**
+* @file SyncConnectionPool.h
+* @brief 同步连接池
+*/
+
+namespace DATABASE
+{
+
+
+class MysqlConnection;
+
+/**
+* @struct SyncPoolStats
+* @brief 同步连接池的统计 用来确定同步连接的数量
+*/
+struct SyncPoolStats
+{
+    std::size_t size = 0;           //连接总数
+    std::size_t inUse = 0;          //正在使用的连接数
+    std::size_t peakInUse = 0;      //同时使用的最大连接数
+    std::size_t waiting = 0;        //正在等待的调用者
+    uint64_t acquisitions = 0;      //成功取得连接的次数
+    uint64_t waited = 0;            //其中需要等待的次数
+    uint64_t timeouts = 0;          //等待超时的次数
+    uint64_t totalWaitUs = 0;       //总等待时间
+    uint64_t maxWaitUs = 0;         //最长的一次等待
+    double utilization = 0;         //统计期间平均每个连接被占用的时间比例
+};
+
+
+/**
+* @class SyncConnectionPool
+* @brief 同步连接的空闲列表 取不到连接的调用者按先来后到排队等待
+* @details 每个等待者有自己的条件变量 归还连接的时候直接交给排在最前面的等待者 不会被后来的调用者抢走
+*          也不会一次唤醒所有等待者 取连接可以指定超时
+*/
+class SyncConnectionPool
+{
+public:
+    using ptr = std::shared_ptr<SyncConnectionPool>;
+    using clock = std::chrono::steady_clock;
+
+    /**
+    * @class Guard
+    * @brief 离开作用域的时候归还连接
+    */
+    class Guard
+    {
+    public:
+        Guard(SyncConnectionPool& pool, MysqlConnection* conn) :
+            pool_(pool),
+            conn_(conn)
+        {}
+
+        ~Guard()
+        {
+            if (conn_)
+                pool_.release(conn_);
+        }
+
+        Guard(Guard const&) = delete;
+        Guard& operator=(Guard const&) = delete;
+
+        MysqlConnection* get() const { return conn_; }
+        explicit operator bool() const { return conn_ != nullptr; }
+
+    private:
+        SyncConnectionPool& pool_;
+        MysqlConnection* conn_;
+    };
+
+public:
+    SyncConnectionPool();
+    ~SyncConnectionPool();
+
+    //加入一个空闲连接 连接的生命周期由调用者管理
+    void add(MysqlConnection* conn);
+
+    /**
+    * @brief 移除所有连接 正在等待的调用者返回nullptr
+    * @details 调用之前所有连接都应该已经归还 之后才归还的连接会被丢掉 不会放回空闲列表
+    */
+    void clear();
+
+    /**
+    * @brief 取一个空闲连接 没有的时候排队等待
+    * @param timeout 最多等待多久 0表示一直等
+    * @return 超时或者连接池已经清空的时候返回nullptr
+    */
+    MysqlConnection* acquire(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+    //有空闲连接并且没有人排队的时候取一个 不等待
+    MysqlConnection* tryAcquire();
+
+    //归还连接 有人排队的时候直接交给排在最前面的 不是从当前连接池借出的连接直接丢掉
+    void release(MysqlConnection* conn);
+
+    SyncPoolStats getStats();
+
+    //清空计数 连接数 使用中和等待中的数量不变
+    void resetStats();
+
+private:
+    struct Waiter
+    {
+        THREADING::ConditionVariable cond_;
+        MysqlConnection* conn_ = nullptr;
+        bool cancelled_ = false;
+    };
+
+    //已经持有mutex_ 不用等待直接取走空闲连接之后更新统计
+    void onAcquired(MysqlConnection* conn);
+
+    //已经持有mutex_ 把到现在为止的占用时间累加起来
+    void accumulateBusy(clock::time_point now);
+
+private:
+    THREADING::Mutex mutex_;
+    std::vector<MysqlConnection*> free_;    //空闲连接 后进先出 常用的连接缓存更热
+    std::deque<Waiter*> waiters_;           //按到达顺序排队
+    std::unordered_map<MysqlConnection*, bool> checkedOut_;    //add之后clear之前的所有连接 是否已经借出
+    std::size_t size_;
+    std::size_t inUse_;
+
+    SyncPoolStats stats_;
+    clock::time_point statsStart_;
+    clock::time_point lastChange_;          //inUse_上次变化的时间
+    double busyConnSeconds_;                //inUse_对时间的积分
+};
+
+
+}// namespace DATABASE
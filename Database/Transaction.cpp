@@ -1,7 +1,14 @@
 #include "Transaction.h"
+#include <algorithm>
+#include <chrono>
+#include <mysql/mysqld_error.h>
+#include <random>
+#include <spdlog/spdlog.h>
 #include <string.h>
+#include <thread>
 
 #include "SQLOperation.h"
+#include "MySQLConnection.h"
 
 
 
@@ -46,4 +53,96 @@ void TransactionBase::cleanUp()
     cleanUp_ = true;
 }
 
-}
\ No newline at end of file
+
+
+TransactionTask::TransactionTask(std::shared_ptr<TransactionBase> trans, bool async) :
+    trans_(std::move(trans)),
+    hasResult_(async),
+    result_(nullptr)
+{
+    if (async) 
+    {
+        result_ = new TransactionPromise();
+    }
+}
+
+TransactionTask::~TransactionTask()
+{
+    if (hasResult_ && result_) 
+    {
+        delete result_;
+        result_ = nullptr;
+    }
+}
+
+bool TransactionTask::execute()
+{
+    bool success = executeWithRetry(conn_, trans_.get());
+    if (hasResult_) 
+    {
+        result_->set_value(success);
+    }
+
+    return success;
+}
+
+bool TransactionTask::executeWithRetry(MysqlConnection* conn, TransactionBase* trans)
+{
+    thread_local std::minstd_rand random(std::random_device{}());
+
+    uint32_t delayMs = TRANSACTION_RETRY_BASE_MS;
+    for (uint32_t attempt = 0; ; ++attempt) 
+    {
+        uint32_t errorCode = conn->ExecuteTransaction(trans);
+        if (!errorCode) 
+        {
+            return true;
+        }
+
+        //COMMIT的时候连接断开 服务器可能已经提交了 重放可能把物品金币之类的发放两次 只能报告给上层
+        if (errorCode == TRANSACTION_COMMIT_UNKNOWN)
+        {
+            spdlog::error("TransactionTask::executeWithRetry connection lost during COMMIT, outcome unknown, {} statements not replayed",
+                trans->getSize());
+            return false;
+        }
+
+        //COMMIT之前连接断开的时候ExecuteTransaction已经重连 从START TRANSACTION开始在新连接上重放整个事务
+        bool lost = MysqlConnection::isConnectionError(errorCode);
+
+        //只有死锁和锁等待超时是因为和别的事务冲突 重试可能成功
+        if ((!lost && errorCode != ER_LOCK_DEADLOCK && errorCode != ER_LOCK_WAIT_TIMEOUT) || attempt >= TRANSACTION_MAX_RETRIES) 
+        {
+            spdlog::error("TransactionTask::executeWithRetry failed [{}] after {} attempts, {} statements rolled back",
+                errorCode, attempt + 1, trans->getSize());
+            return false;
+        }
+
+        //加一半的随机抖动 避免冲突的两个事务同时重试再次死锁 连接断开的时候也等一下 不要连续冲击刚恢复的服务器
+        uint32_t sleepMs = delayMs / 2 + random() % (delayMs / 2 + 1);
+        if (lost)
+            spdlog::warn("TransactionTask::executeWithRetry [{}] connection lost, replaying transaction (retry {}) in {}ms", errorCode, attempt + 1, sleepMs);
+        else
+            spdlog::warn("TransactionTask::executeWithRetry [{}] retry {} in {}ms", errorCode, attempt + 1, sleepMs);
+        std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+        delayMs = std::min<uint32_t>(delayMs * 2, TRANSACTION_RETRY_MAX_MS);
+    }
+}
+
+
+bool TransactionCallback::InvokeIfReady()
+{
+    if (future_.valid() && future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready) 
+    {
+        bool success = future_.get();
+        if (callback_) 
+        {
+            callback_(success);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+}
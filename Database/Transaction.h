@@ -2,6 +2,7 @@
 
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <vector>
@@ -9,9 +10,22 @@
 #include "SQLOperation.h"
 #include "PreparedStatement.h"
 
+#define TRANSACTION_MAX_RETRIES 5           //死锁或者锁等待超时之后最多重试几次
+#define TRANSACTION_RETRY_BASE_MS 10        //第一次重试前等待的时间 之后每次翻倍
+#define TRANSACTION_RETRY_MAX_MS 500        //重试等待时间的上限
+
+/**
+* @file Transaction.h
+* @brief 事务 在一个连接上用一次START TRANSACTION/COMMIT执行一组语句
+*/
+
 namespace DATABASE
 {
 
+/**
+* @class TransactionBase
+* @brief 保存事务里的语句 语句在事务析构的时候释放 重试的时候可以再执行一遍
+*/
 class TransactionBase
 {
 public:
@@ -41,8 +55,12 @@ private:
 template<typename T>
 class Transaction : public TransactionBase
 {
+public:
+    using ptr = std::shared_ptr<Transaction<T>>;
+
 public:
     using TransactionBase::append;
+    //事务接管statement 执行完之后释放
     void Append(PreparedStatement<T>* statement)
     {
         this->appendPreparedStatement(statement);
@@ -50,6 +68,80 @@ public:
 };
 
 
+/**
+* @class TransactionTask
+* @brief 在异步连接上执行事务
+* @details 死锁(1213)和锁等待超时(1205)的时候回滚 等待一段时间之后整个事务重试
+*          等待时间从TRANSACTION_RETRY_BASE_MS开始翻倍 最多TRANSACTION_MAX_RETRIES次
+*          COMMIT之前连接断开的时候重连之后同样等待并重放 COMMIT的时候连接断开不知道是否已经提交 不重放直接失败
+*          其他错误回滚之后直接失败
+*/
+class TransactionTask : public SQLOperation
+{
+public:
+    /**
+    * @brief 构造函数
+    * @param trans 要执行的事务
+    * @param async 是否需要知道执行结果 需要的话通过getFuture获取
+    */
+    TransactionTask(std::shared_ptr<TransactionBase> trans, bool async = false);
+    ~TransactionTask();
+
+    bool execute() override;
+    TransactionFuture getFuture() { return result_->get_future(); }
+
+    /**
+    * @brief 在conn上执行事务 遇到死锁和锁等待超时的时候重试
+    * @return 是否提交成功
+    * @details 同步提交也用这个函数
+    */
+    static bool executeWithRetry(MysqlConnection* conn, TransactionBase* trans);
+
+private:
+    std::shared_ptr<TransactionBase> trans_;
+    bool hasResult_;
+    TransactionPromise* result_;
+};
+
+
+/**
+* @class TransactionCallback
+* @brief 异步事务完成之后调用回调 和QueryCallback一样在逻辑线程轮询InvokeIfReady
+*/
+class TransactionCallback
+{
+public:
+    using ptr = std::shared_ptr<TransactionCallback>;
+
+public:
+    explicit TransactionCallback(TransactionFuture&& future) : future_(std::move(future))
+    {}
+
+    TransactionCallback(TransactionCallback&&) = default;
+    TransactionCallback& operator=(TransactionCallback&&) = default;
+
+    //参数是事务是否提交成功
+    TransactionCallback&& AfterComplete(std::function<void(bool)>&& callback)
+    {
+        callback_ = std::move(callback);
+        return std::move(*this);
+    }
+
+    /**
+    * @brief 事务已经执行完的时候调用回调
+    * @return 事务执行完返回true
+    */
+    bool InvokeIfReady();
+
+private:
+    TransactionCallback(TransactionCallback const&) = delete;
+    TransactionCallback& operator=(TransactionCallback const&) = delete;
+
+    TransactionFuture future_;
+    std::function<void(bool)> callback_;
+};
+
+
 
 
 
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <utility>
 #include <boost/asio.hpp>
 #include <functional>
 #include <memory>
 #include <utility>
 #include <spdlog/spdlog.h>
+#include "SocketOptions.h"
 
 namespace NET 
 {
@@ -14,6 +16,8 @@ class AsyncAcceptor
 public:
     using ptr = std::shared_ptr<AsyncAcceptor>;
     using AcceptCallback = void(*)(boost::asio::ip::tcp::socket&& newSocket, uint32_t threadIndex);
+    //返回false表示拒绝该连接 在创建SocketType之前调用
+    using AcceptFilter = std::function<bool(boost::asio::ip::address const& address)>;
 
 public:
 
@@ -32,7 +36,7 @@ public:
     void AsyncAccept()
     {
         acceptor_.async_accept(socket_, [this](boost::system::error_code error){
-            if (!error)
+            if (!error && filterAccepted(this->socket_))
             {
                 try
                 {
@@ -59,7 +63,7 @@ public:
         std::tie(sock, threadIndex) = socketFactory_();
 
         acceptor_.async_accept(*sock, [this, sock, threadIndex](boost::system::error_code error){
-            if (!error) 
+            if (!error && filterAccepted(*sock)) 
             {
                 try
                 {
@@ -79,7 +83,11 @@ public:
     }
 
 
-    bool bind()
+    /**
+    * @brief 绑定并开始监听
+    * @param options 使用其中的listenBacklog 接收缓冲区大小也设置在监听socket上 接受的连接会继承
+    */
+    bool bind(SocketOptions const& options = SocketOptions())
     {
         
         boost::system::error_code errorCode;
@@ -95,6 +103,9 @@ public:
             return false;
         }
 
+        if (options.receiveBufferSize > 0)
+            SocketOptionsUtil::setOption(acceptor_.native_handle(), SOL_SOCKET, SO_RCVBUF, options.receiveBufferSize, "SO_RCVBUF");
+
         if (acceptor_.bind(endpoint_, errorCode)) 
         {
             spdlog::error("AsyncAcceptor::bind Could not bind to {}:{} {}", endpoint_.address().to_string(),
@@ -104,7 +115,7 @@ public:
         }
 
 
-        if (acceptor_.listen(4096, errorCode)) 
+        if (acceptor_.listen(options.listenBacklog, errorCode)) 
         {
             spdlog::error("AsyncAcceptor::bind Failed to start listening on {}:{} {}", endpoint_.address().to_string(), endpoint_.port(), errorCode.message());
 
@@ -126,12 +137,38 @@ public:
     }
 
 
+    /**
+    * @brief 设置接受连接时的过滤器
+    * @details 过滤器在accept的线程执行 被拒绝的连接直接关闭 不会创建SocketType也不会分配缓冲区
+    */
+    void setAcceptFilter(AcceptFilter filter)
+    {
+        acceptFilter_ = std::move(filter);
+    }
+
     void setSockFactory(std::function<std::pair<boost::asio::ip::tcp::socket*, uint32_t>()> factory)
     {
         socketFactory_ = factory;
     }
 
 private:
+    //过滤器拒绝的时候关闭socket并返回false
+    bool filterAccepted(boost::asio::ip::tcp::socket& sock)
+    {
+        if (!acceptFilter_)
+            return true;
+
+        boost::system::error_code error;
+        boost::asio::ip::tcp::endpoint remote = sock.remote_endpoint(error);
+        if (!error && acceptFilter_(remote.address()))
+            return true;
+
+        //RST关闭 不进入TIME_WAIT
+        sock.set_option(boost::asio::socket_base::linger(true, 0), error);
+        sock.close(error);
+        return false;
+    }
+
     std::pair<boost::asio::ip::tcp::socket*, uint32_t> defeaultSocketFactory()
     {
         return std::make_pair(&socket_, 0);
@@ -144,6 +181,7 @@ private:
     std::atomic<bool> closed_;
 
     std::function<std::pair<boost::asio::ip::tcp::socket*, uint32_t>()> socketFactory_;
+    AcceptFilter acceptFilter_;
 };
 
 
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <utility>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include "NetworkThread.h"
+
+namespace NET
+{
+
+/**
+* @class AsyncConnector
+* @brief 主动向外发起连接 连接成功之后创建SocketType并交给指定的网络线程管理
+* @details 与AsyncAcceptor相对应 socket直接创建在目标网络线程的io_context上
+*          所以连接过程中的回调以及之后socket的所有读写都在该线程执行
+*/
+template<class SocketType>
+class AsyncConnector
+{
+public:
+    /**
+    * @brief 连接结果回调 在网络线程执行
+    * @details 连接失败的时候参数为nullptr
+    */
+    using ConnectCallback = std::function<void(std::shared_ptr<SocketType>)>;
+
+public:
+    /**
+    * @brief 异步连接
+    * @param thread 新的连接交给哪个网络线程
+    * @param endpoint 对端地址
+    * @param timeout 连接超时时间
+    * @param callback 连接结果回调
+    */
+    static void connect(NetworkThread<SocketType>& thread,
+        boost::asio::ip::tcp::endpoint const& endpoint,
+        std::chrono::milliseconds timeout,
+        ConnectCallback callback)
+    {
+        std::shared_ptr<ConnectState> state = std::make_shared<ConnectState>(thread, endpoint, std::move(callback));
+
+        state->timer_.expires_after(timeout);
+        state->timer_.async_wait([state](boost::system::error_code error){
+            //超时了 关闭socket让async_connect以operation_aborted返回
+            if (!error)
+            {
+                boost::system::error_code closeError;
+                state->socket_.close(closeError);
+            }
+        });
+
+        state->socket_.async_connect(endpoint, [state](boost::system::error_code error){
+            state->timer_.cancel();
+            onConnect(state, error);
+        });
+    }
+
+private:
+    struct ConnectState
+    {
+        ConnectState(NetworkThread<SocketType>& thread,
+            boost::asio::ip::tcp::endpoint const& endpoint,
+            ConnectCallback&& callback) :
+            thread_(thread),
+            endpoint_(endpoint),
+            socket_(thread.getIoContext()),
+            timer_(thread.getIoContext()),
+            callback_(std::move(callback))
+        {}
+
+        NetworkThread<SocketType>& thread_;
+        boost::asio::ip::tcp::endpoint endpoint_;
+        boost::asio::ip::tcp::socket socket_;
+        boost::asio::steady_timer timer_;
+        ConnectCallback callback_;
+    };
+
+    static void onConnect(std::shared_ptr<ConnectState> const& state, boost::system::error_code error)
+    {
+        if (error || !state->socket_.is_open())
+        {
+            spdlog::error("AsyncConnector::connect Failed to connect to {}:{} {}",
+                state->endpoint_.address().to_string(), state->endpoint_.port(), error.message());
+
+            if (state->callback_)
+                state->callback_(nullptr);
+            return;
+        }
+
+        std::shared_ptr<SocketType> sockPtr;
+        try
+        {
+            state->socket_.non_blocking(true);
+            sockPtr = std::make_shared<SocketType>(std::move(state->socket_));
+            sockPtr->setUringService(state->thread_.getUringService());
+            sockPtr->start();
+            state->thread_.addNewSocket(sockPtr);
+        }
+        catch (boost::system::system_error const& err)
+        {
+            spdlog::error("AsyncConnector::connect Failed to initialize socket for {}:{} {}",
+                state->endpoint_.address().to_string(), state->endpoint_.port(), err.what());
+            sockPtr = nullptr;
+        }
+
+        if (state->callback_)
+            state->callback_(sockPtr);
+    }
+};
+
+
+}
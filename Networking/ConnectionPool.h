@@ -0,0 +1,314 @@
+#pragma once
+
+#include <utility>
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "AsyncConnector.h"
+#include "SocketMgr.h"
+
+namespace NET
+{
+
+/**
+* @struct ReconnectPolicy
+* @brief 连接池的重连策略
+*/
+struct ReconnectPolicy
+{
+    std::chrono::milliseconds connectTimeout{3000};         //单次连接的超时时间
+    std::chrono::milliseconds initialBackoff{100};          //第一次重连前等待的时间
+    std::chrono::milliseconds maxBackoff{10000};            //重连等待时间的上限 每失败一次翻倍
+    std::chrono::milliseconds healthCheckInterval{100};     //检查连接是否断开的间隔
+    std::chrono::milliseconds stableAfter{5000};            //连接保持这么久之后才把重连等待时间重置为initialBackoff
+};
+
+
+/**
+* @class ConnectionPool
+* @brief 服务器之间的长连接池
+* @details 每个远端地址保持connectionsPerEndpoint条已经建立好的连接 平均分布在SocketMgr的网络线程上
+*          连接断开之后按照指数退避自动重连 acquire只是从已经连上的连接里面挑一个 不会在调用线程建立连接
+*          连上之后要保持policy.stableAfter才重置退避时间 对端接受之后马上断开的时候不会变成以initialBackoff的频率重连
+*/
+template<class SocketType>
+class ConnectionPool
+{
+public:
+    using ptr = std::shared_ptr<ConnectionPool>;
+
+public:
+    /**
+    * @brief 构造函数
+    * @param mgr 提供网络线程的管理器 需要先startThreads/startNetwork
+    * @param connectionsPerEndpoint 每个远端地址保持的连接数
+    * @param policy 重连策略
+    */
+    ConnectionPool(SocketMgr<SocketType>& mgr, std::size_t connectionsPerEndpoint, ReconnectPolicy const& policy = ReconnectPolicy()) :
+        mgr_(mgr),
+        connectionsPerEndpoint_(std::max<std::size_t>(connectionsPerEndpoint, 1)),
+        policy_(policy),
+        nextThread_(0),
+        stopped_(false)
+    {}
+
+    ~ConnectionPool()
+    {
+        stop();
+    }
+
+    /**
+    * @brief 开始维护到endpoint的连接
+    * @return 连接池已经停止 或者SocketMgr还没有网络线程的时候返回false 已经在维护的endpoint返回true
+    */
+    bool addEndpoint(boost::asio::ip::tcp::endpoint const& endpoint)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_)
+            return false;
+
+        if (endpoints_.count(endpoint))
+            return true;
+
+        uint32_t threadCount = mgr_.getThreadCount();
+        if (!threadCount)
+        {
+            spdlog::error("ConnectionPool::addEndpoint {}:{} SocketMgr has no network threads, call startThreads first",
+                endpoint.address().to_string(), endpoint.port());
+            return false;
+        }
+
+        EndpointSlots& slots = endpoints_[endpoint];
+        for (std::size_t i = 0; i < connectionsPerEndpoint_; ++i)
+        {
+            NetworkThread<SocketType>& thread = *mgr_.getNetworkThread(nextThread_++ % threadCount);
+            std::shared_ptr<Slot> slot = std::make_shared<Slot>(thread, endpoint, policy_);
+            slots.slots_.push_back(slot);
+
+            boost::asio::post(thread.getIoContext(), [slot](){
+                connectSlot(slot);
+            });
+        }
+
+        return true;
+    }
+
+    /**
+    * @brief 获取一条到endpoint的可用连接 多条连接之间轮询
+    * @details 连接属于某个网络线程 发送队列不是线程安全的 在其他线程要用postPacket发送 不能直接queuePacket
+    * @return 当前没有可用连接的时候返回nullptr
+    */
+    std::shared_ptr<SocketType> acquire(boost::asio::ip::tcp::endpoint const& endpoint)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = endpoints_.find(endpoint);
+        if (it == endpoints_.end())
+            return nullptr;
+
+        EndpointSlots& slots = it->second;
+        std::size_t count = slots.slots_.size();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Slot& slot = *slots.slots_[slots.next_++ % count];
+
+            std::lock_guard<std::mutex> slotLock(slot.mutex_);
+            if (slot.socket_ && slot.socket_->IsOpen())
+                return slot.socket_;
+        }
+
+        return nullptr;
+    }
+
+    //到endpoint当前已经连上的连接数
+    std::size_t getConnectedCount(boost::asio::ip::tcp::endpoint const& endpoint)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = endpoints_.find(endpoint);
+        if (it == endpoints_.end())
+            return 0;
+
+        std::size_t connected = 0;
+        for (std::shared_ptr<Slot> const& slot : it->second.slots_)
+        {
+            std::lock_guard<std::mutex> slotLock(slot->mutex_);
+            if (slot->socket_ && slot->socket_->IsOpen())
+                ++connected;
+        }
+
+        return connected;
+    }
+
+    /**
+    * @brief 停止重连 并关闭池里的所有连接
+    */
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_)
+            return;
+
+        stopped_ = true;
+        for (auto& [endpoint, slots] : endpoints_)
+        {
+            for (std::shared_ptr<Slot> const& slot : slots.slots_)
+            {
+                slot->stopped_ = true;
+
+                //定时器和socket都只能在所属的网络线程操作
+                boost::asio::post(slot->thread_.getIoContext(), [slot](){
+                    slot->timer_.cancel();
+
+                    std::lock_guard<std::mutex> slotLock(slot->mutex_);
+                    if (slot->socket_)
+                        slot->socket_->delayCloseSocket();
+                    slot->socket_ = nullptr;
+                });
+            }
+        }
+
+        endpoints_.clear();
+    }
+
+private:
+    /**
+    * @struct Slot
+    * @brief 池中的一条连接 断开之后在原来的网络线程上重连
+    * @details 回调里面只持有Slot 所以池析构之后还没执行的回调也是安全的
+    */
+    struct Slot
+    {
+        Slot(NetworkThread<SocketType>& thread,
+            boost::asio::ip::tcp::endpoint const& endpoint,
+            ReconnectPolicy const& policy) :
+            thread_(thread),
+            endpoint_(endpoint),
+            policy_(policy),
+            timer_(thread.getIoContext()),
+            backoff_(policy.initialBackoff),
+            stopped_(false)
+        {}
+
+        NetworkThread<SocketType>& thread_;
+        boost::asio::ip::tcp::endpoint endpoint_;
+        ReconnectPolicy policy_;
+        boost::asio::steady_timer timer_;   //重连/健康检查定时器
+        std::chrono::milliseconds backoff_; //下一次重连前等待的时间
+        std::chrono::steady_clock::time_point connectedAt_; //这一次连上的时间
+        std::atomic<bool> stopped_;
+
+        std::mutex mutex_;
+        std::shared_ptr<SocketType> socket_;
+    };
+
+    struct EndpointSlots
+    {
+        std::vector<std::shared_ptr<Slot>> slots_;
+        std::size_t next_ = 0;    //轮询的位置
+    };
+
+    static void connectSlot(std::shared_ptr<Slot> const& slot)
+    {
+        if (slot->stopped_)
+            return;
+
+        AsyncConnector<SocketType>::connect(slot->thread_, slot->endpoint_, slot->policy_.connectTimeout,
+            [slot](std::shared_ptr<SocketType> sock){
+                if (!sock)
+                {
+                    scheduleReconnect(slot);
+                    return;
+                }
+
+                if (slot->stopped_)
+                {
+                    sock->delayCloseSocket();
+                    return;
+                }
+
+                {
+                    std::lock_guard<std::mutex> slotLock(slot->mutex_);
+                    slot->socket_ = sock;
+                }
+
+                slot->connectedAt_ = std::chrono::steady_clock::now();
+                scheduleHealthCheck(slot);
+            });
+    }
+
+    //指数退避 加上随机抖动 避免对端重启之后所有连接同时涌过去
+    static void scheduleReconnect(std::shared_ptr<Slot> const& slot)
+    {
+        if (slot->stopped_)
+            return;
+
+        thread_local std::minstd_rand random(std::random_device{}());
+        std::chrono::milliseconds delay = slot->backoff_ +
+            std::chrono::milliseconds(random() % (slot->backoff_.count() / 2 + 1));
+        slot->backoff_ = std::min(slot->backoff_ * 2, slot->policy_.maxBackoff);
+
+        slot->timer_.expires_after(delay);
+        slot->timer_.async_wait([slot](boost::system::error_code const& error){
+            if (!error)
+                connectSlot(slot);
+        });
+    }
+
+    static void scheduleHealthCheck(std::shared_ptr<Slot> const& slot)
+    {
+        slot->timer_.expires_after(slot->policy_.healthCheckInterval);
+        slot->timer_.async_wait([slot](boost::system::error_code const& error){
+            if (error || slot->stopped_)
+                return;
+
+            {
+                std::lock_guard<std::mutex> slotLock(slot->mutex_);
+                if (slot->socket_ && slot->socket_->IsOpen())
+                {
+                    if (std::chrono::steady_clock::now() - slot->connectedAt_ >= slot->policy_.stableAfter)
+                        slot->backoff_ = slot->policy_.initialBackoff;
+
+                    scheduleHealthCheck(slot);
+                    return;
+                }
+
+                slot->socket_ = nullptr;
+            }
+
+            //连接保持得足够久就马上重连 刚连上就断开的按退避时间等待
+            spdlog::info("ConnectionPool lost connection to {}:{}, reconnecting",
+                slot->endpoint_.address().to_string(), slot->endpoint_.port());
+            if (std::chrono::steady_clock::now() - slot->connectedAt_ >= slot->policy_.stableAfter)
+            {
+                slot->backoff_ = slot->policy_.initialBackoff;
+                connectSlot(slot);
+            }
+            else
+            {
+                scheduleReconnect(slot);
+            }
+        });
+    }
+
+private:
+    SocketMgr<SocketType>& mgr_;
+    std::size_t connectionsPerEndpoint_;    //每个远端地址的连接数
+    ReconnectPolicy policy_;
+    uint32_t nextThread_;   //新连接分配到哪个网络线程
+
+    std::mutex mutex_;
+    bool stopped_;
+    std::map<boost::asio::ip::tcp::endpoint, EndpointSlots> endpoints_;
+};
+
+
+}
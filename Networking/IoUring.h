@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include "../Utilities/MessageBuffer.h"
+
+namespace NET
+{
+
+/**
+* @class IoUring
+* @brief 直接通过系统调用使用io_uring 不依赖liburing
+* @details 只在一个线程里面使用 提交队列和完成队列都不加锁
+*          网络线程用到的功能需要6.0以上的内核: 多次接收(IORING_RECV_MULTISHOT)6.0 IOSQE_CQE_SKIP_SUCCESS 5.17
+*          IORING_OP_PROVIDE_BUFFERS 5.7 不使用5.19的映射缓冲环 UringService在初始化的时候检查 不满足就退回到asio
+*/
+class IoUring
+{
+public:
+    IoUring() :
+        ringFd_(-1),
+        sqRing_(MAP_FAILED),
+        cqRing_(MAP_FAILED),
+        sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+        sqRingSize_(0),
+        cqRingSize_(0),
+        sqesSize_(0),
+        sqeTail_(0),
+        sqeHead_(0),
+        features_(0)
+    {}
+
+    ~IoUring()
+    {
+        close();
+    }
+
+    IoUring(IoUring const&) = delete;
+    IoUring& operator=(IoUring const&) = delete;
+
+    /**
+    * @brief 创建io_uring并映射提交/完成队列
+    * @param entries 提交队列的大小 完成队列是它的两倍
+    * @return 内核不支持或者被禁用的时候返回false
+    */
+    bool init(unsigned entries, unsigned flags = 0)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        params.flags = flags;
+
+        ringFd_ = int(::syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd_ < 0)
+        {
+            spdlog::error("IoUring::init io_uring_setup failed, errno {}", errno);
+            return false;
+        }
+
+        features_ = params.features;
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+        sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED)
+        {
+            spdlog::error("IoUring::init mmap sq ring failed, errno {}", errno);
+            return false;
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            cqRing_ = sqRing_;
+        }
+        else
+        {
+            cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+            if (cqRing_ == MAP_FAILED)
+            {
+                spdlog::error("IoUring::init mmap cq ring failed, errno {}", errno);
+                return false;
+            }
+        }
+
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED)
+        {
+            spdlog::error("IoUring::init mmap sqes failed, errno {}", errno);
+            return false;
+        }
+
+        uint8_t* sq = static_cast<uint8_t*>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries_ = params.sq_entries;
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        uint8_t* cq = static_cast<uint8_t*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        sqeTail_ = sqeHead_ = *sqTail_;
+        return true;
+    }
+
+    /**
+    * @brief 取一个空闲的提交项 已经清零
+    * @return 提交队列满的时候返回nullptr 需要先submit
+    */
+    io_uring_sqe* getSqe()
+    {
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (sqeTail_ - head >= sqEntries_)
+            return nullptr;
+
+        io_uring_sqe* sqe = &sqes_[sqeTail_ & sqMask_];
+        sqArray_[sqeTail_ & sqMask_] = sqeTail_ & sqMask_;
+        ++sqeTail_;
+
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    //还没有交给内核的提交项个数
+    unsigned getPendingCount() const { return sqeTail_ - sqeHead_; }
+
+    /**
+    * @brief 把getSqe之后准备好的提交项一次性交给内核
+    * @return 提交的个数 失败的时候返回-errno
+    */
+    int submit()
+    {
+        unsigned count = sqeTail_ - sqeHead_;
+        if (!count)
+            return 0;
+
+        __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+
+        int submitted = int(::syscall(__NR_io_uring_enter, ringFd_, count, 0, 0, nullptr, 0));
+        if (submitted < 0)
+            return -errno;
+
+        sqeHead_ += unsigned(submitted);
+        return submitted;
+    }
+
+    /**
+    * @brief 提交之后等待至少waitCount个完成项 只在初始化的时候使用
+    * @return 提交的个数 失败的时候返回-errno
+    */
+    int submitAndWait(unsigned waitCount)
+    {
+        unsigned count = sqeTail_ - sqeHead_;
+        __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+
+        int submitted = int(::syscall(__NR_io_uring_enter, ringFd_, count, waitCount, IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (submitted < 0)
+            return -errno;
+
+        sqeHead_ += unsigned(submitted);
+        return submitted;
+    }
+
+    /**
+    * @brief 处理所有已经完成的完成项
+    * @return 处理的个数
+    */
+    template<class Func>
+    unsigned forEachCqe(Func&& func)
+    {
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+
+        for (; head != tail; ++head, ++count)
+        {
+            //先复制出来 回调里面可能会提交新的请求
+            io_uring_cqe cqe = cqes_[head & cqMask_];
+            __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+            func(cqe);
+        }
+
+        return count;
+    }
+
+    //完成项产生的时候通知eventfd
+    bool registerEventFd(int eventFd)
+    {
+        if (::syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_EVENTFD, &eventFd, 1) < 0)
+        {
+            spdlog::error("IoUring::registerEventFd failed, errno {}", errno);
+            return false;
+        }
+
+        return true;
+    }
+
+    int getFd() const { return ringFd_; }
+
+    //io_uring_setup返回的IORING_FEAT_*
+    uint32_t getFeatures() const { return features_; }
+
+    //关闭之后内核取消所有还没有完成的请求
+    void close()
+    {
+        if (sqes_ != MAP_FAILED)
+            ::munmap(sqes_, sqesSize_);
+        if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+            ::munmap(cqRing_, cqRingSize_);
+        if (sqRing_ != MAP_FAILED)
+            ::munmap(sqRing_, sqRingSize_);
+        if (ringFd_ >= 0)
+            ::close(ringFd_);
+
+        sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+        cqRing_ = sqRing_ = MAP_FAILED;
+        ringFd_ = -1;
+    }
+
+private:
+    int ringFd_;
+    void* sqRing_;
+    void* cqRing_;
+    io_uring_sqe* sqes_;
+    std::size_t sqRingSize_;
+    std::size_t cqRingSize_;
+    std::size_t sqesSize_;
+
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned sqEntries_ = 0;
+    unsigned* sqArray_ = nullptr;
+
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    unsigned sqeTail_;  //本地已经分配到的位置
+    unsigned sqeHead_;  //已经交给内核的位置
+    uint32_t features_;
+};
+
+
+/**
+* @class IoUringBufferPool
+* @brief 交给内核的接收缓冲区(provided buffers)
+* @details 所有缓冲区切自同一个MessageBuffer 内核收到数据的时候自己挑一个空闲的 在完成项里面返回编号
+*          上层把数据拷走之后调用recycle还给内核 还回去的请求和其他请求一起提交
+*          使用IORING_OP_PROVIDE_BUFFERS而不是5.19的映射缓冲环 还缓冲区的时候用IOSQE_CQE_SKIP_SUCCESS 需要5.17
+*/
+class IoUringBufferPool
+{
+public:
+    IoUringBufferPool() :
+        uring_(nullptr),
+        count_(0),
+        bufferSize_(0),
+        groupId_(0)
+    {}
+
+    IoUringBufferPool(IoUringBufferPool const&) = delete;
+    IoUringBufferPool& operator=(IoUringBufferPool const&) = delete;
+
+    /**
+    * @param count 缓冲区个数
+    * @param bufferSize 每个缓冲区的大小
+    * @param groupId 提交接收请求时用的缓冲区组编号
+    */
+    bool init(IoUring& uring, uint16_t count, uint32_t bufferSize, uint16_t groupId)
+    {
+        uring_ = &uring;
+        count_ = count;
+        bufferSize_ = bufferSize;
+        groupId_ = groupId;
+        storage_.resize(std::size_t(count) * bufferSize);
+
+        //一个请求把所有缓冲区交给内核 编号从0开始连续 等它完成 内核不支持的时候在这里就能发现
+        io_uring_sqe* sqe = uring.getSqe();
+        if (!sqe)
+        {
+            spdlog::error("IoUringBufferPool::init submission queue is full");
+            return false;
+        }
+
+        prepare(sqe, storage_.getBasePoint(), count, 0);
+        sqe->flags = 0;
+        if (uring.submitAndWait(1) < 0)
+        {
+            spdlog::error("IoUringBufferPool::init failed to provide buffers, errno {}", errno);
+            return false;
+        }
+
+        int result = 0;
+        uring.forEachCqe([&result](io_uring_cqe const& cqe) {
+            if (cqe.res < 0)
+                result = cqe.res;
+        });
+
+        if (result < 0)
+        {
+            spdlog::error("IoUringBufferPool::init failed to provide buffers, errno {}", -result);
+            return false;
+        }
+
+        return true;
+    }
+
+    uint8_t* getBuffer(uint16_t bufferId) { return storage_.getBasePoint() + std::size_t(bufferId) * bufferSize_; }
+    uint16_t getGroupId() const { return groupId_; }
+
+    /**
+    * @brief 把缓冲区还给内核
+    * @return 提交队列满的时候返回false 需要先submit再重试
+    */
+    bool recycle(uint16_t bufferId)
+    {
+        io_uring_sqe* sqe = uring_->getSqe();
+        if (!sqe)
+            return false;
+
+        prepare(sqe, getBuffer(bufferId), 1, bufferId);
+        return true;
+    }
+
+private:
+    void prepare(io_uring_sqe* sqe, uint8_t* address, uint16_t count, uint16_t bufferId)
+    {
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = count;
+        sqe->addr = reinterpret_cast<uint64_t>(address);
+        sqe->len = bufferSize_;
+        sqe->off = bufferId;
+        sqe->buf_group = groupId_;
+        //成功的时候不产生完成项
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->user_data = 0;
+    }
+
+private:
+    IoUring* uring_;
+    uint16_t count_;
+    uint32_t bufferSize_;
+    uint16_t groupId_;
+    UTIL::MessageBuffer storage_;   //所有缓冲区
+};
+
+}
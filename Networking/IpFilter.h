@@ -0,0 +1,394 @@
+#pragma once
+
+#include <utility>
+#include <boost/asio/ip/address.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <spdlog/spdlog.h>
+
+namespace NET
+{
+
+enum IpFilterAction : uint8_t
+{
+    IP_FILTER_ALLOW,
+    IP_FILTER_DENY
+};
+
+
+/**
+* @class IpPrefixTrie
+* @brief 路径压缩的二叉基数树 按最长前缀匹配IP
+* @details IPv4地址转换成::ffff:a.b.c.d形式的IPv6地址 所以两种地址放在同一棵树里
+*          双栈监听时以IPv4映射地址连进来的客户端也能匹配IPv4规则
+*          建好之后只读 多个线程可以同时查询
+*/
+class IpPrefixTrie
+{
+public:
+    using ptr = std::shared_ptr<IpPrefixTrie>;
+    using Key = std::array<uint8_t, 16>;
+
+public:
+    IpPrefixTrie() :
+        size_(0)
+    {}
+
+    /**
+    * @brief 插入一个前缀 已经存在的时候覆盖
+    * @param prefixLength 前缀长度 IPv4为0~32 IPv6为0~128
+    */
+    void insert(boost::asio::ip::address const& address, uint8_t prefixLength, IpFilterAction action)
+    {
+        uint8_t length;
+        Key key = toKey(address, prefixLength, length);
+        insert(key, length, action);
+    }
+
+    /**
+    * @brief 查找最长匹配的前缀
+    * @return 没有任何前缀匹配的时候返回false
+    */
+    bool lookup(boost::asio::ip::address const& address, IpFilterAction& action) const
+    {
+        uint8_t length;
+        Key key = toKey(address, 128, length);
+
+        bool found = false;
+        Node const* node = root_.get();
+        while (node && matchPrefix(node->key_, key, node->length_))
+        {
+            if (node->hasValue_)
+            {
+                action = node->value_;
+                found = true;
+            }
+
+            if (node->length_ == 128)
+                break;
+
+            node = node->children_[getBit(key, node->length_)].get();
+        }
+
+        return found;
+    }
+
+    std::size_t size() const { return size_; }
+
+    //把地址转换成128位的key 并把前缀之外的位清零
+    static Key toKey(boost::asio::ip::address const& address, uint8_t prefixLength, uint8_t& length)
+    {
+        Key key;
+        if (address.is_v4())
+        {
+            key = boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped, address.to_v4()).to_bytes();
+            length = uint8_t(std::min<int>(prefixLength, 32) + 96);
+        }
+        else
+        {
+            key = address.to_v6().to_bytes();
+            length = std::min<uint8_t>(prefixLength, 128);
+        }
+
+        return maskKey(key, length);
+    }
+
+private:
+    struct Node
+    {
+        Node(Key const& key, uint8_t length) :
+            key_(key),
+            length_(length),
+            hasValue_(false),
+            value_(IP_FILTER_ALLOW)
+        {}
+
+        Key key_;           //前缀 length_之后的位都是0
+        uint8_t length_;    //前缀的位数
+        bool hasValue_;     //是否是一条规则 否则只是分叉点
+        IpFilterAction value_;
+        std::unique_ptr<Node> children_[2];     //按照第length_位选择子节点
+    };
+
+    void insert(Key const& key, uint8_t length, IpFilterAction action)
+    {
+        std::unique_ptr<Node>* slot = &root_;
+        for (;;)
+        {
+            if (!*slot)
+            {
+                *slot = makeLeaf(key, length, action);
+                return;
+            }
+
+            Node* node = slot->get();
+            uint8_t common = getCommonLength(node->key_, key, std::min(node->length_, length));
+
+            if (common == node->length_ && common == length)
+            {
+                size_ += !node->hasValue_;
+                node->hasValue_ = true;
+                node->value_ = action;
+                return;
+            }
+
+            //当前节点是新前缀的前缀 继续往下
+            if (common == node->length_)
+            {
+                slot = &node->children_[getBit(key, node->length_)];
+                continue;
+            }
+
+            //在公共前缀处分叉
+            std::unique_ptr<Node> branch = std::make_unique<Node>(maskKey(key, common), common);
+            branch->children_[getBit(node->key_, common)] = std::move(*slot);
+
+            if (common == length)
+            {
+                branch->hasValue_ = true;
+                branch->value_ = action;
+                ++size_;
+            }
+            else
+            {
+                branch->children_[getBit(key, common)] = makeLeaf(key, length, action);
+            }
+
+            *slot = std::move(branch);
+            return;
+        }
+    }
+
+    std::unique_ptr<Node> makeLeaf(Key const& key, uint8_t length, IpFilterAction action)
+    {
+        std::unique_ptr<Node> node = std::make_unique<Node>(key, length);
+        node->hasValue_ = true;
+        node->value_ = action;
+        ++size_;
+        return node;
+    }
+
+    static Key maskKey(Key key, uint8_t length)
+    {
+        for (int bit = length; bit < 128; ++bit)
+            key[bit / 8] &= uint8_t(~(0x80 >> (bit % 8)));
+        return key;
+    }
+
+    static int getBit(Key const& key, uint8_t bit)
+    {
+        return (key[bit / 8] >> (7 - bit % 8)) & 1;
+    }
+
+    //两个key从最高位开始相同的位数 最多limit位
+    static uint8_t getCommonLength(Key const& a, Key const& b, uint8_t limit)
+    {
+        uint8_t length = 0;
+        for (int i = 0; i < 16 && length < limit; ++i)
+        {
+            uint8_t diff = a[i] ^ b[i];
+            if (!diff)
+            {
+                length += 8;
+                continue;
+            }
+
+            length += uint8_t(__builtin_clz(diff) - 24);
+            break;
+        }
+
+        return std::min(length, limit);
+    }
+
+    static bool matchPrefix(Key const& prefix, Key const& key, uint8_t length)
+    {
+        return getCommonLength(prefix, key, length) == length;
+    }
+
+private:
+    std::unique_ptr<Node> root_;
+    std::size_t size_;  //规则数
+};
+
+
+/**
+* @class IpFilter
+* @brief 接受连接时的IP黑白名单
+* @details 查询不加锁: 规则修改的时候重新建一棵树 用原子指针替换 等旧树上的读者都退出之后再释放(RCU)
+*          读者按照epoch的奇偶登记在两个计数器上 写者切换epoch之后只需要等旧的计数器归零
+*          修改规则比较少 每次修改都完整重建 规则的修改之间用mutex串行
+*/
+class IpFilter
+{
+public:
+    using ptr = std::shared_ptr<IpFilter>;
+
+public:
+    explicit IpFilter(IpFilterAction defaultAction = IP_FILTER_ALLOW) :
+        current_(new IpPrefixTrie()),
+        epoch_(0),
+        readers_{ {0}, {0} },
+        defaultAction_(defaultAction),
+        rejectedCount_(0)
+    {}
+
+    ~IpFilter()
+    {
+        delete current_.load();
+    }
+
+    //是否允许该地址连接 任意线程都可以调用 不加锁
+    bool isAllowed(boost::asio::ip::address const& address)
+    {
+        uint32_t epoch;
+        for (;;)
+        {
+            epoch = epoch_.load() & 1;
+            readers_[epoch].fetch_add(1);
+            if ((epoch_.load() & 1) == epoch)
+                break;
+
+            //写者刚好切换了epoch 重新登记 保证写者能等到自己
+            readers_[epoch].fetch_sub(1);
+        }
+
+        IpFilterAction action = defaultAction_.load(std::memory_order_relaxed);
+        current_.load()->lookup(address, action);
+
+        readers_[epoch].fetch_sub(1, std::memory_order_release);
+
+        if (action == IP_FILTER_DENY)
+        {
+            rejectedCount_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+    * @brief 添加/覆盖一条规则
+    * @param cidr "1.2.3.0/24" "2001:db8::/32" 不带长度表示单个地址
+    * @return 格式错误的时候返回false
+    */
+    bool addRule(std::string const& cidr, IpFilterAction action)
+    {
+        RuleKey key;
+        if (!parseRule(cidr, key))
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        rules_[key] = action;
+        rebuild();
+        return true;
+    }
+
+    bool removeRule(std::string const& cidr)
+    {
+        RuleKey key;
+        if (!parseRule(cidr, key))
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!rules_.erase(key))
+            return false;
+
+        rebuild();
+        return true;
+    }
+
+    void clearRules()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rules_.clear();
+        rebuild();
+    }
+
+    //没有规则匹配的时候的默认动作
+    void setDefaultAction(IpFilterAction action)
+    {
+        defaultAction_ = action;
+    }
+
+    std::size_t getRuleCount()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return rules_.size();
+    }
+
+    //被拒绝的连接数
+    uint64_t getRejectedCount() const { return rejectedCount_; }
+
+private:
+    using RuleKey = std::pair<IpPrefixTrie::Key, uint8_t>;
+
+    static bool parseRule(std::string const& cidr, RuleKey& key)
+    {
+        std::string::size_type slash = cidr.find('/');
+        boost::system::error_code error;
+        boost::asio::ip::address address = boost::asio::ip::make_address(cidr.substr(0, slash), error);
+        if (error)
+        {
+            spdlog::error("IpFilter::parseRule invalid address {}", cidr);
+            return false;
+        }
+
+        int prefixLength = address.is_v4() ? 32 : 128;
+        if (slash != std::string::npos)
+        {
+            try
+            {
+                prefixLength = std::stoi(cidr.substr(slash + 1));
+            }
+            catch (std::exception const&)
+            {
+                prefixLength = -1;
+            }
+
+            if (prefixLength < 0 || prefixLength > (address.is_v4() ? 32 : 128))
+            {
+                spdlog::error("IpFilter::parseRule invalid prefix length {}", cidr);
+                return false;
+            }
+        }
+
+        key.first = IpPrefixTrie::toKey(address, uint8_t(prefixLength), key.second);
+        return true;
+    }
+
+    //已经持有mutex_
+    void rebuild()
+    {
+        IpPrefixTrie* trie = new IpPrefixTrie();
+        for (auto const& [key, action] : rules_)
+            trie->insert(boost::asio::ip::address_v6(key.first), key.second, action);
+
+        //新的读者都会看到新树 等还在旧树上的读者退出
+        IpPrefixTrie* old = current_.exchange(trie);
+        uint32_t oldEpoch = epoch_.fetch_add(1) & 1;
+        while (readers_[oldEpoch].load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+        delete old;
+    }
+
+private:
+    std::atomic<IpPrefixTrie*> current_;    //当前生效的规则
+    std::atomic<uint32_t> epoch_;
+    std::atomic<uint32_t> readers_[2];      //按照epoch奇偶登记的读者数
+
+    std::atomic<IpFilterAction> defaultAction_;
+    std::atomic<uint64_t> rejectedCount_;
+
+    std::mutex mutex_;
+    std::map<RuleKey, IpFilterAction> rules_;   //所有规则 用来重建
+};
+
+
+}
@@ -2,6 +2,7 @@
 
 
 #include <algorithm>
+#include <utility>
 #include <boost/asio.hpp>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/io_context.hpp>
@@ -14,10 +15,19 @@
 #include <thread>
 #include <vector>
 #include <spdlog/spdlog.h>
+#include "UringService.h"
+#include "../Threading/ProfiledMutex.h"
 
 namespace NET
 {
 
+//网络线程收发数据使用的后端
+enum NetworkBackend : uint8_t
+{
+    NETWORK_BACKEND_ASIO,       //asio的reactor
+    NETWORK_BACKEND_IO_URING    //io_uring 内核不支持的时候退回到asio
+};
+
 template <typename SocketType>
 class NetworkThread
 {
@@ -33,8 +43,11 @@ public:
         connsCount_(0),
         stopped_(false),
         thread_(nullptr),
-        updateTimer_(ioc_)
-    {}
+        updateTimer_(ioc_),
+        backend_(NETWORK_BACKEND_ASIO)
+    {
+        THREADING::nameMutex(mutex_, "NetworkThread");
+    }
 
     ~NetworkThread()
     {
@@ -72,12 +85,38 @@ public:
             return false;
         }
 
+        if (backend_ == NETWORK_BACKEND_IO_URING)
+        {
+            uring_ = UringService::create(ioc_);
+            if (!uring_)
+            {
+                spdlog::error("NetworkThread::start io_uring is not available, fall back to asio");
+                backend_ = NETWORK_BACKEND_ASIO;
+            }
+        }
 
         thread_  = new std::thread(std::bind(&NetworkThread::run, this));
 
         return true;
     }
 
+    //设置收发数据的后端 需要在start之前调用
+    void setBackend(NetworkBackend backend)
+    {
+        backend_ = backend;
+    }
+
+    NetworkBackend getBackend() const
+    {
+        return backend_;
+    }
+
+    //使用io_uring后端的时候 该线程的连接需要通过Socket::setUringService使用它 否则返回nullptr
+    UringService* getUringService() const
+    {
+        return uring_.get();
+    }
+
     uint32_t getConnsCount() const
     {
         return connsCount_;
@@ -85,7 +124,7 @@ public:
 
     virtual void addNewSocket(std::shared_ptr<SocketType> sock)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<THREADING::Mutex> lock(mutex_);
         newConns_.push_back(sock);
         ++connsCount_;
         socketAdded(sock);
@@ -96,6 +135,12 @@ public:
         return &newClientSock_;
     }
 
+    //该线程的事件循环 在这个io_context上创建的socket 其回调都在该线程执行
+    boost::asio::io_context& getIoContext()
+    {
+        return ioc_;
+    }
+
 
 protected:
     virtual void socketAdded(std::shared_ptr<SocketType> /*sock*/) { }
@@ -103,7 +148,7 @@ protected:
 
     void addNewSockets()
     {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<THREADING::Mutex> lock(mutex_);
 
         if (newConns_.empty()) 
         {
@@ -177,10 +222,14 @@ protected:
 
             return false;
         }), conns_.end());
+
+        //这一轮所有连接准备好的发送一次提交
+        if (uring_)
+            uring_->submit();
     }
 
 private:
-    std::mutex mutex_;
+    THREADING::Mutex mutex_;
 
 
     SocketContainer conns_;
@@ -194,6 +243,9 @@ private:
     std::thread* thread_; //one thread one loop
     
     boost::asio::steady_timer updateTimer_; //更新定时器
+
+    NetworkBackend backend_;
+    UringService::ptr uring_;   //放在ioc_之后 先于ioc_析构
 };
 
 
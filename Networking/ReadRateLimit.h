@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "../Utilities/TokenBucket.h"
+
+namespace NET
+{
+
+/**
+* @struct ReadRateLimit
+* @brief 入站流量的限速配置 速率为0表示该项不限速
+*/
+struct ReadRateLimit
+{
+    uint32_t bytesPerSecond = 0;    //每秒允许读取的字节数
+    uint32_t bytesBurst = 0;        //字节桶容量
+    uint32_t packetsPerSecond = 0;  //每秒允许处理的包数
+    uint32_t packetsBurst = 0;      //包桶容量
+
+    bool isEnabled() const { return bytesPerSecond || packetsPerSecond; }
+};
+
+
+/**
+* @class ReadRateLimiter
+* @brief 字节桶+包桶 同一个IP的所有连接共享一个 会被多个网络线程同时访问 所以需要加锁
+*/
+class ReadRateLimiter
+{
+public:
+    using ptr = std::shared_ptr<ReadRateLimiter>;
+
+public:
+    explicit ReadRateLimiter(ReadRateLimit const& limit) :
+        bytes_(limit.bytesPerSecond, limit.bytesBurst),
+        packets_(limit.packetsPerSecond, limit.packetsBurst)
+    {}
+
+    void consumeBytes(std::size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bytes_.consume(double(bytes));
+    }
+
+    void consumePackets(uint32_t packets)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        packets_.consume(double(packets));
+    }
+
+    //还需要等待多久才能继续读取
+    UTIL::TokenBucket::clock::duration getDelay()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::max(bytes_.getDelay(), packets_.getDelay());
+    }
+
+private:
+    std::mutex mutex_;
+    UTIL::TokenBucket bytes_;
+    UTIL::TokenBucket packets_;
+};
+
+
+}
@@ -0,0 +1,462 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "Socket.h"
+#include "../Utilities/MessageBuffer.h"
+
+namespace NET
+{
+
+#define RPC_MAX_PAYLOAD_SIZE (16 * 1024 * 1024)
+
+enum RpcFrameType : uint8_t
+{
+    RPC_FRAME_REQUEST,  //请求
+    RPC_FRAME_RESPONSE  //响应
+};
+
+enum RpcStatus : uint8_t
+{
+    RPC_STATUS_OK,              //成功
+    RPC_STATUS_ERROR,           //对端处理失败
+    RPC_STATUS_UNKNOWN_METHOD,  //对端没有注册该方法
+    RPC_STATUS_TIMEOUT,         //超过了调用的截止时间
+    RPC_STATUS_CLOSED           //连接断开
+};
+
+#pragma pack(push, 1)
+/**
+* @struct RpcHeader
+* @brief 每一帧的头部 后面紧跟size字节的payload
+*/
+struct RpcHeader
+{
+    uint32_t size;      //payload的长度
+    uint32_t method;    //方法id
+    uint64_t callId;    //关联请求与响应
+    uint8_t type;       //RpcFrameType
+    uint8_t status;     //RpcStatus 只对响应有意义
+};
+#pragma pack(pop)
+
+
+struct RpcResponse
+{
+    RpcStatus status;
+    UTIL::MessageBuffer payload;
+};
+
+using RpcCallback = std::function<void(RpcResponse&&)>;
+
+
+/**
+* @class RpcCompletionQueue
+* @brief 调用方线程的完成队列
+* @details 网络线程只负责把回调放进来 调用方在自己的线程里poll 回调就在调用方线程执行
+*/
+class RpcCompletionQueue
+{
+public:
+    using ptr = std::shared_ptr<RpcCompletionQueue>;
+
+public:
+    void push(std::function<void()>&& completion)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        completions_.push_back(std::move(completion));
+    }
+
+    /**
+    * @brief 执行所有已经完成的回调
+    * @return 执行了多少个回调
+    */
+    std::size_t poll()
+    {
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready.swap(completions_);
+        }
+
+        for (std::function<void()>& completion : ready)
+            completion();
+
+        return ready.size();
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::function<void()>> completions_;
+};
+
+
+class RpcSocket;
+
+/**
+* @class RpcRequest
+* @brief 收到的一个请求 处理函数可以在任意线程 任意时间调用respond
+*/
+class RpcRequest
+{
+public:
+    RpcRequest(std::weak_ptr<RpcSocket> socket, uint32_t method, uint64_t callId, UTIL::MessageBuffer&& payload) :
+        socket_(std::move(socket)),
+        method_(method),
+        callId_(callId),
+        payload_(std::move(payload))
+    {}
+
+    uint32_t getMethod() const { return method_; }
+    uint64_t getCallId() const { return callId_; }
+    UTIL::MessageBuffer& getPayload() { return payload_; }
+
+    //回复调用方 连接已经断开的话直接丢弃
+    inline void respond(UTIL::MessageBuffer&& payload, RpcStatus status = RPC_STATUS_OK) const;
+
+    void fail() const { respond(UTIL::MessageBuffer(0), RPC_STATUS_ERROR); }
+
+private:
+    std::weak_ptr<RpcSocket> socket_;
+    uint32_t method_;
+    uint64_t callId_;
+    UTIL::MessageBuffer payload_;
+};
+
+
+/**
+* @class RpcService
+* @brief 方法id到处理函数的映射 在网络启动之前注册好 之后只读
+*/
+class RpcService
+{
+public:
+    using ptr = std::shared_ptr<RpcService>;
+    using Handler = std::function<void(RpcRequest&&)>;
+
+public:
+    void registerHandler(uint32_t method, Handler&& handler)
+    {
+        handlers_[method] = std::move(handler);
+    }
+
+    Handler const* findHandler(uint32_t method) const
+    {
+        auto it = handlers_.find(method);
+        return it == handlers_.end() ? nullptr : &it->second;
+    }
+
+    //新建的RpcSocket默认使用的服务
+    static void setDefault(ptr service) { defaultService() = std::move(service); }
+    static ptr getDefault() { return defaultService(); }
+
+private:
+    static ptr& defaultService()
+    {
+        static ptr service;
+        return service;
+    }
+
+private:
+    std::unordered_map<uint32_t, Handler> handlers_;
+};
+
+
+/**
+* @class RpcSocket
+* @brief 基于Socket的请求/响应层
+* @details 一条连接上可以同时有任意多个调用 通过callId关联响应 响应可以乱序返回
+*          call可以在任意线程调用 发出去的帧先放到outbox_里面 由网络线程在update里面放进发送队列
+*          每个调用都有截止时间 同样在update里面检查超时
+*/
+class RpcSocket : public Socket<RpcSocket>
+{
+public:
+    using ptr = std::shared_ptr<RpcSocket>;
+    using clock = std::chrono::steady_clock;
+
+public:
+    RpcSocket(boost::asio::ip::tcp::socket&& s) :
+        Socket<RpcSocket>(std::move(s)),
+        service_(RpcService::getDefault()),
+        nextCallId_(1),
+        callsClosed_(false)
+    {}
+
+    void start() override
+    {
+        setNoDelay(true);
+        asyncRead();
+    }
+
+    bool update() override
+    {
+        flushOutbox();
+        expireCalls();
+        return Socket<RpcSocket>::update();
+    }
+
+    void setService(RpcService::ptr service) { service_ = std::move(service); }
+
+    /**
+    * @brief 发起调用 结果通过future返回
+    * @param method 方法id
+    * @param payload 请求的数据
+    * @param timeout 超过这个时间还没有收到响应 以RPC_STATUS_TIMEOUT完成
+    */
+    std::future<RpcResponse> call(uint32_t method, UTIL::MessageBuffer&& payload, std::chrono::milliseconds timeout)
+    {
+        std::shared_ptr<std::promise<RpcResponse>> promise = std::make_shared<std::promise<RpcResponse>>();
+        std::future<RpcResponse> future = promise->get_future();
+
+        startCall(method, std::move(payload), timeout, [promise](RpcResponse&& response){
+            promise->set_value(std::move(response));
+        });
+
+        return future;
+    }
+
+    /**
+    * @brief 发起调用 结果回调放到调用方的完成队列里 在调用方poll的时候执行
+    */
+    void call(uint32_t method, UTIL::MessageBuffer&& payload, std::chrono::milliseconds timeout,
+        RpcCompletionQueue::ptr queue, RpcCallback&& callback)
+    {
+        startCall(method, std::move(payload), timeout, [queue, callback = std::move(callback)](RpcResponse&& response){
+            std::shared_ptr<RpcResponse> result = std::make_shared<RpcResponse>(std::move(response));
+            queue->push([callback, result](){
+                callback(std::move(*result));
+            });
+        });
+    }
+
+    //发送响应 线程安全
+    void sendResponse(uint32_t method, uint64_t callId, RpcStatus status, UTIL::MessageBuffer const& payload)
+    {
+        enqueueFrame(encodeFrame(RPC_FRAME_RESPONSE, status, method, callId, payload));
+    }
+
+    std::size_t getPendingCallCount()
+    {
+        std::lock_guard<std::mutex> lock(callsMutex_);
+        return calls_.size();
+    }
+
+protected:
+    //解析出所有完整的帧 不完整的留在接收缓冲区里面等下一次读
+    void readHandler() override
+    {
+        UTIL::MessageBuffer& readBuf = GetReadBuffer();
+        uint32_t frames = 0;
+
+        while (readBuf.getActiveSize() >= sizeof(RpcHeader))
+        {
+            RpcHeader header;
+            memcpy(&header, readBuf.getReadPoint(), sizeof(header));
+
+            if (header.size > RPC_MAX_PAYLOAD_SIZE)
+            {
+                spdlog::error("RpcSocket::readHandler frame too large {} from {}", header.size, getRemoteAddress().to_string());
+                closeSocket();
+                return;
+            }
+
+            std::size_t frameSize = sizeof(RpcHeader) + header.size;
+            if (readBuf.getActiveSize() < frameSize)
+            {
+                //大帧需要把接收缓冲区扩大 否则永远读不完整
+                if (readBuf.getBufferSize() < frameSize)
+                {
+                    readBuf.normalize();
+                    readBuf.resize(frameSize);
+                }
+                break;
+            }
+
+            UTIL::MessageBuffer payload(header.size);
+            payload.write(readBuf.getReadPoint() + sizeof(RpcHeader), header.size);
+            readBuf.readCommit(frameSize);
+            ++frames;
+
+            if (header.type == RPC_FRAME_REQUEST)
+                dispatchRequest(header, std::move(payload));
+            else
+                completeCall(header.callId, RpcResponse{RpcStatus(header.status), std::move(payload)});
+        }
+
+        consumeInboundPackets(frames);
+        asyncRead();
+    }
+
+    //连接断开 所有还没完成的调用以RPC_STATUS_CLOSED完成
+    void onClose() override
+    {
+        std::unordered_map<uint64_t, PendingCall> calls;
+        {
+            std::lock_guard<std::mutex> lock(callsMutex_);
+            callsClosed_ = true;
+            calls.swap(calls_);
+            deadlines_.clear();
+        }
+
+        for (auto& [callId, call] : calls)
+            call.complete_(RpcResponse{RPC_STATUS_CLOSED, UTIL::MessageBuffer(0)});
+    }
+
+private:
+    using DeadlineMap = std::multimap<clock::time_point, uint64_t>;
+
+    struct PendingCall
+    {
+        uint32_t method_;
+        std::function<void(RpcResponse&&)> complete_;
+        DeadlineMap::iterator deadline_;    //完成的时候从deadlines_里删掉 不用等到超时
+    };
+
+    void startCall(uint32_t method, UTIL::MessageBuffer&& payload, std::chrono::milliseconds timeout,
+        std::function<void(RpcResponse&&)>&& complete)
+    {
+        uint64_t callId = nextCallId_++;
+        bool closed = false;
+        {
+            std::lock_guard<std::mutex> lock(callsMutex_);
+            closed = callsClosed_;
+            if (!closed)
+            {
+                auto deadline = deadlines_.emplace(clock::now() + timeout, callId);
+                calls_.emplace(callId, PendingCall{method, std::move(complete), deadline});
+            }
+        }
+
+        //连接已经断开了
+        if (closed)
+        {
+            complete(RpcResponse{RPC_STATUS_CLOSED, UTIL::MessageBuffer(0)});
+            return;
+        }
+
+        enqueueFrame(encodeFrame(RPC_FRAME_REQUEST, RPC_STATUS_OK, method, callId, payload));
+    }
+
+    void completeCall(uint64_t callId, RpcResponse&& response)
+    {
+        PendingCall call;
+        {
+            std::lock_guard<std::mutex> lock(callsMutex_);
+            auto it = calls_.find(callId);
+            //已经超时的调用 迟到的响应直接丢掉
+            if (it == calls_.end())
+                return;
+
+            call = std::move(it->second);
+            calls_.erase(it);
+            deadlines_.erase(call.deadline_);
+        }
+
+        call.complete_(std::move(response));
+    }
+
+    void dispatchRequest(RpcHeader const& header, UTIL::MessageBuffer&& payload)
+    {
+        RpcService::Handler const* handler = service_ ? service_->findHandler(header.method) : nullptr;
+        if (!handler)
+        {
+            sendResponse(header.method, header.callId, RPC_STATUS_UNKNOWN_METHOD, UTIL::MessageBuffer(0));
+            return;
+        }
+
+        (*handler)(RpcRequest(weak_from_this(), header.method, header.callId, std::move(payload)));
+    }
+
+    //检查截止时间 deadlines_按时间排序 只需要看最前面的
+    void expireCalls()
+    {
+        std::vector<PendingCall> expired;
+        {
+            std::lock_guard<std::mutex> lock(callsMutex_);
+            clock::time_point now = clock::now();
+
+            while (!deadlines_.empty() && deadlines_.begin()->first <= now)
+            {
+                auto it = calls_.find(deadlines_.begin()->second);
+                if (it != calls_.end())
+                {
+                    expired.push_back(std::move(it->second));
+                    calls_.erase(it);
+                }
+                deadlines_.erase(deadlines_.begin());
+            }
+        }
+
+        for (PendingCall& call : expired)
+            call.complete_(RpcResponse{RPC_STATUS_TIMEOUT, UTIL::MessageBuffer(0)});
+    }
+
+    static UTIL::MessageBuffer encodeFrame(RpcFrameType type, RpcStatus status, uint32_t method, uint64_t callId,
+        UTIL::MessageBuffer const& payload)
+    {
+        RpcHeader header;
+        header.size = uint32_t(payload.getActiveSize());
+        header.method = method;
+        header.callId = callId;
+        header.type = type;
+        header.status = status;
+
+        UTIL::MessageBuffer frame(sizeof(RpcHeader) + header.size);
+        frame.write(&header, sizeof(header));
+        frame.write(const_cast<UTIL::MessageBuffer&>(payload).getReadPoint(), header.size);
+        return frame;
+    }
+
+    //其他线程发出的帧 先放到outbox_ 由网络线程搬到发送队列
+    void enqueueFrame(UTIL::MessageBuffer&& frame)
+    {
+        std::lock_guard<std::mutex> lock(outboxMutex_);
+        outbox_.push_back(std::move(frame));
+    }
+
+    void flushOutbox()
+    {
+        std::vector<UTIL::MessageBuffer> frames;
+        {
+            std::lock_guard<std::mutex> lock(outboxMutex_);
+            if (outbox_.empty())
+                return;
+            frames.swap(outbox_);
+        }
+
+        for (UTIL::MessageBuffer& frame : frames)
+            queuePacket(std::move(frame));
+    }
+
+private:
+    RpcService::ptr service_;
+    std::atomic<uint64_t> nextCallId_;
+
+    std::mutex callsMutex_;
+    bool callsClosed_;      //连接已经关闭 不再接受新的调用
+    std::unordered_map<uint64_t, PendingCall> calls_;       //还没有完成的调用
+    DeadlineMap deadlines_;     //<截止时间, callId> 和calls_一一对应
+
+    std::mutex outboxMutex_;
+    std::vector<UTIL::MessageBuffer> outbox_;   //等待网络线程发送的帧
+};
+
+
+inline void RpcRequest::respond(UTIL::MessageBuffer&& payload, RpcStatus status) const
+{
+    if (RpcSocket::ptr socket = socket_.lock())
+        socket->sendResponse(method_, callId_, status, payload);
+}
+
+
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string.h>
+#include <unistd.h>
+#include "../Utilities/MessageBuffer.h"
+
+#define SHM_RING_CACHE_LINE 64
+#define SHM_RING_RECORD_HEADER 8            //每条记录前面的长度字段 保持8字节对齐
+#define SHM_RING_EMPTY_RECORD 0u            //还没有提交的记录
+#define SHM_RING_PAD_RECORD 0xFFFFFFFFu     //填充记录 表示跳到环的开头
+
+namespace NET
+{
+
+/**
+* @struct ShmRingHeader
+* @brief 放在共享内存开头的环形缓冲区控制信息 两个进程通过它同步
+* @details 所有位置都是单调递增的字节偏移 对capacity取模得到实际位置
+*/
+struct ShmRingHeader
+{
+    alignas(SHM_RING_CACHE_LINE) std::atomic<uint64_t> reserve_;   //生产者已经预留到的位置
+    alignas(SHM_RING_CACHE_LINE) std::atomic<uint64_t> tail_;      //消费者已经读到的位置
+    alignas(SHM_RING_CACHE_LINE) std::atomic<uint32_t> consumerWaiting_;   //消费者是否在eventfd上等待
+    std::atomic<uint32_t> closed_;  //写端已经关闭
+    uint64_t capacity_;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ShmRing requires lock-free 64-bit atomics");
+
+
+/**
+* @class ShmRing
+* @brief 共享内存中的多生产者单消费者环形缓冲区
+* @details 每次写入是一条完整的消息(记录) 生产者用CAS预留空间 写完数据之后再写长度字段表示提交
+*          生产者之间互不等待 消费者读到第一条没有提交的记录就停下 读过的区域清零之后才还给生产者
+*          数据的读写都是内存拷贝 只有消费者在等待的时候才通过eventfd唤醒一次
+*/
+class ShmRing
+{
+public:
+    ShmRing() :
+        header_(nullptr),
+        data_(nullptr),
+        mask_(0),
+        notifyFd_(-1)
+    {}
+
+    //capacity字节的环需要映射多大的共享内存
+    static std::size_t getMappedSize(std::size_t capacity)
+    {
+        return sizeof(ShmRingHeader) + capacity;
+    }
+
+    /**
+    * @brief 绑定到一段共享内存
+    * @param base 共享内存的起始地址 大小至少为getMappedSize(capacity)
+    * @param capacity 环的大小 必须是2的幂
+    * @param init 是否初始化控制信息 只有创建共享内存的一方初始化
+    * @param notifyFd 唤醒消费者用的eventfd 由调用者管理
+    */
+    void attach(void* base, std::size_t capacity, bool init, int notifyFd)
+    {
+        header_ = static_cast<ShmRingHeader*>(base);
+        data_ = static_cast<uint8_t*>(base) + sizeof(ShmRingHeader);
+        mask_ = capacity - 1;
+        notifyFd_ = notifyFd;
+
+        if (init)
+        {
+            header_->reserve_.store(0, std::memory_order_relaxed);
+            header_->tail_.store(0, std::memory_order_relaxed);
+            header_->consumerWaiting_.store(0, std::memory_order_relaxed);
+            header_->closed_.store(0, std::memory_order_relaxed);
+            header_->capacity_ = capacity;
+        }
+    }
+
+    std::size_t getCapacity() const { return mask_ + 1; }
+
+    //单条消息的最大长度 保证回绕的时候也放得下
+    std::size_t getMaxMessageSize() const { return getCapacity() / 2 - SHM_RING_RECORD_HEADER; }
+
+    /**
+    * @brief 写入一条消息 多个线程/进程可以同时调用
+    * @return 空间不足的时候返回false 什么都不写
+    */
+    bool tryWrite(const void* data, uint32_t size)
+    {
+        if (size > getMaxMessageSize())
+            return false;
+
+        uint64_t need = getRecordSize(size);
+        uint64_t capacity = getCapacity();
+        uint64_t pos = header_->reserve_.load(std::memory_order_relaxed);
+        uint64_t total;
+
+        for (;;)
+        {
+            //尾部放不下的时候 用一条填充记录把剩下的空间占掉
+            uint64_t contiguous = capacity - (pos & mask_);
+            total = need <= contiguous ? need : contiguous + need;
+
+            if (pos + total - header_->tail_.load(std::memory_order_acquire) > capacity)
+                return false;
+
+            if (header_->reserve_.compare_exchange_weak(pos, pos + total, std::memory_order_acq_rel, std::memory_order_relaxed))
+                break;
+        }
+
+        uint64_t recordPos = pos;
+        if (total != need)
+        {
+            getRecordHeader(pos).store(SHM_RING_PAD_RECORD, std::memory_order_release);
+            recordPos = pos + total - need;
+        }
+
+        memcpy(data_ + ((recordPos + SHM_RING_RECORD_HEADER) & mask_), data, size);
+        getRecordHeader(recordPos).store(size + 1, std::memory_order_release);
+
+        //和消费者的prepareWait配对 避免丢失唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header_->consumerWaiting_.load(std::memory_order_relaxed) && header_->consumerWaiting_.exchange(0))
+            notify();
+
+        return true;
+    }
+
+    /**
+    * @brief 读出已经提交的消息 追加到out的末尾 只能由消费者调用
+    * @param maxBytes 最多读取的字节数 至少会读取一条消息
+    * @return 读取的消息条数
+    */
+    uint32_t read(UTIL::MessageBuffer& out, std::size_t maxBytes)
+    {
+        uint64_t tail = header_->tail_.load(std::memory_order_relaxed);
+        uint64_t capacity = getCapacity();
+        std::size_t bytes = 0;
+        uint32_t count = 0;
+
+        while (count == 0 || bytes < maxBytes)
+        {
+            uint32_t value = getRecordHeader(tail).load(std::memory_order_acquire);
+            if (value == SHM_RING_EMPTY_RECORD)
+                break;
+
+            uint64_t length;
+            if (value == SHM_RING_PAD_RECORD)
+            {
+                length = capacity - (tail & mask_);
+            }
+            else
+            {
+                uint32_t size = value - 1;
+                if (out.getRemainingSpace() < size)
+                    out.resize(out.getBufferSize() + size);
+
+                out.write(data_ + ((tail + SHM_RING_RECORD_HEADER) & mask_), size);
+                length = getRecordSize(size);
+                bytes += size;
+                ++count;
+            }
+
+            //清零之后这块区域里的任意位置都可以作为新记录的长度字段
+            memset(data_ + (tail & mask_), 0, length);
+            tail += length;
+        }
+
+        header_->tail_.store(tail, std::memory_order_release);
+        return count;
+    }
+
+    bool isEmpty() const
+    {
+        return getRecordHeader(header_->tail_.load(std::memory_order_relaxed)).load(std::memory_order_acquire) == SHM_RING_EMPTY_RECORD;
+    }
+
+    /**
+    * @brief 消费者准备在eventfd上等待
+    * @return false表示在设置等待标志之后又有了新数据 不需要等待
+    */
+    bool prepareWait()
+    {
+        header_->consumerWaiting_.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!isEmpty())
+        {
+            header_->consumerWaiting_.store(0, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    //写端关闭 并唤醒消费者
+    void close()
+    {
+        header_->closed_.store(1, std::memory_order_release);
+        notify();
+    }
+
+    bool isClosed() const { return header_->closed_.load(std::memory_order_acquire); }
+
+private:
+    static uint64_t getRecordSize(uint32_t size)
+    {
+        return SHM_RING_RECORD_HEADER + ((uint64_t(size) + 7) & ~uint64_t(7));
+    }
+
+    //记录的长度字段 0表示还没有提交 否则为消息长度+1
+    std::atomic<uint32_t>& getRecordHeader(uint64_t pos) const
+    {
+        return *reinterpret_cast<std::atomic<uint32_t>*>(data_ + (pos & mask_));
+    }
+
+    void notify()
+    {
+        uint64_t one = 1;
+        if (notifyFd_ >= 0)
+            (void)!::write(notifyFd_, &one, sizeof(one));
+    }
+
+private:
+    ShmRingHeader* header_;
+    uint8_t* data_;
+    uint64_t mask_;
+    int notifyFd_;  //eventfd
+};
+
+
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <utility>
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include "ShmTransport.h"
+#include "../Utilities/MessageBuffer.h"
+
+#define SHM_READ_BLOCK_SIZE 4096
+#define SHM_READ_BATCH_SIZE (64 * 1024)     //一次readHandler最多交给上层的字节数
+
+namespace NET
+{
+
+/**
+* @class ShmSocket
+* @brief 基于共享内存的连接 接口与Socket一致 可以交给NetworkThread管理
+* @details 每次queuePacket的数据作为一条完整的消息写入对端的环 对端读出来之后按顺序追加到接收缓冲区
+*          所以readHandler看到的仍然是字节流 原来的解包逻辑不需要修改 超过环单条消息上限的数据分成多条写入
+*          数据的收发都是内存拷贝 只有对端在等待的时候才会写一次eventfd唤醒
+*          握手用的unix socket保留下来 对端进程退出的时候用来感知断开
+*/
+template <typename T>
+class ShmSocket : public std::enable_shared_from_this<T>
+{
+public:
+    using ptr = std::shared_ptr<ShmSocket>;
+
+public:
+    ShmSocket(boost::asio::local::stream_protocol::socket&& control, ShmChannel::ptr channel) :
+        control_(std::move(control)),
+        channel_(std::move(channel)),
+        notifier_(control_.get_executor()),
+        closed_(false),
+        closing_(false),
+        isWaiting_(false),
+        isWatchingPeer_(false),
+        peerGone_(false),
+        recvBuf_(SHM_READ_BLOCK_SIZE),
+        eventValue_(0),
+        peerPid_(0)
+    {
+        //stream_descriptor析构的时候会关闭fd 通道里的eventfd由ShmChannel管理
+        notifier_.assign(::dup(channel_->getRecvEventFd()));
+
+        ucred cred{};
+        socklen_t len = sizeof(cred);
+        if (!::getsockopt(control_.native_handle(), SOL_SOCKET, SO_PEERCRED, &cred, &len))
+            peerPid_ = cred.pid;
+    }
+
+    virtual ~ShmSocket()
+    {
+        closed_ = true;
+        boost::system::error_code error;
+        control_.close(error);
+    }
+
+
+    virtual void start() = 0;
+
+    //网络线程不断调用update 把环满的时候积压的消息写进去
+    virtual bool update()
+    {
+        if (closed_)
+            return false;
+
+        while (!sendQueue_.empty())
+        {
+            if (!writeToRing(sendQueue_.front()))
+                break;
+
+            sendQueue_.pop_front();
+        }
+
+        if (closing_ && sendQueue_.empty())
+            closeSocket();
+
+        return true;
+    }
+
+    //对端进程号
+    pid_t getPeerPid() const { return peerPid_; }
+
+    bool IsOpen() const { return !closed_ && !closing_; }
+
+    std::size_t getSendQueueSize() const { return sendQueue_.size(); }
+
+
+    void closeSocket()
+    {
+        if (closed_.exchange(true))
+            return;
+
+        //告诉对端不会再有数据 对端读完环里剩下的数据之后关闭
+        channel_->getSendRing().close();
+
+        boost::system::error_code error;
+        control_.shutdown(boost::asio::local::stream_protocol::socket::shutdown_send, error);
+        control_.cancel(error);
+        notifier_.cancel(error);
+
+        onClose();
+    }
+
+    //当发送队列里面没有数据的时候 将连接关闭
+    void delayCloseSocket()
+    {
+        if (closing_.exchange(true))
+            return;
+
+        if (sendQueue_.empty())
+            closeSocket();
+    }
+
+
+    UTIL::MessageBuffer& GetReadBuffer() { return recvBuf_; }
+
+    /**
+    * @brief 发送一条消息 只能在网络线程调用
+    * @details 环有空间并且没有积压的时候直接写入 否则排队等update 写了一部分的话剩下的排队
+    */
+    void queuePacket(UTIL::MessageBuffer&& buffer)
+    {
+        if (sendQueue_.empty() && writeToRing(buffer))
+            return;
+
+        sendQueue_.push_back(std::move(buffer));
+    }
+
+    /**
+    * @brief 直接写入对端的环 任意线程都可以调用
+    * @details 不经过发送队列 所以和queuePacket之间不保证顺序
+    * @return 环满的时候返回false
+    */
+    bool trySend(const void* data, uint32_t size)
+    {
+        if (closed_)
+            return false;
+
+        return channel_->getSendRing().tryWrite(data, size);
+    }
+
+protected:
+    virtual void onClose() { }
+    virtual void readHandler() = 0;
+
+    //与Socket::asyncRead一样 readHandler处理完数据之后调用 等待下一批数据
+    void asyncRead()
+    {
+        if (!IsOpen() || isWaiting_)
+            return;
+
+        if (!isWatchingPeer_)
+            watchPeer();
+
+        ShmRing& ring = channel_->getRecvRing();
+        if (!ring.isEmpty() || ring.isClosed() || peerGone_ || !ring.prepareWait())
+        {
+            //已经有数据了 投递到事件循环里面处理 避免readHandler递归
+            isWaiting_ = true;
+            boost::asio::post(control_.get_executor(),
+                std::bind(&ShmSocket<T>::readHandlerInternal, this->shared_from_this(), boost::system::error_code()));
+            return;
+        }
+
+        isWaiting_ = true;
+        notifier_.async_read_some(boost::asio::buffer(&eventValue_, sizeof(eventValue_)),
+            std::bind(&ShmSocket<T>::notifyHandler, this->shared_from_this(), std::placeholders::_1));
+    }
+
+private:
+    //按环的单条消息上限分成多条写入 环满的时候返回false 已经写入的部分从buffer里扣掉 剩下的等下一次update
+    bool writeToRing(UTIL::MessageBuffer& buffer)
+    {
+        ShmRing& ring = channel_->getSendRing();
+        while (buffer.getActiveSize())
+        {
+            std::size_t size = std::min(buffer.getActiveSize(), ring.getMaxMessageSize());
+            if (!ring.tryWrite(buffer.getReadPoint(), uint32_t(size)))
+                return false;
+
+            buffer.readCommit(size);
+        }
+
+        return true;
+    }
+
+    void notifyHandler(boost::system::error_code error)
+    {
+        readHandlerInternal(error);
+    }
+
+    void readHandlerInternal(boost::system::error_code error)
+    {
+        isWaiting_ = false;
+
+        if (error)
+        {
+            if (error != boost::asio::error::operation_aborted)
+                closeSocket();
+            return;
+        }
+
+        if (closed_)
+            return;
+
+        ShmRing& ring = channel_->getRecvRing();
+        recvBuf_.normalize();
+        if (ring.read(recvBuf_, SHM_READ_BATCH_SIZE))
+        {
+            readHandler();
+            return;
+        }
+
+        //对端关闭之前写入的数据在看到关闭标志之后一定可读 再读一次
+        if (ring.isClosed() || peerGone_)
+        {
+            if (ring.read(recvBuf_, SHM_READ_BATCH_SIZE))
+            {
+                readHandler();
+                return;
+            }
+
+            closeSocket();
+            return;
+        }
+
+        asyncRead();
+    }
+
+    //unix socket可读说明对端关闭或者进程退出 握手之后对端不会再往里面写数据
+    void watchPeer()
+    {
+        isWatchingPeer_ = true;
+        control_.async_wait(boost::asio::local::stream_protocol::socket::wait_read,
+            std::bind(&ShmSocket<T>::peerHandler, this->shared_from_this(), std::placeholders::_1));
+    }
+
+    void peerHandler(boost::system::error_code error)
+    {
+        if (error == boost::asio::error::operation_aborted || closed_)
+            return;
+
+        peerGone_ = true;
+
+        //如果正在eventfd上等待 取消掉 让readHandlerInternal读完剩下的数据之后关闭
+        if (isWaiting_)
+        {
+            boost::system::error_code cancelError;
+            notifier_.cancel(cancelError);
+            isWaiting_ = false;
+        }
+
+        asyncRead();
+    }
+
+private:
+    boost::asio::local::stream_protocol::socket control_;  //握手用的unix socket
+    ShmChannel::ptr channel_;
+    boost::asio::posix::stream_descriptor notifier_;       //接收方向的eventfd
+
+    std::atomic<bool> closed_;
+    std::atomic<bool> closing_;
+    bool isWaiting_;        //是否已经有一个读取在等待
+    bool isWatchingPeer_;
+    bool peerGone_;         //对端进程已经关闭了unix socket
+
+    UTIL::MessageBuffer recvBuf_;   //接收缓冲区
+    std::deque<UTIL::MessageBuffer> sendQueue_;     //环满的时候积压的消息
+    uint64_t eventValue_;
+    pid_t peerPid_;
+};
+
+
+}
@@ -0,0 +1,417 @@
+#pragma once
+
+#include <utility>
+#include <boost/asio.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "NetworkThread.h"
+#include "ShmRing.h"
+
+#define SHM_CHANNEL_MIN_CAPACITY 4096
+#define SHM_CHANNEL_FD_COUNT 3      //memfd + 两个方向的eventfd
+
+namespace NET
+{
+
+/**
+* @class ShmChannel
+* @brief 同一台机器上两个进程之间的共享内存通道 包含两个方向的ShmRing
+* @details 监听端创建memfd和eventfd 通过unix socket的SCM_RIGHTS传给连接端
+*          ring0: 监听端 -> 连接端  ring1: 连接端 -> 监听端 eventfd[i]用于唤醒ring i的消费者
+*/
+class ShmChannel
+{
+public:
+    using ptr = std::shared_ptr<ShmChannel>;
+
+public:
+    /**
+    * @brief 创建通道 监听端调用
+    * @param capacity 每个方向的环的大小 向上取整到2的幂
+    */
+    static ptr create(std::size_t capacity)
+    {
+        std::size_t ringCapacity = SHM_CHANNEL_MIN_CAPACITY;
+        while (ringCapacity < capacity)
+            ringCapacity <<= 1;
+
+        ptr channel(new ShmChannel(true));
+
+        channel->memFd_ = ::memfd_create("ShmChannel", MFD_CLOEXEC);
+        if (channel->memFd_ < 0)
+        {
+            spdlog::error("ShmChannel::create memfd_create failed, errno {}", errno);
+            return nullptr;
+        }
+
+        for (int& fd : channel->eventFds_)
+        {
+            fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (fd < 0)
+            {
+                spdlog::error("ShmChannel::create eventfd failed, errno {}", errno);
+                return nullptr;
+            }
+        }
+
+        if (::ftruncate(channel->memFd_, getMappedSize(ringCapacity)))
+        {
+            spdlog::error("ShmChannel::create ftruncate failed, errno {}", errno);
+            return nullptr;
+        }
+
+        if (!channel->map(ringCapacity, true))
+            return nullptr;
+
+        return channel;
+    }
+
+    /**
+    * @brief 从unix socket接收监听端创建的通道 连接端调用
+    * @param unixFd 阻塞模式的unix socket
+    */
+    static ptr receive(int unixFd)
+    {
+        uint64_t capacity = 0;
+        int fds[SHM_CHANNEL_FD_COUNT];
+
+        iovec iov{ &capacity, sizeof(capacity) };
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t received = ::recvmsg(unixFd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+        int recvErrno = errno;
+
+        //收到的所有fd 握手不对的时候也要关掉 否则会泄漏
+        std::vector<int> delivered;
+        if (received >= 0)
+        {
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                    continue;
+
+                std::size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    int fd;
+                    memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+                    delivered.push_back(fd);
+                }
+            }
+        }
+
+        auto closeDelivered = [&delivered]() {
+            for (int fd : delivered)
+                ::close(fd);
+        };
+
+        if (received != sizeof(capacity) || (msg.msg_flags & MSG_CTRUNC) || delivered.size() != SHM_CHANNEL_FD_COUNT)
+        {
+            spdlog::error("ShmChannel::receive invalid handshake, received {} fds {} errno {}", received, delivered.size(), recvErrno);
+            closeDelivered();
+            return nullptr;
+        }
+
+        //对端给的文件比映射的范围小的话 访问超出的部分会收到SIGBUS
+        struct stat st;
+        if (!capacity || (capacity & (capacity - 1)) || ::fstat(delivered[0], &st)
+            || capacity >= uint64_t(st.st_size) || uint64_t(st.st_size) < getMappedSize(capacity))
+        {
+            spdlog::error("ShmChannel::receive invalid channel, capacity {}", capacity);
+            closeDelivered();
+            return nullptr;
+        }
+
+        ptr channel(new ShmChannel(false));
+        channel->memFd_ = delivered[0];
+        channel->eventFds_[0] = delivered[1];
+        channel->eventFds_[1] = delivered[2];
+
+        if (!channel->map(capacity, false))
+            return nullptr;
+
+        return channel;
+    }
+
+    /**
+    * @brief 把通道发给连接端
+    * @param unixFd 阻塞模式的unix socket
+    */
+    bool send(int unixFd) const
+    {
+        uint64_t capacity = capacity_;
+        int fds[SHM_CHANNEL_FD_COUNT] = { memFd_, eventFds_[0], eventFds_[1] };
+
+        iovec iov{ &capacity, sizeof(capacity) };
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+        if (::sendmsg(unixFd, &msg, MSG_NOSIGNAL) != sizeof(capacity))
+        {
+            spdlog::error("ShmChannel::send sendmsg failed, errno {}", errno);
+            return false;
+        }
+
+        return true;
+    }
+
+    ~ShmChannel()
+    {
+        if (base_ != MAP_FAILED)
+            ::munmap(base_, getMappedSize(capacity_));
+
+        if (memFd_ >= 0)
+            ::close(memFd_);
+
+        for (int fd : eventFds_)
+        {
+            if (fd >= 0)
+                ::close(fd);
+        }
+    }
+
+    ShmRing& getSendRing() { return rings_[isListener_ ? 0 : 1]; }
+    ShmRing& getRecvRing() { return rings_[isListener_ ? 1 : 0]; }
+
+    //接收方向的eventfd 有新数据的时候可读
+    int getRecvEventFd() const { return eventFds_[isListener_ ? 1 : 0]; }
+
+    std::size_t getCapacity() const { return capacity_; }
+
+private:
+    explicit ShmChannel(bool isListener) :
+        isListener_(isListener),
+        memFd_(-1),
+        eventFds_{ -1, -1 },
+        base_(MAP_FAILED),
+        capacity_(0)
+    {}
+
+    //两个环各自按页对齐
+    static std::size_t getRingStride(std::size_t capacity)
+    {
+        std::size_t page = ::sysconf(_SC_PAGESIZE);
+        return (ShmRing::getMappedSize(capacity) + page - 1) / page * page;
+    }
+
+    static std::size_t getMappedSize(std::size_t capacity)
+    {
+        return getRingStride(capacity) * 2;
+    }
+
+    bool map(std::size_t capacity, bool init)
+    {
+        void* base = ::mmap(nullptr, getMappedSize(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, memFd_, 0);
+        if (base == MAP_FAILED)
+        {
+            spdlog::error("ShmChannel::map mmap failed, errno {}", errno);
+            return false;
+        }
+
+        base_ = base;
+        capacity_ = capacity;
+        for (int i = 0; i < 2; ++i)
+            rings_[i].attach(static_cast<uint8_t*>(base) + getRingStride(capacity) * i, capacity, init, eventFds_[i]);
+
+        return true;
+    }
+
+private:
+    bool isListener_;
+    int memFd_;         //共享内存
+    int eventFds_[2];   //两个方向的唤醒通知
+    void* base_;
+    std::size_t capacity_;  //每个环的大小
+    ShmRing rings_[2];
+};
+
+
+/**
+* @class ShmAcceptor
+* @brief 在unix socket上接受同机进程的连接 为每个连接创建ShmChannel
+* @details unix socket在握手之后保留下来 用于感知对端进程退出
+*          SocketType需要提供(local::stream_protocol::socket&&, ShmChannel::ptr)构造函数 一般继承ShmSocket
+*/
+template<class SocketType>
+class ShmAcceptor
+{
+public:
+    using ptr = std::shared_ptr<ShmAcceptor>;
+
+public:
+    /**
+    * @param ioContext 接受连接的io_context
+    * @param path unix socket的路径
+    * @param ringCapacity 每个连接每个方向的环的大小
+    */
+    ShmAcceptor(boost::asio::io_context& ioContext, std::string const& path, std::size_t ringCapacity) :
+        acceptor_(ioContext),
+        endpoint_(path),
+        socket_(ioContext),
+        ringCapacity_(ringCapacity),
+        closed_(false)
+    {}
+
+    bool bind()
+    {
+        //上一次进程退出之后留下来的socket文件
+        ::unlink(endpoint_.path().c_str());
+
+        boost::system::error_code errorCode;
+        if (acceptor_.open(endpoint_.protocol(), errorCode))
+        {
+            spdlog::error("ShmAcceptor::bind Failed to open acceptor {}", errorCode.message());
+            return false;
+        }
+
+        if (acceptor_.bind(endpoint_, errorCode))
+        {
+            spdlog::error("ShmAcceptor::bind Could not bind to {} {}", endpoint_.path(), errorCode.message());
+            return false;
+        }
+
+        if (acceptor_.listen(boost::asio::socket_base::max_listen_connections, errorCode))
+        {
+            spdlog::error("ShmAcceptor::bind Failed to start listening on {} {}", endpoint_.path(), errorCode.message());
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+    * @brief 开始接受连接 新连接交给连接数最少的网络线程
+    * @param threads 网络线程数组
+    * @param threadCount 网络线程的个数
+    */
+    void asyncAccept(NetworkThread<SocketType>* threads, uint32_t threadCount)
+    {
+        acceptor_.async_accept(socket_, [this, threads, threadCount](boost::system::error_code error){
+            if (!error)
+                onAccept(threads, threadCount);
+
+            if (!closed_)
+                this->asyncAccept(threads, threadCount);
+        });
+    }
+
+    void close()
+    {
+        if (closed_.exchange(true))
+            return;
+
+        boost::system::error_code errorCode;
+        acceptor_.close(errorCode);
+        ::unlink(endpoint_.path().c_str());
+    }
+
+private:
+    void onAccept(NetworkThread<SocketType>* threads, uint32_t threadCount)
+    {
+        boost::asio::local::stream_protocol::socket sock(std::move(socket_));
+
+        ShmChannel::ptr channel = ShmChannel::create(ringCapacity_);
+        if (!channel || !channel->send(sock.native_handle()))
+            return;
+
+        uint32_t threadIndex = 0;
+        for (uint32_t i = 1; i < threadCount; ++i)
+        {
+            if (threads[i].getConnsCount() < threads[threadIndex].getConnsCount())
+                threadIndex = i;
+        }
+
+        try
+        {
+            //把socket挪到目标网络线程的io_context上
+            boost::asio::local::stream_protocol::socket threadSock(threads[threadIndex].getIoContext());
+            threadSock.assign(boost::asio::local::stream_protocol(), sock.release());
+            threadSock.non_blocking(true);
+
+            std::shared_ptr<SocketType> sockPtr = std::make_shared<SocketType>(std::move(threadSock), channel);
+            sockPtr->start();
+            threads[threadIndex].addNewSocket(sockPtr);
+        }
+        catch (boost::system::system_error const& err)
+        {
+            spdlog::error("ShmAcceptor::onAccept Failed to initialize socket {}", err.what());
+        }
+    }
+
+private:
+    boost::asio::local::stream_protocol::acceptor acceptor_;
+    boost::asio::local::stream_protocol::endpoint endpoint_;
+    boost::asio::local::stream_protocol::socket socket_;
+    std::size_t ringCapacity_;
+    std::atomic<bool> closed_;
+};
+
+
+/**
+* @class ShmConnector
+* @brief 连接同机进程的ShmAcceptor
+*/
+template<class SocketType>
+class ShmConnector
+{
+public:
+    /**
+    * @brief 同步连接 握手只有一次本地的sendmsg/recvmsg
+    * @param thread 新的连接交给哪个网络线程
+    * @param path 对端ShmAcceptor的路径
+    * @return 失败的时候返回nullptr
+    */
+    static std::shared_ptr<SocketType> connect(NetworkThread<SocketType>& thread, std::string const& path)
+    {
+        try
+        {
+            boost::asio::local::stream_protocol::socket sock(thread.getIoContext());
+            sock.connect(boost::asio::local::stream_protocol::endpoint(path));
+
+            ShmChannel::ptr channel = ShmChannel::receive(sock.native_handle());
+            if (!channel)
+                return nullptr;
+
+            sock.non_blocking(true);
+            std::shared_ptr<SocketType> sockPtr = std::make_shared<SocketType>(std::move(sock), channel);
+            sockPtr->start();
+            thread.addNewSocket(sockPtr);
+            return sockPtr;
+        }
+        catch (boost::system::system_error const& err)
+        {
+            spdlog::error("ShmConnector::connect Failed to connect to {} {}", path, err.what());
+            return nullptr;
+        }
+    }
+};
+
+
+}
@@ -1,24 +1,58 @@
 #pragma once
 
+#include <utility>
 #include <boost/asio.hpp>
 #include <boost/asio/buffer.hpp>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <spdlog/spdlog.h>
-#include <queue>
+#include <vector>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
 #include "../Utilities/MessageBuffer.h"
+#include "../Utilities/TokenBucket.h"
+#include "ReadRateLimit.h"
+#include "SocketOptions.h"
+#include "UringService.h"
 
 namespace NET 
 {
 
 #define READ_BLOCK_SIZE 4096
+#define URING_RECV_HIGH_WATER (256 * 1024)     //io_uring模式下接收缓冲区积压超过该值就暂停接收
+#define SEND_BATCH_MAX_BUFFERS 64       //一次批量写最多合并多少个消息
+#define BULK_CHUNK_SIZE (16 * 1024)     //每次批量写里面bulk lane最多占多少字节
+#define ZEROCOPY_CLOSE_TIMEOUT_MS 5000  //关闭之后最多等多久内核释放零拷贝缓冲区 超时之后复位连接
+
+/**
+* @enum SendLane
+* @brief 发送队列的优先级 数值越小越先发送
+*/
+enum SendLane : uint8_t
+{
+    SEND_LANE_CONTROL,      //控制消息
+    SEND_LANE_REALTIME,     //战斗/移动等实时消息
+    SEND_LANE_NORMAL,       //普通消息 queuePacket的默认值
+    SEND_LANE_BULK,         //快照等大块数据 每次写只发送一块
+    SEND_LANE_COUNT
+};
+
+template<class A, class B>
+class SpliceRelay;
 
 template <typename T>
 class Socket : public std::enable_shared_from_this<T>
 {
 public:
     using ptr = std::shared_ptr<Socket>;
+    template<class A, class B> friend class SpliceRelay;
 public:
     Socket(boost::asio::ip::tcp::socket && s) :
         socket_(std::move(s)),
@@ -27,12 +61,33 @@ public:
         closed_(false),
         closing_(false),
         isWritingAsync_(false),
-        recvBuf_(READ_BLOCK_SIZE)
+        recvBuf_(READ_BLOCK_SIZE),
+        readDelayTimer_(socket_.get_executor()),
+        zeroCopyThreshold_(0),
+        zeroCopyNextSeq_(0),
+        partialLane_(-1),
+        bulkChunkSize_(BULK_CHUNK_SIZE),
+        relaying_(false),
+        quickAck_(false),
+        uring_(nullptr),
+        uringRecvToken_(0),
+        uringRecvActive_(false),
+        uringReadArmed_(false),
+        uringUnread_(0),
+        uringMsg_{}
     {}
 
     ~Socket()
     {
         closed_ = true;
+
+        //内核还在从零拷贝的缓冲区发送数据 复位连接让内核丢掉发送队列 否则缓冲区释放之后对端可能收到被覆盖的数据
+        if (!zeroCopyPending_.empty())
+        {
+            linger abort{1, 0};
+            ::setsockopt(socket_.native_handle(), SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+        }
+
         socket_.close();
     }
 
@@ -42,11 +97,23 @@ public:
     //网络线程不断调用update去发送数据
     virtual bool update()
     {
+        //关闭之后网络线程继续持有连接 直到内核释放所有零拷贝缓冲区
         if (closed_) 
-            return false;
+            return holdZeroCopyBuffers();
+
+        //回收内核已经发送完成的零拷贝缓冲区 delayCloseSocket之后等它们全部释放才关闭
+        if (!zeroCopyPending_.empty())
+        {
+            drainZeroCopyCompletions();
+            closeIfFlushed();
+        }
+
+        //转发模式下由SpliceRelay负责写
+        if (relaying_)
+            return true;
 
         //isWritingAsync_当前发送缓冲区已经满了
-        if (isWritingAsync_ || (sendQueue_.empty() && !closing_)) 
+        if (isWritingAsync_ || (isSendQueueEmpty() && !closing_)) 
         {
             return true;
         }
@@ -76,11 +143,29 @@ public:
     //异步读取数据
     void asyncRead()
     {
-        if (!IsOpen()) 
+        //转发模式下读写都交给了SpliceRelay
+        if (!IsOpen() || relaying_) 
         {
             return;
         }
 
+        //超过了限速 推迟下一次读取 数据留在内核缓冲区里面 由tcp的流控去反压对端
+        UTIL::TokenBucket::clock::duration delay = getReadDelay();
+        if (delay > UTIL::TokenBucket::clock::duration::zero())
+        {
+            readDelayTimer_.expires_after(delay);
+            readDelayTimer_.async_wait(std::bind(&Socket::readDelayHandler,
+                this->shared_from_this(),
+                std::placeholders::_1));
+            return;
+        }
+
+        if (uring_)
+        {
+            uringAsyncRead();
+            return;
+        }
+
         recvBuf_.normalize();
 
         socket_.async_read_some(
@@ -92,12 +177,42 @@ public:
         );
     }
 
-    void queuePacket(UTIL::MessageBuffer && packet)
+    /**
+    * @brief 把消息放到对应优先级的发送队列 由网络线程的update发送
+    * @details 发送队列没有加锁 只能在socket所在的网络线程调用 其他线程用postPacket
+    * @param packet 消息
+    * @param lane 优先级 高优先级的队列总是先于低优先级的发送
+    */
+    void queuePacket(UTIL::MessageBuffer && packet, SendLane lane = SEND_LANE_NORMAL)
     {
-        sendQueue_.push(std::move(packet));
-        //asyncProcessSendQueue();
+        if (lane == SEND_LANE_BULK && packet.getActiveSize() > bulkChunkSize_)
+        {
+            std::vector<UTIL::MessageBuffer> chunks;
+            splitBulkPacket(std::move(packet), chunks);
+            for (UTIL::MessageBuffer& chunk : chunks)
+                sendLanes_[SEND_LANE_BULK].push_back(QueuedPacket{std::move(chunk), false});
+            return;
+        }
+
+        sendLanes_[lane].push_back(QueuedPacket{std::move(packet), false});
     }
 
+    /**
+    * @brief 线程安全的queuePacket 投递到socket所在的网络线程再放进发送队列
+    * @details 从ConnectionPool::acquire这样的其他线程拿到socket之后用这个发送 同一个线程post的消息保持顺序
+    */
+    void postPacket(UTIL::MessageBuffer && packet, SendLane lane = SEND_LANE_NORMAL)
+    {
+        boost::asio::post(socket_.get_executor(), [self = this->shared_from_this(), packet = std::move(packet), lane]() mutable {
+            self->queuePacket(std::move(packet), lane);
+        });
+    }
+
+    std::size_t getSendQueueSize(SendLane lane) const { return sendLanes_[lane].size(); }
+
+    //设置bulk lane每次批量写最多发送的字节数
+    void setBulkChunkSize(std::size_t bytes) { bulkChunkSize_ = std::max<std::size_t>(bytes, 1); }
+
 
     void closeSocket()
     {
@@ -111,10 +226,22 @@ public:
             spdlog::info("network", "Socket::CloseSocket: {} errored when shutting down socket: {} ({})", getRemoteAddress().to_string(),
                 shutdownError.value(), shutdownError.message());
 
+        boost::system::error_code cancelError;
+        readDelayTimer_.cancel(cancelError);
+
+        //io_uring的请求只能在网络线程取消
+        if (uring_)
+        {
+            boost::asio::post(socket_.get_executor(), [self = this->shared_from_this()](){
+                if (self->uringRecvActive_)
+                    self->uring_->cancel(self->uringRecvToken_);
+            });
+        }
+
         onClose();
     }
 
-    //当发送缓冲区里面没有数据的时候 将socket关闭
+    //当发送缓冲区里面没有数据 并且内核释放了所有零拷贝缓冲区的时候 将socket关闭
     void delayCloseSocket()
     {
         if (closing_.exchange(true)) 
@@ -122,18 +249,103 @@ public:
             return;
         }
 
-        if (sendQueue_.empty()) 
-        {
-            closeSocket();
-        }
+        closeIfFlushed();
     }
     
 
     UTIL::MessageBuffer& GetReadBuffer() { return recvBuf_; }
+
+    /**
+    * @brief 开启TCP_QUICKACK
+    * @details 内核在延迟确认之后会自动关闭quickack 所以每次读取之后重新设置一次
+    */
+    void setQuickAck(bool enable)
+    {
+        quickAck_ = enable;
+        SocketOptionsUtil::setOption(socket_.native_handle(), IPPROTO_TCP, TCP_QUICKACK, enable, "TCP_QUICKACK");
+    }
+
+    /**
+    * @brief 改为通过网络线程的io_uring收发 必须在start之前调用
+    * @details 由SocketMgr/AsyncConnector按照网络线程的后端设置 nullptr表示使用asio
+    */
+    void setUringService(UringService* service)
+    {
+        uring_ = service;
+    }
+
+    bool isUsingUring() const { return uring_ != nullptr; }
+
+    //从内核读出该连接当前的参数 用来确认SocketMgr设置的参数是否生效
+    SocketOptions getSocketOptions()
+    {
+        return SocketOptionsUtil::read(socket_.native_handle());
+    }
+
+    /**
+    * @brief 开启MSG_ZEROCOPY发送
+    * @param threshold 大于等于该字节数的消息走零拷贝发送 小消息仍然走普通的write_some
+    * @return 内核是否支持SO_ZEROCOPY
+    * @details 零拷贝发送的缓冲区会一直保留到内核通过错误队列通知释放为止
+    *          关闭之后网络线程继续持有连接回收缓冲区 超过ZEROCOPY_CLOSE_TIMEOUT_MS就复位连接丢掉没发完的数据
+    */
+    bool enableZeroCopy(std::size_t threshold)
+    {
+        int one = 1;
+        if (::setsockopt(socket_.native_handle(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)))
+        {
+            spdlog::error("Socket::enableZeroCopy setsockopt(SO_ZEROCOPY) failed for {} - {}",
+                getRemoteAddress().to_string(), strerror(errno));
+            return false;
+        }
+
+        zeroCopyThreshold_ = threshold;
+        return true;
+    }
+
+    bool isZeroCopyEnabled() const { return zeroCopyThreshold_ != 0; }
+
+    /**
+    * @brief 设置该连接的入站限速
+    * @param limit 字节/包的速率和桶容量
+    */
+    void setReadRateLimit(ReadRateLimit const& limit)
+    {
+        readBytesBucket_.reset(limit.bytesPerSecond, limit.bytesBurst);
+        readPacketsBucket_.reset(limit.packetsPerSecond, limit.packetsBurst);
+    }
+
+    //设置与其他连接共享的限速器(比如同一个IP的所有连接)
+    void setAggregateReadLimiter(ReadRateLimiter::ptr limiter)
+    {
+        aggregateReadLimiter_ = std::move(limiter);
+    }
+
+    //等待内核释放的零拷贝缓冲区数量
+    std::size_t getZeroCopyPendingCount() const { return zeroCopyPending_.size(); }
 protected:
     virtual void onClose() { }
     virtual void readHandler() = 0;
 
+    /**
+    * @brief 把一个大的bulk消息切成多个独立的消息 切开的块之间可以插入更高优先级的消息
+    * @details 字节流上一个消息一旦开始发送就必须发完 所以只有协议本身支持分片的子类才能切
+    *          (比如每块带自己的分片头 由接收方重新拼起来) 这样的子类重写这个函数
+    *          默认不切 整个消息作为一块 只是每次批量写最多带bulkChunkSize_字节 其他队列在消息的边界才能插进来
+    */
+    virtual void splitBulkPacket(UTIL::MessageBuffer&& packet, std::vector<UTIL::MessageBuffer>& chunks)
+    {
+        chunks.push_back(std::move(packet));
+    }
+
+    //子类在readHandler里面解析出完整的包之后调用 用于包速率的限制
+    void consumeInboundPackets(uint32_t count)
+    {
+        readPacketsBucket_.consume(count);
+        if (aggregateReadLimiter_)
+            aggregateReadLimiter_->consumePackets(count);
+    }
+
     //异步处理发送队列
     bool asyncProcessSendQueue()
     {
@@ -162,6 +374,14 @@ protected:
 private:
     void readHandlerInternal(boost::system::error_code error, size_t transferredBytes)
     {
+        //进入转发模式的时候取消了还没完成的读 已经读到的数据留给SpliceRelay
+        if (relaying_)
+        {
+            if (!error)
+                recvBuf_.writeCommit(transferredBytes);
+            return;
+        }
+
         if (error)
         {
             closeSocket();
@@ -169,33 +389,208 @@ private:
         }
 
         recvBuf_.writeCommit(transferredBytes);
+        if (quickAck_)
+            SocketOptionsUtil::setOption(socket_.native_handle(), IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+
+        readBytesBucket_.consume(double(transferredBytes));
+        if (aggregateReadLimiter_)
+            aggregateReadLimiter_->consumeBytes(transferredBytes);
+
         readHandler();
     }
 
+    void readDelayHandler(boost::system::error_code error)
+    {
+        if (error)
+            return;
+
+        asyncRead();
+    }
+
+    //距离下一次可以读取还需要多久 取所有限速器里面最长的
+    UTIL::TokenBucket::clock::duration getReadDelay()
+    {
+        UTIL::TokenBucket::clock::duration delay = std::max(readBytesBucket_.getDelay(), readPacketsBucket_.getDelay());
+        if (aggregateReadLimiter_)
+            delay = std::max(delay, aggregateReadLimiter_->getDelay());
+
+        return delay;
+    }
+
     void writeHandlerWrapper(boost::system::error_code /*error*/, std::size_t /*transferedBytes*/)
     {
         isWritingAsync_ = false;
+        if (relaying_)
+            return;
+
         handleQueue();
     }
 
 
+    //正在关闭 发送队列已经发完 内核也不再引用零拷贝缓冲区的时候真正关闭
+    void closeIfFlushed()
+    {
+        if (closing_ && isSendQueueEmpty() && zeroCopyPending_.empty())
+            closeSocket();
+    }
+
+    /**
+    * @brief 关闭之后继续回收零拷贝缓冲区
+    * @return 是否还要继续持有连接 超时之后返回false 由析构函数复位连接
+    */
+    bool holdZeroCopyBuffers()
+    {
+        if (zeroCopyPending_.empty())
+            return false;
+
+        drainZeroCopyCompletions();
+        if (zeroCopyPending_.empty())
+            return false;
+
+        auto now = std::chrono::steady_clock::now();
+        if (zeroCopyCloseDeadline_ == std::chrono::steady_clock::time_point())
+            zeroCopyCloseDeadline_ = now + std::chrono::milliseconds(ZEROCOPY_CLOSE_TIMEOUT_MS);
+
+        return now < zeroCopyCloseDeadline_;
+    }
+
+    bool isSendQueueEmpty() const
+    {
+        for (auto const& lane : sendLanes_)
+        {
+            if (!lane.empty())
+                return false;
+        }
+
+        return true;
+    }
+
+    /**
+    * @brief 按优先级把各个队列的消息合并成一次批量写
+    * @details 只发送了一部分的消息必须排在最前面 否则字节流就乱了
+    *          bulk lane总共最多带bulkChunkSize_字节 被截断的消息后面不能再跟任何消息
+    */
+    void gatherSendBatch()
+    {
+        batchBuffers_.clear();
+        batchLanes_.clear();
+
+        std::size_t bulkBytes = 0;
+        bool truncated = false;
+
+        auto add = [&](QueuedPacket& packet, int8_t lane) -> bool {
+            if (truncated || batchBuffers_.size() >= SEND_BATCH_MAX_BUFFERS)
+                return false;
+
+            std::size_t size = packet.buffer_.getActiveSize();
+            if (lane == SEND_LANE_BULK)
+            {
+                if (bulkBytes >= bulkChunkSize_)
+                    return false;
+
+                if (size > bulkChunkSize_ - bulkBytes)
+                {
+                    size = bulkChunkSize_ - bulkBytes;
+                    truncated = true;
+                }
+                bulkBytes += size;
+            }
+
+            batchBuffers_.emplace_back(packet.buffer_.getReadPoint(), size);
+            batchLanes_.push_back(lane);
+            return true;
+        };
+
+        if (partialLane_ >= 0)
+            add(sendLanes_[partialLane_].front(), partialLane_);
+
+        for (int8_t lane = 0; lane < SEND_LANE_COUNT; ++lane)
+        {
+            auto& queue = sendLanes_[lane];
+            for (std::size_t i = (lane == partialLane_) ? 1 : 0; i < queue.size(); ++i)
+            {
+                if (!add(queue[i], lane))
+                    break;
+            }
+        }
+    }
+
+    //把已经写出去的字节从各个队列里面扣掉
+    void consumeSendBatch(std::size_t bytesSent, bool zeroCopied)
+    {
+        for (std::size_t i = 0; i < batchBuffers_.size(); ++i)
+        {
+            int8_t lane = batchLanes_[i];
+            QueuedPacket& packet = sendLanes_[lane].front();
+            std::size_t size = batchBuffers_[i].size();
+
+            //空消息不占字节 不先弹出的话会一直卡在队首
+            if (!packet.buffer_.getActiveSize())
+            {
+                popSendLane(lane);
+                continue;
+            }
+
+            std::size_t consumed = std::min(size, bytesSent);
+            if (!consumed)
+                return;
+
+            packet.zeroCopied_ |= zeroCopied;
+            bytesSent -= consumed;
+
+            if (consumed == packet.buffer_.getActiveSize())
+            {
+                popSendLane(lane);
+                if (partialLane_ == lane)
+                    partialLane_ = -1;
+                continue;
+            }
+
+            //只发送了一部分 下一次必须接着发送这个消息
+            packet.buffer_.readCommit(consumed);
+            partialLane_ = lane;
+            return;
+        }
+    }
+
     bool handleQueue()
     {
-        if (sendQueue_.empty())
+        if (isSendQueueEmpty())
             return false;
-        
-        UTIL::MessageBuffer& queuedMessage = sendQueue_.front();
-        std::size_t bytesToSend = queuedMessage.getActiveSize();
+
+        gatherSendBatch();
+
+        //io_uring模式下只准备请求 和本轮所有连接的发送一起提交
+        if (uring_)
+        {
+            uringSendBatch();
+            return false;
+        }
+
+        std::size_t bytesToSend = 0;
+        std::size_t largestBuffer = 0;
+        for (boost::asio::const_buffer const& buffer : batchBuffers_)
+        {
+            bytesToSend += buffer.size();
+            largestBuffer = std::max(largestBuffer, buffer.size());
+        }
 
         boost::system::error_code error;
-        std::size_t bytesSent = socket_.write_some(
-            boost::asio::buffer(
-                queuedMessage.getReadPoint(),
-                bytesToSend),
-                error);
+        std::size_t bytesSent = 0;
+        bool zeroCopied = false;
+
+        //带有大消息的批次走零拷贝 只有小消息的批次仍然拷贝到内核 开始关闭之后不再零拷贝 免得推迟关闭
+        if (zeroCopyThreshold_ && !closing_ && largestBuffer >= zeroCopyThreshold_)
+        {
+            bytesSent = sendZeroCopy(error, zeroCopied);
+        }
+        else
+        {
+            bytesSent = socket_.write_some(batchBuffers_, error);
+        }
         
 
-        spdlog::info("Socket::handleQueue content={} bytesToSend={}", queuedMessage.getReadPoint(), bytesToSend);
+        spdlog::info("Socket::handleQueue buffers={} bytesToSend={}", batchBuffers_.size(), bytesToSend);
         if (error)
         {
             //当前发送缓冲区已经满了 等待异步发送
@@ -206,29 +601,263 @@ private:
                 return asyncProcessSendQueue();
             }
 
-
+            //其他错误 丢掉这一批消息 连接会在读的时候发现错误并关闭
+            bytesSent = bytesToSend;
         }
         else if (0 == bytesSent) 
         {
             spdlog::info("Socket::handleQueue bytesSent=0");
-            sendQueue_.pop();
-            if (closing_ && sendQueue_.empty())
-                closeSocket();
+            consumeSendBatch(bytesToSend, false);
+            closeIfFlushed();
             return false;
         }
-        else if(bytesSent < bytesToSend)
+
+        consumeSendBatch(bytesSent, zeroCopied);
+
+        if (bytesSent < bytesToSend)
         {
             spdlog::info("Socket::handleQueue bytesSent < bytesToSend");
-            queuedMessage.readCommit(bytesSent);
             return asyncProcessSendQueue();
         }
 
         spdlog::info("Socket::handleQueue bytesSent == bytesToSend");
-        sendQueue_.pop();
-        if (closing_ && sendQueue_.empty())
+        closeIfFlushed();
+
+        return !isSendQueueEmpty();
+    }
+
+    //io_uring模式下的asyncRead start可能在accept线程调用 所以转到网络线程执行
+    void uringAsyncRead()
+    {
+        boost::asio::dispatch(socket_.get_executor(), std::bind(&Socket::uringArmRead, this->shared_from_this()));
+    }
+
+    //上层准备好读取了 有积压的数据就投递给readHandler 没有在接收就开始多次接收
+    void uringArmRead()
+    {
+        if (!IsOpen())
+            return;
+
+        uringReadArmed_ = true;
+        if (uringUnread_)
+            boost::asio::post(socket_.get_executor(), std::bind(&Socket::uringDeliver, this->shared_from_this()));
+
+        if (!uringRecvActive_)
+        {
+            uringRecvActive_ = true;
+            uringRecvToken_ = uring_->recvMultishot(socket_.native_handle(),
+                std::bind(&Socket::uringRecvHandler, this->shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+        }
+    }
+
+    void uringDeliver()
+    {
+        if (closed_ || !uringReadArmed_ || !uringUnread_)
+            return;
+
+        uringReadArmed_ = false;
+        uringUnread_ = 0;
+        readHandler();
+    }
+
+    /**
+    * @brief 多次接收的完成回调
+    * @details 上层还没有调用asyncRead的时候数据先积压在接收缓冲区里 积压太多或者超过限速就取消接收 由下一次asyncRead重新开始
+    */
+    void uringRecvHandler(int result, uint32_t flags)
+    {
+        bool more = flags & IORING_CQE_F_MORE;
+        if (!more)
+            uringRecvActive_ = false;
+
+        if (result > 0)
+        {
+            uint16_t bufferId = uint16_t(flags >> IORING_CQE_BUFFER_SHIFT);
+            recvBuf_.normalize();
+            if (recvBuf_.getRemainingSpace() < std::size_t(result))
+                recvBuf_.resize(recvBuf_.getBufferSize() + result);
+            recvBuf_.write(uring_->getBuffer(bufferId), result);
+            uring_->recycleBuffer(bufferId);
+
+            if (closed_)
+                return;
+
+            if (quickAck_)
+                SocketOptionsUtil::setOption(socket_.native_handle(), IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+
+            readBytesBucket_.consume(double(result));
+            if (aggregateReadLimiter_)
+                aggregateReadLimiter_->consumeBytes(result);
+
+            uringUnread_ += result;
+            if (more && (recvBuf_.getActiveSize() >= URING_RECV_HIGH_WATER ||
+                getReadDelay() > UTIL::TokenBucket::clock::duration::zero()))
+            {
+                uring_->cancel(uringRecvToken_);
+            }
+
+            uringDeliver();
+            return;
+        }
+
+        //对端关闭
+        if (result == 0)
+        {
             closeSocket();
+            return;
+        }
+
+        //缓冲池暂时用完了或者被取消 上层在等数据的话重新开始(会先检查限速)
+        if (result == -ENOBUFS || result == -ECANCELED)
+        {
+            if (!more && uringReadArmed_ && !closed_)
+            {
+                uringReadArmed_ = false;
+                asyncRead();
+            }
+            return;
+        }
 
-        return !sendQueue_.empty();
+        closeSocket();
+    }
+
+    void uringSendBatch()
+    {
+        std::size_t bytesToSend = 0;
+        for (std::size_t i = 0; i < batchBuffers_.size(); ++i)
+        {
+            uringIov_[i].iov_base = const_cast<void*>(batchBuffers_[i].data());
+            uringIov_[i].iov_len = batchBuffers_[i].size();
+            bytesToSend += batchBuffers_[i].size();
+        }
+
+        uringMsg_ = msghdr{};
+        uringMsg_.msg_iov = uringIov_.data();
+        uringMsg_.msg_iovlen = batchBuffers_.size();
+
+        //完成之前不会再调用handleQueue 所以这一批的buffer保持不变
+        isWritingAsync_ = true;
+        uring_->sendMsg(socket_.native_handle(), &uringMsg_,
+            std::bind(&Socket::uringSendHandler, this->shared_from_this(), std::placeholders::_1, bytesToSend));
+    }
+
+    void uringSendHandler(int result, std::size_t bytesToSend)
+    {
+        isWritingAsync_ = false;
+
+        if (result == -EAGAIN || result == -EINTR)
+            return;
+
+        //其他错误和asio路径一样 丢掉这一批消息 连接会在读的时候发现错误并关闭
+        consumeSendBatch(result < 0 ? bytesToSend : std::size_t(result), false);
+
+        closeIfFlushed();
+    }
+
+    //把发送队列里面还没发送的数据按照写入字节流的顺序全部取出来
+    void takeSendQueue(UTIL::MessageBuffer& out)
+    {
+        auto take = [&out](QueuedPacket& packet){
+            if (out.getRemainingSpace() < packet.buffer_.getActiveSize())
+                out.resize(out.getBufferSize() + packet.buffer_.getActiveSize());
+            out.write(packet.buffer_.getReadPoint(), packet.buffer_.getActiveSize());
+        };
+
+        if (partialLane_ >= 0)
+        {
+            take(sendLanes_[partialLane_].front());
+            popSendLane(partialLane_);
+            partialLane_ = -1;
+        }
+
+        for (int8_t lane = 0; lane < SEND_LANE_COUNT; ++lane)
+        {
+            while (!sendLanes_[lane].empty())
+            {
+                take(sendLanes_[lane].front());
+                popSendLane(lane);
+            }
+        }
+    }
+
+    //弹出队首消息 如果消息的数据还被内核引用(零拷贝) 则转移到等待释放的队列里
+    void popSendLane(int8_t lane)
+    {
+        QueuedPacket& packet = sendLanes_[lane].front();
+        if (packet.zeroCopied_)
+            zeroCopyPending_.emplace_back(zeroCopyNextSeq_ - 1, std::move(packet.buffer_));
+
+        sendLanes_[lane].pop_front();
+    }
+
+    /**
+    * @brief 使用MSG_ZEROCOPY发送当前批次
+    * @details 每一次成功的sendmsg调用 内核都会分配一个递增的序号 完成通知里面携带的是序号区间
+    */
+    std::size_t sendZeroCopy(boost::system::error_code& error, bool& zeroCopied)
+    {
+        std::array<iovec, SEND_BATCH_MAX_BUFFERS> iov;
+        for (std::size_t i = 0; i < batchBuffers_.size(); ++i)
+        {
+            iov[i].iov_base = const_cast<void*>(batchBuffers_[i].data());
+            iov[i].iov_len = batchBuffers_[i].size();
+        }
+
+        msghdr msg{};
+        msg.msg_iov = iov.data();
+        msg.msg_iovlen = batchBuffers_.size();
+
+        ssize_t sent = ::sendmsg(socket_.native_handle(), &msg, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            //超过了optmem的限制 这一次退回到普通的拷贝发送
+            if (ENOBUFS == errno)
+                return socket_.write_some(batchBuffers_, error);
+
+            error.assign(errno, boost::asio::error::get_system_category());
+            return 0;
+        }
+
+        ++zeroCopyNextSeq_;
+        zeroCopied = true;
+        return static_cast<std::size_t>(sent);
+    }
+
+    //从socket的错误队列里面读取零拷贝完成通知 释放内核不再引用的缓冲区
+    void drainZeroCopyCompletions()
+    {
+        while (!zeroCopyPending_.empty())
+        {
+            char control[128];
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            if (::recvmsg(socket_.native_handle(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+                return;
+
+            for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+            {
+                if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+                    continue;
+
+                sock_extended_err const* serr = reinterpret_cast<sock_extended_err const*>(CMSG_DATA(cm));
+                if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                    continue;
+
+                //内核最终还是做了拷贝(比如回环网卡) 零拷贝已经没有收益了 后续的消息走普通路径
+                if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                    zeroCopyThreshold_ = 0;
+
+                //ee_data是本次通知覆盖的最大序号 序号会回绕 所以用差值比较
+                while (!zeroCopyPending_.empty() &&
+                    static_cast<int32_t>(zeroCopyPending_.front().first - serr->ee_data) <= 0)
+                {
+                    zeroCopyPending_.pop_front();
+                }
+            }
+        }
     }
 
 private:
@@ -239,8 +868,40 @@ private:
     std::atomic<bool> closing_;
     bool isWritingAsync_;   //当前是否在异步的写数据
 
+    struct QueuedPacket
+    {
+        UTIL::MessageBuffer buffer_;
+        bool zeroCopied_;   //是否有数据通过零拷贝交给了内核
+    };
+
     UTIL::MessageBuffer recvBuf_;    //接收缓冲区
-    std::queue<UTIL::MessageBuffer> sendQueue_;   //发送缓冲区
+    std::array<std::deque<QueuedPacket>, SEND_LANE_COUNT> sendLanes_;   //按优先级划分的发送队列
+
+    UTIL::TokenBucket readBytesBucket_;     //入站字节限速
+    UTIL::TokenBucket readPacketsBucket_;   //入站包限速
+    ReadRateLimiter::ptr aggregateReadLimiter_;    //多个连接共享的限速器
+    boost::asio::steady_timer readDelayTimer_;     //超过限速之后 延迟读取的定时器
+
+    std::size_t zeroCopyThreshold_;    //走零拷贝发送的最小消息大小 0表示关闭
+    uint32_t zeroCopyNextSeq_;         //下一次零拷贝发送的序号
+    std::deque<std::pair<uint32_t, UTIL::MessageBuffer>> zeroCopyPending_;    //等待内核释放的缓冲区<最后一次发送的序号, 缓冲区>
+    std::chrono::steady_clock::time_point zeroCopyCloseDeadline_;   //关闭之后最晚等到什么时候
+
+    int8_t partialLane_;    //队首消息只发送了一部分的队列 -1表示没有
+    std::size_t bulkChunkSize_;     //每次批量写里面bulk lane最多占多少字节
+    std::vector<boost::asio::const_buffer> batchBuffers_;   //当前批次 按写入字节流的顺序
+    std::vector<int8_t> batchLanes_;    //当前批次每个buffer所属的队列
+
+    bool relaying_;     //是否已经交给SpliceRelay转发
+    bool quickAck_;     //每次读取之后重新开启TCP_QUICKACK
+
+    UringService* uring_;       //网络线程的io_uring nullptr表示使用asio
+    uint64_t uringRecvToken_;   //多次接收请求的编号
+    bool uringRecvActive_;      //多次接收是否还在进行
+    bool uringReadArmed_;       //上层已经调用了asyncRead 等待数据
+    std::size_t uringUnread_;   //上一次readHandler之后收到的字节数
+    std::array<iovec, SEND_BATCH_MAX_BUFFERS> uringIov_;    //正在发送的批次
+    msghdr uringMsg_;
 };
 
 
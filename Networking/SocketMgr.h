@@ -4,10 +4,17 @@
 #include <boost/asio/io_context.hpp>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <map>
 #include <boost/asio/ip/tcp.hpp>
 #include <spdlog/spdlog.h>
 #include "AsyncAcceptor.h"
+#include "IpFilter.h"
 #include "NetworkThread.h"
+#include "ReadRateLimit.h"
+#include "SocketOptions.h"
+
+#define IP_READ_LIMITER_SWEEP_BUDGET 4      //每接受一个连接最多检查几个IP的限速器是否已经释放
 
 namespace NET 
 {
@@ -39,7 +46,7 @@ public:
             return false;
         }
 
-        if (!acceptor->bind()) 
+        if (!acceptor->bind(socketOptions_)) 
         {
             spdlog::error("network StartNetwork failed to bind socket acceptor");
             delete acceptor;
@@ -47,15 +54,16 @@ public:
         }
 
         pAcceptor_ = acceptor;
-        threadCount_ = threadCount;
-        pNetworkThreads_ = createThreads();
-
-
-        for (int i = 0; i < threadCount_; ++i) 
+        if (ipFilter_)
         {
-            pNetworkThreads_[i].start();
+            IpFilter::ptr filter = ipFilter_;
+            pAcceptor_->setAcceptFilter([filter](boost::asio::ip::address const& address){
+                return filter->isAllowed(address);
+            });
         }
 
+        startThreads(threadCount);
+
         pAcceptor_->setSockFactory([this](){
             return GetSocketForAccept();
         });
@@ -63,9 +71,26 @@ public:
         return true;
     }
 
+    /**
+    * @brief 只启动网络线程 不监听端口
+    * @details 只主动向外连接(AsyncConnector/ConnectionPool)的管理器直接调用这个
+    */
+    void startThreads(uint32_t threadCount)
+    {
+        threadCount_ = threadCount;
+        pNetworkThreads_ = createThreads();
+
+        for (int i = 0; i < threadCount_; ++i) 
+        {
+            pNetworkThreads_[i].setBackend(backend_);
+            pNetworkThreads_[i].start();
+        }
+    }
+
     virtual void stopNetwork()
     {
-        pAcceptor_->close();
+        if (pAcceptor_)
+            pAcceptor_->close();
         if (threadCount_ != 0) 
         {
             for (int i = 0; i < threadCount_; ++i) 
@@ -100,7 +125,24 @@ public:
     {
         try 
         {
+            SocketOptionsUtil::apply(sock.native_handle(), socketOptions_);
+
+            //第一个连接检查一下内核实际的值 被系统上限截断的时候打印出来
+            if (!socketOptionsVerified_.exchange(true))
+                SocketOptionsUtil::verify(sock.native_handle(), socketOptions_);
+
             std::shared_ptr<SocketType> sockPtr = std::make_shared<SocketType>(std::move(sock));
+
+            if (socketOptions_.quickAck > 0)
+                sockPtr->setQuickAck(true);
+
+            if (readRateLimit_.isEnabled())
+                sockPtr->setReadRateLimit(readRateLimit_);
+
+            if (perIpReadRateLimit_.isEnabled())
+                sockPtr->setAggregateReadLimiter(getIpReadLimiter(sockPtr->getRemoteAddress()));
+
+            sockPtr->setUringService(pNetworkThreads_[threadId].getUringService());
             sockPtr->start();
             pNetworkThreads_[threadId].addNewSocket(sockPtr);
         } 
@@ -111,11 +153,71 @@ public:
     }
 
 
+    //设置每个连接的入站限速 对之后建立的连接生效
+    void setReadRateLimit(ReadRateLimit const& limit)
+    {
+        readRateLimit_ = limit;
+    }
+
+    //设置同一个IP所有连接加起来的入站限速 对之后建立的连接生效
+    void setPerIpReadRateLimit(ReadRateLimit const& limit)
+    {
+        perIpReadRateLimit_ = limit;
+    }
+
+    /**
+    * @brief 设置每个连接的内核参数 需要在startNetwork之前调用
+    * @details listenBacklog和接收缓冲区在startNetwork的时候用于监听socket 其余的项对每个接受的连接生效
+    */
+    void setSocketOptions(SocketOptions const& options)
+    {
+        socketOptions_ = options;
+        socketOptionsVerified_ = false;
+    }
+
+    /**
+    * @brief 选择网络线程收发数据的后端 需要在startNetwork/startThreads之前调用
+    * @details 选择io_uring但内核不支持的时候 网络线程打印错误并退回到asio
+    */
+    void setNetworkBackend(NetworkBackend backend)
+    {
+        backend_ = backend;
+    }
+
+    NetworkBackend getNetworkBackend() const
+    {
+        return backend_;
+    }
+
+    SocketOptions const& getSocketOptions() const
+    {
+        return socketOptions_;
+    }
+
+    /**
+    * @brief 设置接受连接时的IP过滤 被拒绝的IP在创建socket对象之前关闭
+    * @details 需要在startNetwork之前调用 之后的规则修改直接通过IpFilter进行 不需要重新设置
+    */
+    void setIpFilter(IpFilter::ptr filter)
+    {
+        ipFilter_ = std::move(filter);
+    }
+
+    IpFilter::ptr getIpFilter() const
+    {
+        return ipFilter_;
+    }
+
     uint32_t getThreadCount() const
     {
         return threadCount_;
     }
 
+    NetworkThread<SocketType>* getNetworkThread(uint32_t index)
+    {
+        return &pNetworkThreads_[index];
+    }
+
     uint32_t getMinConnectionsThreadId() const
     {
         uint32_t minId = 0;
@@ -140,14 +242,60 @@ protected:
     SocketMgr() :
         pAcceptor_(nullptr),
         pNetworkThreads_(nullptr),
-        threadCount_(0)
+        threadCount_(0),
+        backend_(NETWORK_BACKEND_ASIO)
     {}
 
+    /**
+    * @brief 获取某个IP共享的限速器 不存在的话创建一个
+    * @details 只保存weak_ptr 该IP的连接全部断开之后限速器自动释放
+    */
+    ReadRateLimiter::ptr getIpReadLimiter(boost::asio::ip::address const& address)
+    {
+        std::lock_guard<std::mutex> lock(ipReadLimitersMutex_);
+
+        ReadRateLimiter::ptr limiter = ipReadLimiters_[address].lock();
+        if (!limiter)
+        {
+            limiter = std::make_shared<ReadRateLimiter>(perIpReadRateLimit_);
+            ipReadLimiters_[address] = limiter;
+        }
+
+        //顺便清理已经没有连接的IP 每次只从上次停下的地方往后检查几个 不在锁里遍历整个map
+        auto it = ipReadLimiters_.lower_bound(ipSweepCursor_);
+        for (uint32_t i = 0; i < IP_READ_LIMITER_SWEEP_BUDGET && ipReadLimiters_.size() > 1; ++i)
+        {
+            if (it == ipReadLimiters_.end())
+                it = ipReadLimiters_.begin();
+
+            if (it->second.expired())
+                it = ipReadLimiters_.erase(it);
+            else
+                ++it;
+        }
+        ipSweepCursor_ = it == ipReadLimiters_.end() ? boost::asio::ip::address() : it->first;
+
+        return limiter;
+    }
+
     virtual NetworkThread<SocketType>* createThreads() const = 0;
 
     AsyncAcceptor* pAcceptor_;
     NetworkThread<SocketType>* pNetworkThreads_;
     uint32_t threadCount_;
+
+    ReadRateLimit readRateLimit_;       //单个连接的入站限速
+    ReadRateLimit perIpReadRateLimit_;  //单个IP的入站限速
+    std::mutex ipReadLimitersMutex_;
+    std::map<boost::asio::ip::address, std::weak_ptr<ReadRateLimiter>> ipReadLimiters_;
+    boost::asio::ip::address ipSweepCursor_;    //下一次从这个地址开始清理
+
+    IpFilter::ptr ipFilter_;    //接受连接时的IP过滤
+
+    SocketOptions socketOptions_;   //每个连接的内核参数
+    std::atomic<bool> socketOptionsVerified_{false};
+
+    NetworkBackend backend_;    //网络线程的收发后端
 };
 
 
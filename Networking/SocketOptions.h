@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <spdlog/spdlog.h>
+
+namespace NET
+{
+
+/**
+* @struct SocketOptions
+* @brief 每个连接的内核参数 SocketMgr对每个接受的连接应用一次
+* @details 数值为0 开关为-1表示不修改 保持系统默认值
+*/
+struct SocketOptions
+{
+    int sendBufferSize = 0;         //SO_SNDBUF 内核会把设置值翻倍 并受wmem_max限制
+    int receiveBufferSize = 0;      //SO_RCVBUF 同时设置在监听socket上 窗口扩大因子在握手时确定
+    int noDelay = -1;               //TCP_NODELAY
+    int quickAck = -1;              //TCP_QUICKACK 内核会自动清除 Socket在每次读取之后重新设置
+    int userTimeoutMs = 0;          //TCP_USER_TIMEOUT 数据多久没有被确认就断开
+    int keepAlive = -1;             //SO_KEEPALIVE
+    int keepAliveIdleSec = 0;       //TCP_KEEPIDLE 空闲多久开始探测
+    int keepAliveIntervalSec = 0;   //TCP_KEEPINTVL 探测间隔
+    int keepAliveCount = 0;         //TCP_KEEPCNT 探测失败多少次断开
+    int notSentLowat = 0;           //TCP_NOTSENT_LOWAT 发送缓冲区里未发送的数据低于该值才可写
+    int busyPollUs = 0;             //SO_BUSY_POLL 阻塞读的时候忙等的微秒数 超过net.core.busy_read需要CAP_NET_ADMIN
+    int listenBacklog = 4096;       //listen的backlog
+
+    //低延迟: 关闭Nagle 立即ACK 小的未发送水位
+    //忙等需要CAP_NET_ADMIN 不放在默认配置里 有权限的进程自己设置busyPollUs
+    static SocketOptions latencyProfile()
+    {
+        SocketOptions options;
+        options.noDelay = 1;
+        options.quickAck = 1;
+        options.notSentLowat = 16 * 1024;
+        options.userTimeoutMs = 10000;
+        options.keepAlive = 1;
+        options.keepAliveIdleSec = 30;
+        options.keepAliveIntervalSec = 5;
+        options.keepAliveCount = 3;
+        return options;
+    }
+
+    //高吞吐: 大的收发缓冲区 允许合并小包
+    static SocketOptions throughputProfile()
+    {
+        SocketOptions options;
+        options.sendBufferSize = 4 * 1024 * 1024;
+        options.receiveBufferSize = 4 * 1024 * 1024;
+        options.noDelay = 0;
+        options.keepAlive = 1;
+        options.keepAliveIdleSec = 60;
+        options.keepAliveIntervalSec = 10;
+        options.keepAliveCount = 5;
+        options.listenBacklog = 16384;
+        return options;
+    }
+};
+
+
+namespace SocketOptionsUtil
+{
+
+inline bool setOption(int fd, int level, int name, int value, char const* optionName)
+{
+    if (::setsockopt(fd, level, name, &value, sizeof(value)))
+    {
+        //spdlog按引用拿参数 格式化之前可能改掉errno 先保存下来
+        int error = errno;
+        spdlog::error("SocketOptions::apply failed to set {}={} errno {}", optionName, value, error);
+        return false;
+    }
+
+    return true;
+}
+
+//没有CAP_NET_ADMIN的时候每个连接都会失败 只打印一次 不刷屏
+inline bool setBusyPoll(int fd, int us)
+{
+    if (!::setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)))
+        return true;
+
+    int error = errno;
+    static std::atomic<bool> logged(false);
+    if (!logged.exchange(true))
+        spdlog::warn("SocketOptions::apply failed to set SO_BUSY_POLL={} errno {}, values above net.core.busy_read need CAP_NET_ADMIN",
+            us, error);
+
+    return false;
+}
+
+inline int getOption(int fd, int level, int name)
+{
+    int value = 0;
+    socklen_t length = sizeof(value);
+    if (::getsockopt(fd, level, name, &value, &length))
+        return -1;
+
+    return value;
+}
+
+/**
+* @brief 把options应用到fd上 只修改设置过的项
+* @return 有任意一项失败的时候返回false 其余的项仍然会设置
+*/
+inline bool apply(int fd, SocketOptions const& options)
+{
+    bool ok = true;
+
+    if (options.sendBufferSize > 0)
+        ok &= setOption(fd, SOL_SOCKET, SO_SNDBUF, options.sendBufferSize, "SO_SNDBUF");
+    if (options.receiveBufferSize > 0)
+        ok &= setOption(fd, SOL_SOCKET, SO_RCVBUF, options.receiveBufferSize, "SO_RCVBUF");
+    if (options.noDelay >= 0)
+        ok &= setOption(fd, IPPROTO_TCP, TCP_NODELAY, options.noDelay, "TCP_NODELAY");
+    if (options.quickAck >= 0)
+        ok &= setOption(fd, IPPROTO_TCP, TCP_QUICKACK, options.quickAck, "TCP_QUICKACK");
+    if (options.userTimeoutMs > 0)
+        ok &= setOption(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, options.userTimeoutMs, "TCP_USER_TIMEOUT");
+    if (options.keepAlive >= 0)
+        ok &= setOption(fd, SOL_SOCKET, SO_KEEPALIVE, options.keepAlive, "SO_KEEPALIVE");
+    if (options.keepAliveIdleSec > 0)
+        ok &= setOption(fd, IPPROTO_TCP, TCP_KEEPIDLE, options.keepAliveIdleSec, "TCP_KEEPIDLE");
+    if (options.keepAliveIntervalSec > 0)
+        ok &= setOption(fd, IPPROTO_TCP, TCP_KEEPINTVL, options.keepAliveIntervalSec, "TCP_KEEPINTVL");
+    if (options.keepAliveCount > 0)
+        ok &= setOption(fd, IPPROTO_TCP, TCP_KEEPCNT, options.keepAliveCount, "TCP_KEEPCNT");
+    if (options.notSentLowat > 0)
+        ok &= setOption(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.notSentLowat, "TCP_NOTSENT_LOWAT");
+    if (options.busyPollUs > 0)
+        ok &= setBusyPoll(fd, options.busyPollUs);
+
+    return ok;
+}
+
+/**
+* @brief 从内核读出fd当前的实际值 用来确认设置是否生效
+* @details listenBacklog无法从内核读取 保持默认值 读取失败的项为-1
+*/
+inline SocketOptions read(int fd)
+{
+    SocketOptions options;
+    options.sendBufferSize = getOption(fd, SOL_SOCKET, SO_SNDBUF);
+    options.receiveBufferSize = getOption(fd, SOL_SOCKET, SO_RCVBUF);
+    options.noDelay = getOption(fd, IPPROTO_TCP, TCP_NODELAY);
+    options.quickAck = getOption(fd, IPPROTO_TCP, TCP_QUICKACK);
+    options.userTimeoutMs = getOption(fd, IPPROTO_TCP, TCP_USER_TIMEOUT);
+    options.keepAlive = getOption(fd, SOL_SOCKET, SO_KEEPALIVE);
+    options.keepAliveIdleSec = getOption(fd, IPPROTO_TCP, TCP_KEEPIDLE);
+    options.keepAliveIntervalSec = getOption(fd, IPPROTO_TCP, TCP_KEEPINTVL);
+    options.keepAliveCount = getOption(fd, IPPROTO_TCP, TCP_KEEPCNT);
+    options.notSentLowat = getOption(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT);
+    options.busyPollUs = getOption(fd, SOL_SOCKET, SO_BUSY_POLL);
+    return options;
+}
+
+/**
+* @brief 检查设置的值和内核实际的值是否一致 不一致的项打印出来
+* @details 缓冲区大小内核会翻倍 所以只检查是否小于设置值(被wmem_max/rmem_max截断)
+*/
+inline bool verify(int fd, SocketOptions const& expected)
+{
+    SocketOptions actual = read(fd);
+    bool ok = true;
+
+    auto check = [&ok](char const* name, bool matched, int want, int got){
+        if (!matched)
+        {
+            spdlog::warn("SocketOptions::verify {} expected {} but kernel reports {}", name, want, got);
+            ok = false;
+        }
+    };
+
+    if (expected.sendBufferSize > 0)
+        check("SO_SNDBUF", actual.sendBufferSize >= expected.sendBufferSize, expected.sendBufferSize, actual.sendBufferSize);
+    if (expected.receiveBufferSize > 0)
+        check("SO_RCVBUF", actual.receiveBufferSize >= expected.receiveBufferSize, expected.receiveBufferSize, actual.receiveBufferSize);
+    if (expected.noDelay >= 0)
+        check("TCP_NODELAY", !!actual.noDelay == !!expected.noDelay, expected.noDelay, actual.noDelay);
+    if (expected.userTimeoutMs > 0)
+        check("TCP_USER_TIMEOUT", actual.userTimeoutMs == expected.userTimeoutMs, expected.userTimeoutMs, actual.userTimeoutMs);
+    if (expected.keepAlive >= 0)
+        check("SO_KEEPALIVE", !!actual.keepAlive == !!expected.keepAlive, expected.keepAlive, actual.keepAlive);
+    if (expected.keepAliveIdleSec > 0)
+        check("TCP_KEEPIDLE", actual.keepAliveIdleSec == expected.keepAliveIdleSec, expected.keepAliveIdleSec, actual.keepAliveIdleSec);
+    if (expected.keepAliveIntervalSec > 0)
+        check("TCP_KEEPINTVL", actual.keepAliveIntervalSec == expected.keepAliveIntervalSec, expected.keepAliveIntervalSec, actual.keepAliveIntervalSec);
+    if (expected.keepAliveCount > 0)
+        check("TCP_KEEPCNT", actual.keepAliveCount == expected.keepAliveCount, expected.keepAliveCount, actual.keepAliveCount);
+    if (expected.notSentLowat > 0)
+        check("TCP_NOTSENT_LOWAT", actual.notSentLowat == expected.notSentLowat, expected.notSentLowat, actual.notSentLowat);
+    if (expected.busyPollUs > 0)
+        check("SO_BUSY_POLL", actual.busyPollUs == expected.busyPollUs, expected.busyPollUs, actual.busyPollUs);
+
+    return ok;
+}
+
+}// namespace SocketOptionsUtil
+
+
+}
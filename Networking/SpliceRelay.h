@@ -0,0 +1,456 @@
+#pragma once
+
+#include <utility>
+#include <boost/asio.hpp>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include "Socket.h"
+#include "../Utilities/MessageBuffer.h"
+
+#define SPLICE_CHUNK_SIZE (64 * 1024)       //每次splice最多搬运的字节数
+#define RELAY_COPY_BLOCK_SIZE (16 * 1024)   //拷贝模式下每次读取的字节数
+#define RELAY_PUMP_ROUNDS 16                //一次pump最多循环的次数 超过之后重新post 避免饿死其他socket
+
+namespace NET
+{
+
+/**
+* @class SpliceRelay
+* @brief 把两个socket对接起来 双向转发原始字节流
+* @details 默认使用splice(socket -> pipe -> socket) 数据不经过用户态
+*          设置了Inspector或者内核不支持splice的时候退化为read/write拷贝 Inspector可以查看/修改每一段数据
+*          开始转发之后socket不再调用readHandler 也不再处理发送队列 两端任意一端出错或者两个方向都读到EOF之后关闭两端
+*
+*          必须在socket所属的网络线程调用start 两个socket也必须属于同一个网络线程
+*          一般在readHandler里面解析完握手之后调用start 代替asyncRead
+*/
+template<class A, class B>
+class SpliceRelay : public std::enable_shared_from_this<SpliceRelay<A, B>>
+{
+public:
+    using ptr = std::shared_ptr<SpliceRelay>;
+
+    /**
+    * @brief 检查转发的数据
+    * @param data 即将转发的数据 可以修改
+    * @param fromFirst 数据是否由first发往second
+    * @return false表示关闭两端
+    */
+    using Inspector = std::function<bool(UTIL::MessageBuffer& data, bool fromFirst)>;
+
+public:
+    /**
+    * @brief 开始转发
+    * @param first 第一个socket
+    * @param second 第二个socket
+    * @param inspector 不为空的时候使用拷贝模式
+    * @param pipeSize 管道的容量 0表示使用系统默认值
+    * @return 失败的时候返回nullptr 两个socket保持原样
+    */
+    static ptr start(std::shared_ptr<A> first, std::shared_ptr<B> second, Inspector inspector = nullptr, int pipeSize = 0)
+    {
+        if (!first || !second || !first->IsOpen() || !second->IsOpen())
+            return nullptr;
+
+        if (first->relaying_ || second->relaying_)
+        {
+            spdlog::error("SpliceRelay::start socket is already relaying");
+            return nullptr;
+        }
+
+        //io_uring模式下还有内核持有的接收请求 不能直接在fd上splice
+        if (first->isUsingUring() || second->isUsingUring())
+        {
+            spdlog::error("SpliceRelay::start sockets using io_uring can not be relayed");
+            return nullptr;
+        }
+
+        if (&first->socket_.get_executor().context() != &second->socket_.get_executor().context())
+        {
+            spdlog::error("SpliceRelay::start {} and {} belong to different network threads",
+                first->getRemoteAddress().to_string(), second->getRemoteAddress().to_string());
+            return nullptr;
+        }
+
+        ptr relay(new SpliceRelay(std::move(first), std::move(second), std::move(inspector)));
+        if (!relay->inspector_)
+        {
+            for (Direction& dir : relay->dirs_)
+                dir.openPipe(pipeSize);
+        }
+
+        //取消socket上还没完成的读写 回调会在begin之前执行
+        relay->first_->relaying_ = true;
+        relay->second_->relaying_ = true;
+
+        boost::system::error_code error;
+        relay->first_->readDelayTimer_.cancel(error);
+        relay->second_->readDelayTimer_.cancel(error);
+        relay->first_->socket_.cancel(error);
+        relay->second_->socket_.cancel(error);
+        relay->first_->socket_.non_blocking(true, error);
+        relay->second_->socket_.non_blocking(true, error);
+
+        boost::asio::post(relay->first_->socket_.get_executor(), [relay](){
+            relay->begin();
+        });
+
+        return relay;
+    }
+
+    ~SpliceRelay()
+    {
+        for (Direction& dir : dirs_)
+            dir.closePipe();
+    }
+
+    //主动结束转发 并关闭两端
+    void stop()
+    {
+        ptr self = this->shared_from_this();
+        boost::asio::post(first_->socket_.get_executor(), [self](){
+            self->closeBoth();
+        });
+    }
+
+    //fromFirst方向已经转发的字节数
+    uint64_t getRelayedBytes(bool fromFirst) const
+    {
+        return dirs_[fromFirst ? 0 : 1].bytes_;
+    }
+
+    //当前是否使用splice转发
+    bool isSpliceEnabled(bool fromFirst) const
+    {
+        return dirs_[fromFirst ? 0 : 1].pipe_[0] >= 0;
+    }
+
+private:
+    /**
+    * @struct Direction
+    * @brief 一个方向的转发状态
+    * @details 数据的顺序: pending_(用户态数据) -> pipe_(内核中的数据) -> 源socket
+    */
+    struct Direction
+    {
+        Direction(boost::asio::ip::tcp::socket& from, boost::asio::ip::tcp::socket& to, bool fromFirst) :
+            from_(from),
+            to_(to),
+            fromFirst_(fromFirst),
+            pipeBytes_(0),
+            pending_(RELAY_COPY_BLOCK_SIZE),
+            eof_(false),
+            done_(false),
+            bytes_(0)
+        {}
+
+        void openPipe(int pipeSize)
+        {
+            if (::pipe2(pipe_, O_NONBLOCK | O_CLOEXEC))
+            {
+                spdlog::error("SpliceRelay::openPipe pipe2 failed, errno {}, falling back to copy", errno);
+                pipe_[0] = pipe_[1] = -1;
+                return;
+            }
+
+            if (pipeSize > 0 && ::fcntl(pipe_[0], F_SETPIPE_SZ, pipeSize) < 0)
+                spdlog::info("SpliceRelay::openPipe F_SETPIPE_SZ({}) failed, errno {}", pipeSize, errno);
+        }
+
+        void closePipe()
+        {
+            for (int& fd : pipe_)
+            {
+                if (fd >= 0)
+                    ::close(fd);
+                fd = -1;
+            }
+        }
+
+        boost::asio::ip::tcp::socket& from_;
+        boost::asio::ip::tcp::socket& to_;
+        bool fromFirst_;
+
+        int pipe_[2] = { -1, -1 };
+        std::size_t pipeBytes_;         //管道里还没写到目标socket的字节数
+        UTIL::MessageBuffer pending_;   //用户态还没写到目标socket的数据
+        bool eof_;                      //源socket已经读到EOF
+        bool done_;                     //该方向已经结束
+        std::atomic<uint64_t> bytes_;   //已经写到目标socket的字节数
+    };
+
+    SpliceRelay(std::shared_ptr<A>&& first, std::shared_ptr<B>&& second, Inspector&& inspector) :
+        first_(std::move(first)),
+        second_(std::move(second)),
+        inspector_(std::move(inspector)),
+        dirs_{ { Direction(first_->socket_, second_->socket_, true), Direction(second_->socket_, first_->socket_, false) } },
+        closed_(false)
+    {}
+
+    //接管两端残留的数据 目标socket发送队列里的数据排在转发的数据前面
+    void begin()
+    {
+        if (!first_->IsOpen() || !second_->IsOpen())
+        {
+            closeBoth();
+            return;
+        }
+
+        second_->takeSendQueue(dirs_[0].pending_);
+        first_->takeSendQueue(dirs_[1].pending_);
+
+        if (!takeReadBuffer(first_->recvBuf_, dirs_[0]) || !takeReadBuffer(second_->recvBuf_, dirs_[1]))
+        {
+            closeBoth();
+            return;
+        }
+
+        pump(0);
+        pump(1);
+    }
+
+    //源socket已经读取但是还没有被readHandler处理的数据
+    bool takeReadBuffer(UTIL::MessageBuffer& recvBuf, Direction& dir)
+    {
+        std::size_t size = recvBuf.getActiveSize();
+        if (!size)
+            return true;
+
+        UTIL::MessageBuffer data(size);
+        data.write(recvBuf.getReadPoint(), size);
+        recvBuf.readCommit(size);
+
+        if (inspector_ && !inspector_(data, dir.fromFirst_))
+            return false;
+
+        dir.pending_.normalize();
+        if (dir.pending_.getRemainingSpace() < data.getActiveSize())
+            dir.pending_.resize(dir.pending_.getBufferSize() + data.getActiveSize());
+        dir.pending_.write(data.getReadPoint(), data.getActiveSize());
+        return true;
+    }
+
+    void pump(int index)
+    {
+        Direction& dir = dirs_[index];
+        if (closed_ || dir.done_)
+            return;
+
+        if (!first_->IsOpen() || !second_->IsOpen())
+        {
+            closeBoth();
+            return;
+        }
+
+        boost::system::error_code error;
+        for (int round = 0; round < RELAY_PUMP_ROUNDS; ++round)
+        {
+            //先把用户态的数据写出去
+            if (dir.pending_.getActiveSize())
+            {
+                std::size_t sent = dir.to_.write_some(
+                    boost::asio::buffer(dir.pending_.getReadPoint(), dir.pending_.getActiveSize()), error);
+                if (error == boost::asio::error::would_block || error == boost::asio::error::try_again)
+                {
+                    waitWrite(index);
+                    return;
+                }
+                if (error)
+                {
+                    fail(dir, "write", error.message());
+                    return;
+                }
+
+                dir.pending_.readCommit(sent);
+                dir.bytes_ += sent;
+                continue;
+            }
+
+            //再把管道里的数据写出去
+            if (dir.pipeBytes_)
+            {
+                ssize_t moved = ::splice(dir.pipe_[0], nullptr, dir.to_.native_handle(), nullptr,
+                    dir.pipeBytes_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (moved < 0)
+                {
+                    if (errno == EAGAIN)
+                    {
+                        waitWrite(index);
+                        return;
+                    }
+                    if (errno == EINTR)
+                        continue;
+
+                    fail(dir, "splice to socket", strerror(errno));
+                    return;
+                }
+
+                dir.pipeBytes_ -= moved;
+                dir.bytes_ += moved;
+                continue;
+            }
+
+            //残留数据都写完了 才把EOF传递给对端
+            if (dir.eof_)
+            {
+                finish(dir);
+                return;
+            }
+
+            if (dir.pipe_[0] >= 0)
+            {
+                ssize_t moved = ::splice(dir.from_.native_handle(), nullptr, dir.pipe_[1], nullptr,
+                    SPLICE_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (moved > 0)
+                {
+                    dir.pipeBytes_ += moved;
+                    continue;
+                }
+                if (moved == 0)
+                {
+                    dir.eof_ = true;
+                    continue;
+                }
+
+                //管道是空的 所以EAGAIN只可能是socket没有数据
+                if (errno == EAGAIN)
+                {
+                    waitRead(index);
+                    return;
+                }
+                if (errno == EINTR)
+                    continue;
+                if (errno == EINVAL)
+                {
+                    spdlog::info("SpliceRelay::pump splice is not supported, falling back to copy");
+                    dir.closePipe();
+                    continue;
+                }
+
+                fail(dir, "splice from socket", strerror(errno));
+                return;
+            }
+
+            //拷贝模式 pending_此时是空的 读到的数据就是新的一段
+            dir.pending_.reset();
+            std::size_t received = dir.from_.read_some(
+                boost::asio::buffer(dir.pending_.getWritePoint(), dir.pending_.getRemainingSpace()), error);
+            if (error == boost::asio::error::eof)
+            {
+                dir.eof_ = true;
+                continue;
+            }
+            if (error == boost::asio::error::would_block || error == boost::asio::error::try_again)
+            {
+                waitRead(index);
+                return;
+            }
+            if (error)
+            {
+                fail(dir, "read", error.message());
+                return;
+            }
+
+            dir.pending_.writeCommit(received);
+            if (inspector_ && !inspector_(dir.pending_, dir.fromFirst_))
+            {
+                closeBoth();
+                return;
+            }
+        }
+
+        //让出网络线程 稍后继续
+        ptr self = this->shared_from_this();
+        boost::asio::post(first_->socket_.get_executor(), [self, index](){
+            self->pump(index);
+        });
+    }
+
+    void waitRead(int index)
+    {
+        ptr self = this->shared_from_this();
+        dirs_[index].from_.async_wait(boost::asio::ip::tcp::socket::wait_read,
+            [self, index](boost::system::error_code error){
+                self->onReady(index, error);
+            });
+    }
+
+    void waitWrite(int index)
+    {
+        ptr self = this->shared_from_this();
+        dirs_[index].to_.async_wait(boost::asio::ip::tcp::socket::wait_write,
+            [self, index](boost::system::error_code error){
+                self->onReady(index, error);
+            });
+    }
+
+    void onReady(int index, boost::system::error_code error)
+    {
+        if (error)
+        {
+            if (error != boost::asio::error::operation_aborted)
+                fail(dirs_[index], "wait", error.message());
+            else
+                closeBoth();
+            return;
+        }
+
+        pump(index);
+    }
+
+    //一个方向结束了 半关闭目标socket 两个方向都结束之后关闭两端
+    void finish(Direction& dir)
+    {
+        dir.done_ = true;
+        dir.closePipe();
+
+        boost::system::error_code error;
+        dir.to_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, error);
+
+        if (dirs_[0].done_ && dirs_[1].done_)
+            closeBoth();
+    }
+
+    void fail(Direction& dir, char const* op, std::string const& message)
+    {
+        spdlog::error("SpliceRelay::pump {} {} -> {} failed: {}", op,
+            dir.fromFirst_ ? first_->getRemoteAddress().to_string() : second_->getRemoteAddress().to_string(),
+            dir.fromFirst_ ? second_->getRemoteAddress().to_string() : first_->getRemoteAddress().to_string(),
+            message);
+        closeBoth();
+    }
+
+    //关闭两端 并取消还在等待的读写 释放对两个socket的引用
+    void closeBoth()
+    {
+        if (closed_)
+            return;
+
+        closed_ = true;
+        first_->closeSocket();
+        second_->closeSocket();
+
+        boost::system::error_code error;
+        first_->socket_.cancel(error);
+        second_->socket_.cancel(error);
+    }
+
+private:
+    std::shared_ptr<A> first_;
+    std::shared_ptr<B> second_;
+    Inspector inspector_;
+    std::array<Direction, 2> dirs_;     //0: first -> second  1: second -> first
+    bool closed_;
+};
+
+
+}
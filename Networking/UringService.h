@@ -0,0 +1,325 @@
+#pragma once
+
+#include <utility>
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <sys/eventfd.h>
+#include <cstdio>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include <spdlog/spdlog.h>
+#include "IoUring.h"
+
+#define URING_SQ_ENTRIES 4096
+#define URING_RECV_BUFFER_COUNT 1024            //接收缓冲区个数
+#define URING_RECV_BUFFER_SIZE (16 * 1024)      //每个接收缓冲区的大小
+#define URING_RECV_BUFFER_GROUP 0
+#define URING_MIN_KERNEL_MAJOR 6                //多次接收IORING_RECV_MULTISHOT需要6.0
+#define URING_MIN_KERNEL_MINOR 0
+
+namespace NET
+{
+
+/**
+* @class UringService
+* @brief 挂在网络线程io_context上的io_uring
+* @details io_uring注册一个eventfd 有完成项的时候eventfd可读 由io_context的reactor唤醒线程处理完成项
+*          定时器/accept等仍然走asio 只有连接的收发走io_uring
+*          同一次事件循环里准备好的所有请求只调用一次io_uring_enter提交
+*          只能在所属的网络线程使用
+*/
+class UringService
+{
+public:
+    using ptr = std::shared_ptr<UringService>;
+
+    /**
+    * @brief 完成回调
+    * @param result 成功时为字节数 失败时为-errno
+    * @param flags cqe的flags 包含IORING_CQE_F_MORE和缓冲区编号
+    */
+    using Handler = std::function<void(int result, uint32_t flags)>;
+
+public:
+    /**
+    * @brief 在ioc上创建io_uring
+    * @return 内核版本低于6.0 缺少需要的特性或者任何一步初始化失败的时候返回nullptr 调用者退回到asio
+    */
+    static ptr create(boost::asio::io_context& ioc)
+    {
+        ptr service(new UringService(ioc));
+        if (!service->init())
+            return nullptr;
+
+        return service;
+    }
+
+    ~UringService()
+    {
+        boost::system::error_code error;
+        notifier_.close(error);
+
+        //先关闭io_uring 内核不会再访问请求里的缓冲区 之后才释放回调持有的连接
+        uring_.close();
+    }
+
+    /**
+    * @brief 多次接收 一次提交之后每收到一批数据产生一个完成项 数据放在缓冲池里
+    * @return 请求的编号 用来取消
+    */
+    uint64_t recvMultishot(int fd, Handler handler)
+    {
+        //提交队列放不下的时候当作缓冲区暂时用完 上层会重新开始接收
+        io_uring_sqe* sqe = allocSqe();
+        if (!sqe)
+            return failLater(std::move(handler), -ENOBUFS);
+
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = buffers_.getGroupId();
+
+        return track(sqe, std::move(handler));
+    }
+
+    /**
+    * @brief 发送 msg和其中的iovec在完成之前必须保持有效
+    */
+    uint64_t sendMsg(int fd, msghdr const* msg, Handler handler)
+    {
+        //提交队列放不下的时候这一批没有发出去 下一次update再发
+        io_uring_sqe* sqe = allocSqe();
+        if (!sqe)
+            return failLater(std::move(handler), -EAGAIN);
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(msg);
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+
+        return track(sqe, std::move(handler));
+    }
+
+    //取消一个还没有完成的请求 被取消的请求以-ECANCELED完成
+    void cancel(uint64_t token)
+    {
+        if (!handlers_.count(token))
+            return;
+
+        io_uring_sqe* sqe = allocSqe();
+        if (!sqe)
+        {
+            spdlog::warn("UringService::cancel submission queue is full, request {} not cancelled", token);
+            return;
+        }
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = token;
+        sqe->user_data = 0;
+    }
+
+    /**
+    * @brief 把准备好的请求交给内核
+    * @return 提交的个数 失败的时候返回-errno
+    */
+    int submit()
+    {
+        int result = uring_.submit();
+        if (result < 0 && result != -EAGAIN && result != -EBUSY && result != -EINTR)
+            spdlog::error("UringService::submit io_uring_enter failed, errno {}", -result);
+
+        return result;
+    }
+
+    uint8_t* getBuffer(uint16_t bufferId) { return buffers_.getBuffer(bufferId); }
+
+    /**
+    * @brief 接收完成项里面的数据拷走之后 把缓冲区还给内核
+    * @details 提交队列满的时候先提交一次 还是放不下(比如完成队列溢出的时候内核返回EBUSY)就先记下来
+    *          处理完这一轮完成项之后再还 不在这里一直重试
+    */
+    void recycleBuffer(uint16_t bufferId)
+    {
+        if (!buffers_.recycle(bufferId) && (submit() <= 0 || !buffers_.recycle(bufferId)))
+        {
+            pendingRecycles_.push_back(bufferId);
+            return;
+        }
+
+        scheduleSubmit();
+    }
+
+    std::size_t getPendingCount() const { return handlers_.size(); }
+
+private:
+    explicit UringService(boost::asio::io_context& ioc) :
+        ioc_(ioc),
+        notifier_(ioc),
+        eventValue_(0),
+        nextToken_(1),
+        submitScheduled_(false)
+    {}
+
+    bool init()
+    {
+        if (!kernelSupported())
+            return false;
+
+        if (!uring_.init(URING_SQ_ENTRIES))
+            return false;
+
+        //还缓冲区的请求依赖IOSQE_CQE_SKIP_SUCCESS
+        if (!(uring_.getFeatures() & IORING_FEAT_CQE_SKIP))
+        {
+            spdlog::warn("UringService::init kernel does not support IOSQE_CQE_SKIP_SUCCESS");
+            return false;
+        }
+
+        if (!buffers_.init(uring_, URING_RECV_BUFFER_COUNT, URING_RECV_BUFFER_SIZE, URING_RECV_BUFFER_GROUP))
+            return false;
+
+        int eventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (eventFd < 0)
+        {
+            spdlog::error("UringService::init eventfd failed, errno {}", errno);
+            return false;
+        }
+
+        notifier_.assign(eventFd);
+        if (!uring_.registerEventFd(eventFd))
+            return false;
+
+        waitCompletions();
+        return true;
+    }
+
+    //多次接收没有对应的特性标志 提交之后才以EINVAL失败 所以按内核版本检查
+    static bool kernelSupported()
+    {
+        utsname name;
+        unsigned major = 0;
+        unsigned minor = 0;
+        if (::uname(&name) || sscanf(name.release, "%u.%u", &major, &minor) != 2)
+            return false;
+
+        if (major < URING_MIN_KERNEL_MAJOR || (major == URING_MIN_KERNEL_MAJOR && minor < URING_MIN_KERNEL_MINOR))
+        {
+            spdlog::warn("UringService::init kernel {} is older than {}.{} required by multishot recv",
+                name.release, URING_MIN_KERNEL_MAJOR, URING_MIN_KERNEL_MINOR);
+            return false;
+        }
+
+        return true;
+    }
+
+    //提交队列满了的时候先提交一次 还是没有空位返回nullptr
+    io_uring_sqe* allocSqe()
+    {
+        io_uring_sqe* sqe = uring_.getSqe();
+        if (!sqe && submit() > 0)
+            sqe = uring_.getSqe();
+
+        if (sqe)
+            scheduleSubmit();
+        return sqe;
+    }
+
+    //请求没有提交出去 在下一轮事件循环里用error调用回调 返回的编号不对应任何请求
+    uint64_t failLater(Handler&& handler, int error)
+    {
+        boost::asio::post(ioc_, [handler = std::move(handler), error]() {
+            handler(error, 0);
+        });
+        return 0;
+    }
+
+    //把之前没有还回去的缓冲区还给内核 提交队列又满了就留到下一次
+    void flushRecycles()
+    {
+        while (!pendingRecycles_.empty() && buffers_.recycle(pendingRecycles_.back()))
+            pendingRecycles_.pop_back();
+    }
+
+    //本轮事件循环结束之后统一提交
+    void scheduleSubmit()
+    {
+        if (submitScheduled_)
+            return;
+
+        submitScheduled_ = true;
+        boost::asio::post(ioc_, [this](){
+            submitScheduled_ = false;
+            flushRecycles();
+            submit();
+        });
+    }
+
+    uint64_t track(io_uring_sqe* sqe, Handler&& handler)
+    {
+        uint64_t token = nextToken_++;
+        sqe->user_data = token;
+        handlers_.emplace(token, std::move(handler));
+        return token;
+    }
+
+    void waitCompletions()
+    {
+        notifier_.async_read_some(boost::asio::buffer(&eventValue_, sizeof(eventValue_)),
+            [this](boost::system::error_code error, std::size_t){
+                if (error)
+                    return;
+
+                reap();
+                waitCompletions();
+            });
+    }
+
+    void reap()
+    {
+        uring_.forEachCqe([this](io_uring_cqe const& cqe){
+            auto it = handlers_.find(cqe.user_data);
+            if (it == handlers_.end())
+                return;
+
+            //多次接收在没有IORING_CQE_F_MORE之前一直有效
+            if (cqe.flags & IORING_CQE_F_MORE)
+            {
+                it->second(cqe.res, cqe.flags);
+                return;
+            }
+
+            Handler handler = std::move(it->second);
+            handlers_.erase(it);
+            handler(cqe.res, cqe.flags);
+        });
+
+        //回调里面准备的请求立即提交
+        flushRecycles();
+        submit();
+
+        if (!pendingRecycles_.empty())
+            scheduleSubmit();
+    }
+
+private:
+    boost::asio::io_context& ioc_;
+    IoUring uring_;
+    IoUringBufferPool buffers_;
+    boost::asio::posix::stream_descriptor notifier_;   //注册给io_uring的eventfd
+    uint64_t eventValue_;
+
+    uint64_t nextToken_;    //请求编号 0留给取消请求
+    std::unordered_map<uint64_t, Handler> handlers_;
+    bool submitScheduled_;
+    std::vector<uint16_t> pendingRecycles_;     //提交队列满的时候还没有还给内核的缓冲区
+};
+
+
+}
@@ -0,0 +1,387 @@
+#pragma once
+
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace THREADING
+{
+
+
+template <typename T>
+class Future;
+
+namespace detail
+{
+
+//Future<void>里面存放的占位值
+struct Unit {};
+
+template <typename T>
+using StoredType = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+
+/**
+* @class SharedState
+* @brief Future和生产者共享的状态
+* @details 完成之前注册的后续任务保存起来 完成的时候一次性提交到线程池 完成之后注册的直接提交
+*          没有线程池的时候在完成的线程上直接执行
+*/
+template <typename T>
+class SharedState
+{
+public:
+    using ptr = std::shared_ptr<SharedState>;
+
+public:
+    explicit SharedState(ThreadPool* pool) :
+        pool_(pool),
+        ready_(false)
+    {}
+
+    bool isReady() const { return ready_.load(std::memory_order_acquire); }
+
+    ThreadPool* getPool() const { return pool_; }
+
+    void setValue(StoredType<T>&& value)
+    {
+        value_.emplace(std::move(value));
+        complete();
+    }
+
+    void setException(std::exception_ptr exception)
+    {
+        exception_ = exception;
+        complete();
+    }
+
+    //完成之后才能调用
+    std::exception_ptr getException() const { return exception_; }
+    StoredType<T>& getValue() { return *value_; }
+
+    /**
+    * @brief 注册完成之后执行的任务
+    */
+    void onReady(std::function<void()> continuation)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ready_.load(std::memory_order_relaxed))
+            {
+                continuations_.push_back(std::move(continuation));
+                return;
+            }
+        }
+
+        dispatch(std::move(continuation));
+    }
+
+    /**
+    * @brief 阻塞等待完成 有线程池的时候等待的线程帮忙执行任务
+    * @details promise可能不是在线程池里完成的 complete的时候会通知线程池里等待的线程
+    */
+    void wait()
+    {
+        if (isReady())
+            return;
+
+        if (pool_)
+        {
+            pool_->waitUntil([this]() { return isReady(); });
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return isReady(); });
+    }
+
+private:
+    void complete()
+    {
+        std::vector<std::function<void()>> continuations;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.store(true, std::memory_order_release);
+            continuations.swap(continuations_);
+        }
+        cond_.notify_all();
+        if (pool_)
+            pool_->notifyWaiters();
+
+        for (auto& continuation : continuations)
+            dispatch(std::move(continuation));
+    }
+
+    void dispatch(std::function<void()>&& continuation)
+    {
+        if (pool_)
+            pool_->post(std::move(continuation));
+        else
+            continuation();
+    }
+
+private:
+    ThreadPool* pool_;
+    std::atomic<bool> ready_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<std::function<void()>> continuations_;
+    std::optional<StoredType<T>> value_;
+    std::exception_ptr exception_;
+};
+
+
+//执行func 把结果或者异常放进state
+template <typename T, typename F, typename... Args>
+void fulfill(SharedState<T>& state, F& func, Args&&... args)
+{
+    try
+    {
+        if constexpr (std::is_void_v<T>)
+        {
+            func(std::forward<Args>(args)...);
+            state.setValue(Unit());
+        }
+        else
+        {
+            state.setValue(func(std::forward<Args>(args)...));
+        }
+    }
+    catch (...)
+    {
+        state.setException(std::current_exception());
+    }
+}
+
+}// namespace detail
+
+
+/**
+* @class Future
+* @brief 轻量的future 可以用then挂后续任务
+* @details 和std::future不同 可以复制 多个后续任务共享同一个结果
+*          then不阻塞任何线程 结果就绪之后后续任务才提交到线程池
+*          get会阻塞 但是在线程池里调用的时候会帮忙执行其他任务 不会把线程耗尽
+*/
+template <typename T>
+class Future
+{
+public:
+    using State = detail::SharedState<T>;
+
+public:
+    Future() = default;
+
+    explicit Future(typename State::ptr state) :
+        state_(std::move(state))
+    {}
+
+    bool isValid() const { return state_ != nullptr; }
+
+    bool isReady() const { return state_ && state_->isReady(); }
+
+    /**
+    * @brief 等待完成
+    */
+    void wait() const
+    {
+        state_->wait();
+    }
+
+    /**
+    * @brief 等待并取得结果 任务抛出的异常在这里重新抛出
+    */
+    decltype(auto) get() const
+    {
+        state_->wait();
+        if (state_->getException())
+            std::rethrow_exception(state_->getException());
+
+        if constexpr (!std::is_void_v<T>)
+            return static_cast<T const&>(state_->getValue());
+    }
+
+    /**
+    * @brief 结果就绪之后在线程池里执行func
+    * @details func的参数是结果的引用(void没有参数) 返回值成为新Future的结果
+    *          前面的任务抛出异常的时候不执行func 异常直接传给新的Future
+    * @return func返回值的Future
+    */
+    template <typename F>
+    auto then(F&& func) const
+    {
+        using R = typename ResultOf<std::decay_t<F>>::type;
+
+        auto next = std::make_shared<detail::SharedState<R>>(state_->getPool());
+        auto callable = std::make_shared<std::decay_t<F>>(std::forward<F>(func));
+        auto state = state_;
+
+        state_->onReady([state, next, callable]() {
+            if (state->getException())
+            {
+                next->setException(state->getException());
+                return;
+            }
+
+            if constexpr (std::is_void_v<T>)
+                detail::fulfill(*next, *callable);
+            else
+                detail::fulfill(*next, *callable, state->getValue());
+        });
+
+        return Future<R>(next);
+    }
+
+    //内部使用 whenAll/whenAny需要直接挂到状态上
+    typename State::ptr const& getState() const { return state_; }
+
+private:
+    template <typename F, bool IsVoid = std::is_void_v<T>>
+    struct ResultOf
+    {
+        using type = std::invoke_result_t<F&>;
+    };
+
+    template <typename F>
+    struct ResultOf<F, false>
+    {
+        using type = std::invoke_result_t<F&, T&>;
+    };
+
+private:
+    typename State::ptr state_;
+};
+
+
+/**
+* @brief 在线程池里执行func
+* @return func返回值的Future
+*/
+template <typename F>
+auto async(ThreadPool& pool, F&& func)
+{
+    using R = std::invoke_result_t<std::decay_t<F>&>;
+
+    auto state = std::make_shared<detail::SharedState<R>>(&pool);
+    pool.post([state, func = std::forward<F>(func)]() mutable {
+        detail::fulfill(*state, func);
+    });
+
+    return Future<R>(state);
+}
+
+
+/**
+* @brief 一个已经完成的Future
+*/
+template <typename T>
+Future<std::decay_t<T>> makeReadyFuture(ThreadPool* pool, T&& value)
+{
+    auto state = std::make_shared<detail::SharedState<std::decay_t<T>>>(pool);
+    state->setValue(std::decay_t<T>(std::forward<T>(value)));
+    return Future<std::decay_t<T>>(state);
+}
+
+inline Future<void> makeReadyFuture(ThreadPool* pool)
+{
+    auto state = std::make_shared<detail::SharedState<void>>(pool);
+    state->setValue(detail::Unit());
+    return Future<void>(state);
+}
+
+
+/**
+* @brief 所有Future都完成之后完成
+* @details 结果按输入的顺序排列 有任何一个抛出异常 结果就是第一个异常
+*          后续任务提交到第一个Future的线程池
+*/
+template <typename T>
+auto whenAll(std::vector<Future<T>> const& futures)
+{
+    using R = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+    ThreadPool* pool = futures.empty() ? nullptr : futures.front().getState()->getPool();
+    auto next = std::make_shared<detail::SharedState<R>>(pool);
+    if (futures.empty())
+    {
+        next->setValue(detail::StoredType<R>());
+        return Future<R>(next);
+    }
+
+    struct Context
+    {
+        explicit Context(std::vector<Future<T>> const& inputs) :
+            inputs_(inputs),
+            remaining_(inputs.size())
+        {}
+
+        std::vector<Future<T>> inputs_;
+        std::atomic<std::size_t> remaining_;
+    };
+
+    auto context = std::make_shared<Context>(futures);
+    for (auto const& future : futures)
+    {
+        future.getState()->onReady([context, next]() {
+            if (context->remaining_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            //最后一个完成的负责收集结果
+            for (auto const& input : context->inputs_)
+            {
+                if (input.getState()->getException())
+                {
+                    next->setException(input.getState()->getException());
+                    return;
+                }
+            }
+
+            detail::StoredType<R> results;
+            if constexpr (!std::is_void_v<T>)
+            {
+                results.reserve(context->inputs_.size());
+                for (auto const& input : context->inputs_)
+                    results.push_back(input.getState()->getValue());
+            }
+            next->setValue(std::move(results));
+        });
+    }
+
+    return Future<R>(next);
+}
+
+
+/**
+* @brief 任意一个Future完成之后完成
+* @return 第一个完成的Future的下标 不管它是正常返回还是抛出异常 输入为空的时候永远不会完成
+*/
+template <typename T>
+Future<std::size_t> whenAny(std::vector<Future<T>> const& futures)
+{
+    ThreadPool* pool = futures.empty() ? nullptr : futures.front().getState()->getPool();
+    auto next = std::make_shared<detail::SharedState<std::size_t>>(pool);
+    auto claimed = std::make_shared<std::atomic<bool>>(false);
+
+    for (std::size_t i = 0; i < futures.size(); ++i)
+    {
+        futures[i].getState()->onReady([claimed, next, i]() {
+            if (!claimed->exchange(true, std::memory_order_acq_rel))
+                next->setValue(std::size_t(i));
+        });
+    }
+
+    return Future<std::size_t>(next);
+}
+
+
+}
@@ -0,0 +1,431 @@
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define LOCKFREE_QUEUE_DEFAULT_CAPACITY 65536   //默认容量 向上取整到2的幂
+#define LOCKFREE_QUEUE_SPIN_COUNT 128           //取不到元素时先忙等的次数
+#define LOCKFREE_QUEUE_YIELD_COUNT 16           //忙等之后让出cpu的次数 之后才睡眠
+
+namespace THREADING
+{
+
+
+/**
+* @class LockFreeQueue
+* @brief 有界的无锁多生产者多消费者队列 接口与ProducerConsumerQueue一致
+* @details 基于数组的环 每个槽位带一个序号(Vyukov) 生产者和消费者各自用CAS抢位置 互相不阻塞
+*          get取不到元素的时候先忙等 再让出cpu 最后才在条件变量上睡眠
+*          只有存在睡眠的消费者时push才会加锁唤醒 没有人睡眠的时候push完全无锁
+*          队列满的时候push等待空位 tryPush直接返回false
+*/
+template <typename T>
+class LockFreeQueue
+{
+public:
+    using ptr = std::shared_ptr<LockFreeQueue>;
+public:
+    /**
+    * @brief 构造函数
+    * @param capacity 容量 向上取整到2的幂
+    */
+    explicit LockFreeQueue(std::size_t capacity = LOCKFREE_QUEUE_DEFAULT_CAPACITY) :
+        stop_(false),
+        sleepers_(0),
+        enqueuePos_(0),
+        dequeuePos_(0)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (std::size_t i = 0; i < size; ++i)
+            cells_[i].sequence_.store(i, std::memory_order_relaxed);
+    }
+
+    LockFreeQueue(LockFreeQueue const&) = delete;
+    LockFreeQueue& operator=(LockFreeQueue const&) = delete;
+
+    /**
+    * @brief 放入一个元素 队列满的时候等待空位
+    * @param v 元素
+    * @return 已经停止的时候返回false v保持不变 由调用者释放
+    */
+    bool push(T&& v)
+    {
+        while (!stop_.load(std::memory_order_relaxed))
+        {
+            if (tryPush(std::move(v)))
+                return true;
+
+            std::this_thread::yield();
+        }
+
+        return false;
+    }
+
+    /**
+    * @brief 放入一个元素 队列满的时候等待空位
+    * @param v 元素
+    * @return 已经停止的时候返回false
+    */
+    bool push(const T& v)
+    {
+        T copy(v);
+        return push(std::move(copy));
+    }
+
+    /**
+    * @brief 放入一批元素 和ProducerConsumerQueue接口一致
+    * @details 每个位置还是单独抢 只在最后检查一次是否需要唤醒
+    */
+    template <typename Iterator>
+    void push(Iterator first, Iterator last)
+    {
+        std::size_t count = 0;
+        for (; first != last && !stop_.load(std::memory_order_relaxed); ++first)
+        {
+            while (!tryPushNoWake(std::move(*first)))
+            {
+                if (stop_.load(std::memory_order_relaxed))
+                    return;
+
+                //队列满了 先唤醒消费者腾出空位
+                wakeAll();
+                std::this_thread::yield();
+            }
+            ++count;
+        }
+
+        if (count)
+            wakeAll();
+    }
+
+    /**
+    * @brief 尝试放入一个元素
+    * @return 队列满或者已经停止的时候返回false v保持不变
+    */
+    bool tryPush(T&& v)
+    {
+        if (!tryPushNoWake(std::move(v)))
+            return false;
+
+        wakeOne();
+        return true;
+    }
+
+    /**
+    * @brief 获取一个元素 队列为空的时候等待
+    * @param v 元素
+    * @return 是否成功获取 停止之后返回false
+    */
+    bool get(T& v)
+    {
+        for (;;)
+        {
+            for (uint32_t i = 0; i < LOCKFREE_QUEUE_SPIN_COUNT + LOCKFREE_QUEUE_YIELD_COUNT; ++i)
+            {
+                if (stop_.load(std::memory_order_relaxed))
+                    return false;
+
+                if (tryGet(v))
+                    return true;
+
+                if (i < LOCKFREE_QUEUE_SPIN_COUNT)
+                    cpuRelax();
+                else
+                    std::this_thread::yield();
+            }
+
+            park();
+        }
+    }
+
+    /**
+    * @brief 一次取出多个元素 队列为空的时候等待
+    * @param out 取出的元素追加到后面
+    * @param maxCount 最多取出的个数
+    * @return 取出的个数 停止之后返回0
+    */
+    std::size_t get(std::vector<T>& out, std::size_t maxCount)
+    {
+        T v;
+        if (!maxCount || !get(v))
+            return 0;
+
+        out.push_back(std::move(v));
+        std::size_t count = 1;
+        while (count < maxCount && tryGet(v))
+        {
+            out.push_back(std::move(v));
+            ++count;
+        }
+
+        return count;
+    }
+
+    /**
+    * @brief 获取一个元素 最多等待timeout
+    * @details 和get一样先忙等再让出cpu 之后在条件变量上睡到超时
+    * @return 超时或者已经停止的时候返回false 用isStopped区分
+    */
+    template <typename Rep, typename Period>
+    bool getFor(T& v, std::chrono::duration<Rep, Period> const& timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;)
+        {
+            for (uint32_t i = 0; i < LOCKFREE_QUEUE_SPIN_COUNT + LOCKFREE_QUEUE_YIELD_COUNT; ++i)
+            {
+                if (stop_.load(std::memory_order_relaxed))
+                    return false;
+
+                if (tryGet(v))
+                    return true;
+
+                if (i < LOCKFREE_QUEUE_SPIN_COUNT)
+                    cpuRelax();
+                else
+                    std::this_thread::yield();
+            }
+
+            if (!parkUntil(deadline))
+                return !stop_.load(std::memory_order_relaxed) && tryGet(v);
+        }
+    }
+
+    /**
+    * @brief 一次取出多个元素 队列为空的时候最多等待timeout
+    * @return 取出的个数 超时或者停止之后返回0
+    */
+    template <typename Rep, typename Period>
+    std::size_t getFor(std::vector<T>& out, std::size_t maxCount, std::chrono::duration<Rep, Period> const& timeout)
+    {
+        T v;
+        if (!maxCount || !getFor(v, timeout))
+            return 0;
+
+        out.push_back(std::move(v));
+        std::size_t count = 1;
+        while (count < maxCount && tryGet(v))
+        {
+            out.push_back(std::move(v));
+            ++count;
+        }
+
+        return count;
+    }
+
+    /**
+    * @brief 尝试获取一个元素 不等待
+    * @return 队列为空的时候返回false
+    */
+    bool tryGet(T& v)
+    {
+        Cell* cell;
+        std::size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            std::size_t seq = cell->sequence_.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+
+            if (diff == 0)
+            {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        v = std::move(cell->data_);
+        //槽位留给下一轮的生产者
+        cell->sequence_.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+    * @brief 获取队列大小 并发修改的时候只是近似值
+    * @return 队列大小
+    */
+    std::size_t size()
+    {
+        std::size_t dequeuePos = dequeuePos_.load(std::memory_order_relaxed);
+        std::size_t enqueuePos = enqueuePos_.load(std::memory_order_relaxed);
+        return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+    }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    //是否已经停止
+    bool isStopped() const { return stop_.load(std::memory_order_relaxed); }
+
+    /**
+    * @brief 停止队列 并清空任务
+    */
+    void stop()
+    {
+        stop_.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        clear();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        cond_.notify_all();
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence_;     //等于位置时可写 等于位置+1时可读
+        T data_;
+    };
+
+    bool tryPushNoWake(T&& v)
+    {
+        if (stop_.load(std::memory_order_relaxed))
+            return false;
+
+        Cell* cell;
+        std::size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            std::size_t seq = cell->sequence_.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos);
+
+            if (diff == 0)
+            {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                //这个槽位上一轮的元素还没有被取走 队列满了
+                return false;
+            }
+            else
+            {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data_ = std::move(v);
+        cell->sequence_.store(pos + 1, std::memory_order_release);
+
+        //和stop同时进行的时候 stop的清理可能没看到这个元素 放进去之后自己再清理一次
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (stop_.load(std::memory_order_relaxed))
+            clear();
+
+        return true;
+    }
+
+    //取出并丢弃所有元素 指针类型的元素在这里释放
+    void clear()
+    {
+        T v;
+        while (tryGet(v))
+        {
+            if constexpr (std::is_pointer_v<T>)
+            {
+                delete v;
+            }
+        }
+    }
+
+    bool isEmpty() const
+    {
+        std::size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        return cells_[pos & mask_].sequence_.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    //登记睡眠之后再检查一次 和wakeOne配合保证不会丢失唤醒
+    void park()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!stop_ && isEmpty())
+            cond_.wait(lock);
+        sleepers_.fetch_sub(1);
+    }
+
+    //和park一样 最多睡到deadline 超时返回false
+    bool parkUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool notified = true;
+        if (!stop_ && isEmpty())
+            notified = cond_.wait_until(lock, deadline) == std::cv_status::no_timeout;
+        sleepers_.fetch_sub(1);
+        return notified;
+    }
+
+    void wakeOne()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!sleepers_.load(std::memory_order_relaxed))
+            return;
+
+        //持有锁通知 消费者从检查队列到开始等待之间不会错过
+        std::lock_guard<std::mutex> lock(mutex_);
+        cond_.notify_one();
+    }
+
+    void wakeAll()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!sleepers_.load(std::memory_order_relaxed))
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        cond_.notify_all();
+    }
+
+    static void cpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+private:
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_;
+    std::atomic<bool> stop_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::atomic<uint32_t> sleepers_;    //在条件变量上睡眠的消费者数
+
+    //生产者和消费者的位置放在不同的缓存行
+    alignas(64) std::atomic<std::size_t> enqueuePos_;
+    alignas(64) std::atomic<std::size_t> dequeuePos_;
+};
+
+
+}
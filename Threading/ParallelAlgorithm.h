@@ -0,0 +1,175 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include "ThreadPool.h"
+
+#define PARALLEL_SPLIT_FACTOR 8         //自动选择粒度时每个线程分到的块数 多分几块让窃取可以平衡负载
+#define PARALLEL_SORT_MIN_GRAIN 2048    //排序的最小粒度 太小的时候合并的开销比排序还大
+
+namespace THREADING
+{
+
+
+namespace detail
+{
+
+//grain为0的时候按线程数自动选择
+inline std::size_t selectGrain(ThreadPool& pool, std::size_t count, std::size_t grain, std::size_t minGrain = 1)
+{
+    if (!grain)
+        grain = count / (pool.getThreadCount() * PARALLEL_SPLIT_FACTOR);
+
+    return std::max(grain, minGrain);
+}
+
+//当前线程抛出异常的时候 已经提交的任务还引用着栈上的变量 必须等它们结束再往外抛
+template <typename Func>
+void runThenWait(ThreadPool& pool, TaskGroup& group, Func&& func)
+{
+    try
+    {
+        func();
+    }
+    catch (...)
+    {
+        pool.waitUntil([&group]() { return !group.pending(); });
+        throw;
+    }
+
+    pool.wait(group);
+}
+
+//右半边交给线程池 左半边留在当前线程继续分 最后剩下的一块直接执行
+template <typename Index, typename RangeFunc>
+void splitRange(ThreadPool& pool, TaskGroup& group, Index begin, Index end, std::size_t grain, RangeFunc& func)
+{
+    while (std::size_t(end - begin) > grain)
+    {
+        Index mid = begin + (end - begin) / 2;
+        pool.spawn(group, [&pool, &group, mid, end, grain, &func]() {
+            splitRange(pool, group, mid, end, grain, func);
+        });
+        end = mid;
+    }
+
+    func(begin, end);
+}
+
+template <typename T, typename Index, typename RangeFunc, typename Reduce>
+T reduceRange(ThreadPool& pool, Index begin, Index end, std::size_t grain, T const& identity, RangeFunc& func, Reduce& reduce)
+{
+    if (std::size_t(end - begin) <= grain)
+        return func(begin, end, identity);
+
+    Index mid = begin + (end - begin) / 2;
+    T left = identity;
+    T right = identity;
+
+    TaskGroup group;
+    pool.spawn(group, [&]() { right = reduceRange(pool, mid, end, grain, identity, func, reduce); });
+    runThenWait(pool, group, [&]() { left = reduceRange(pool, begin, mid, grain, identity, func, reduce); });
+
+    //先左后右 结合的顺序固定 粒度相同的时候浮点数的结果也是确定的
+    return reduce(std::move(left), std::move(right));
+}
+
+template <typename Iterator, typename Compare>
+void sortRange(ThreadPool& pool, Iterator first, Iterator last, std::size_t grain, Compare& comp)
+{
+    if (std::size_t(last - first) <= grain)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    Iterator mid = first + (last - first) / 2;
+
+    TaskGroup group;
+    pool.spawn(group, [&]() { sortRange(pool, mid, last, grain, comp); });
+    runThenWait(pool, group, [&]() { sortRange(pool, first, mid, grain, comp); });
+
+    std::inplace_merge(first, mid, last, comp);
+}
+
+}// namespace detail
+
+
+/**
+* @brief 把[begin, end)分成小块在线程池里执行func(blockBegin, blockEnd)
+* @details 区间不断对半分 右半边提交给线程池 调用线程自己执行最左边的一块 然后在wait里帮忙执行其他块
+*          空闲的工作线程会把还没有分开的大块偷走继续分 所以负载不均匀的时候也能平衡
+*          func抛出的第一个异常在这里重新抛出
+* @param grain 每块最多多少个元素 0表示按线程数自动选择
+*/
+template <typename Index, typename RangeFunc>
+void parallelForRange(ThreadPool& pool, Index begin, Index end, RangeFunc&& func, std::size_t grain = 0)
+{
+    if (!(begin < end))
+        return;
+
+    grain = detail::selectGrain(pool, std::size_t(end - begin), grain);
+
+    TaskGroup group;
+    detail::runThenWait(pool, group, [&]() { detail::splitRange(pool, group, begin, end, grain, func); });
+}
+
+
+/**
+* @brief 对[begin, end)里的每个下标并行执行func(i)
+* @param grain 每块最多多少个下标 0表示按线程数自动选择
+*/
+template <typename Index, typename Func>
+void parallelFor(ThreadPool& pool, Index begin, Index end, Func&& func, std::size_t grain = 0)
+{
+    parallelForRange(pool, begin, end, [&func](Index blockBegin, Index blockEnd) {
+        for (Index i = blockBegin; i != blockEnd; ++i)
+            func(i);
+    }, grain);
+}
+
+
+/**
+* @brief 并行归约
+* @details 每一块调用func(blockBegin, blockEnd, identity)得到这一块的结果 再用reduce两两合并
+*          reduce需要满足结合律 identity是reduce的单位元
+* @param grain 每块最多多少个下标 0表示按线程数自动选择
+* @return 整个区间的结果 区间为空的时候返回identity
+*/
+template <typename T, typename Index, typename RangeFunc, typename Reduce>
+T parallelReduce(ThreadPool& pool, Index begin, Index end, T identity, RangeFunc&& func, Reduce&& reduce, std::size_t grain = 0)
+{
+    if (!(begin < end))
+        return identity;
+
+    grain = detail::selectGrain(pool, std::size_t(end - begin), grain);
+    return detail::reduceRange(pool, begin, end, grain, identity, func, reduce);
+}
+
+
+/**
+* @brief 并行排序 不稳定
+* @details 每一块用std::sort排序 然后逐层用std::inplace_merge合并 需要随机访问迭代器
+* @param grain 每块最多多少个元素 0表示按线程数自动选择 不会小于PARALLEL_SORT_MIN_GRAIN
+*/
+template <typename Iterator, typename Compare = std::less<>>
+void parallelSort(ThreadPool& pool, Iterator first, Iterator last, Compare comp = Compare(), std::size_t grain = 0)
+{
+    static_assert(std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>,
+        "parallelSort requires random access iterators");
+
+    std::size_t count = std::size_t(last - first);
+    if (count < 2)
+        return;
+
+    grain = detail::selectGrain(pool, count, grain, PARALLEL_SORT_MIN_GRAIN);
+    detail::sortRange(pool, first, last, grain, comp);
+}
+
+
+}
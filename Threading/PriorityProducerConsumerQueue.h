@@ -0,0 +1,391 @@
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include "ProfiledMutex.h"
+
+#define PRIORITY_QUEUE_AGED_PICK_INTERVAL 4     //两次老化插队之间至少按优先级正常取出多少个元素
+
+namespace THREADING
+{
+
+
+/**
+* @class PriorityProducerConsumerQueue
+* @brief 带优先级的生产者消费者队列 接口与ProducerConsumerQueue一致
+* @details 每个优先级一个FIFO 元素的优先级由PriorityOf(v)决定 0最高 push的接口不变
+*          get总是先取高优先级的元素 但是低优先级队首等待超过该级别的老化时间之后 优先取出等得最久的那个
+*          所以持续的高优先级流量也不会让低优先级的元素饿死
+*          老化插队有配额 两次插队之间至少按优先级正常取出agedPickInterval个 积压的时候高优先级不会被完全反转
+*          每个优先级的队列长度 通过老化取出的次数可以随时读取 不加锁
+*/
+template <typename T, typename PriorityOf, std::size_t Classes>
+class PriorityProducerConsumerQueue
+{
+public:
+    using ptr = std::shared_ptr<PriorityProducerConsumerQueue>;
+    using clock = std::chrono::steady_clock;
+
+public:
+    /**
+    * @brief 构造函数
+    * @details 默认不老化 需要用setAgingThreshold设置
+    */
+    PriorityProducerConsumerQueue() :
+        stop_(false),
+        size_(0),
+        agedPickInterval_(PRIORITY_QUEUE_AGED_PICK_INTERVAL),
+        picksSinceAged_(PRIORITY_QUEUE_AGED_PICK_INTERVAL)
+    {
+        nameMutex(mutex_, "PriorityProducerConsumerQueue");
+        agingThresholds_.fill(clock::duration::max());
+        for (std::size_t i = 0; i < Classes; ++i)
+        {
+            depth_[i] = 0;
+            agedCount_[i] = 0;
+        }
+    }
+
+    /**
+    * @brief 设置某个优先级的老化时间 队首等待超过该时间之后优先取出
+    * @param priority 优先级
+    * @param threshold 老化时间 clock::duration::max()表示不老化
+    */
+    void setAgingThreshold(std::size_t priority, clock::duration threshold)
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+        agingThresholds_[std::min(priority, Classes - 1)] = threshold;
+    }
+
+    /**
+    * @brief 设置老化插队的配额
+    * @param interval 两次插队之间至少按优先级正常取出多少个元素 0表示不限制
+    */
+    void setAgedPickInterval(std::size_t interval)
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+        agedPickInterval_ = interval;
+        picksSinceAged_ = interval;
+    }
+
+    /**
+    * @brief 放入一个元素
+    * @param v 元素
+    * @return 已经停止的时候返回false v保持不变 由调用者释放
+    */
+    bool push(T&& v)
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+        if (stop_)
+        {
+            return false;
+        }
+
+        enqueue(std::move(v), clock::now());
+        cond_.notify_one();
+        return true;
+    }
+
+    /**
+    * @brief 放入一个元素
+    * @param v 元素
+    * @return 已经停止的时候返回false
+    */
+    bool push(const T& v)
+    {
+        T copy(v);
+        return push(std::move(copy));
+    }
+
+    /**
+    * @brief 一次放入一批元素 只加一次锁 只唤醒一次
+    * @param first 第一个元素
+    * @param last 最后一个元素的下一个
+    */
+    template <typename Iterator>
+    void push(Iterator first, Iterator last)
+    {
+        std::size_t count = 0;
+        {
+            std::lock_guard<Mutex> lock(mutex_);
+            if (stop_)
+            {
+                return;
+            }
+
+            clock::time_point now = clock::now();
+            for (; first != last; ++first, ++count)
+            {
+                enqueue(std::move(*first), now);
+            }
+        }
+
+        if (count == 1)
+        {
+            cond_.notify_one();
+        }
+        else if (count > 1)
+        {
+            cond_.notify_all();
+        }
+    }
+
+    /**
+    * @brief 获取一个元素 先取高优先级的 老化的低优先级元素插队
+    * @param v 元素
+    * @return 是否成功获取
+    */
+    bool get(T& v)
+    {
+        std::unique_lock<Mutex> lock(mutex_);
+
+        while (!size_ && !stop_)
+        {
+            cond_.wait(lock);
+        }
+
+        if (!size_ || stop_)
+        {
+            return false;
+        }
+
+        v = dequeue(clock::now());
+        return true;
+    }
+
+    /**
+    * @brief 一次取出多个元素 队列为空的时候等待
+    * @param out 取出的元素追加到后面
+    * @param maxCount 最多取出的个数
+    * @return 取出的个数 停止之后返回0
+    */
+    std::size_t get(std::vector<T>& out, std::size_t maxCount)
+    {
+        std::unique_lock<Mutex> lock(mutex_);
+
+        while (!size_ && !stop_)
+        {
+            cond_.wait(lock);
+        }
+
+        if (!size_ || stop_)
+        {
+            return 0;
+        }
+
+        clock::time_point now = clock::now();
+        std::size_t count = std::min(maxCount, size_);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out.push_back(dequeue(now));
+        }
+
+        return count;
+    }
+
+    /**
+    * @brief 尝试获取一个元素 不等待
+    * @return 队列为空或者已经停止的时候返回false
+    */
+    bool tryGet(T& v)
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+
+        if (!size_ || stop_)
+        {
+            return false;
+        }
+
+        v = dequeue(clock::now());
+        return true;
+    }
+
+    /**
+    * @brief 获取一个元素 最多等待timeout
+    * @return 超时或者已经停止的时候返回false 用isStopped区分
+    */
+    template <typename Rep, typename Period>
+    bool getFor(T& v, std::chrono::duration<Rep, Period> const& timeout)
+    {
+        std::unique_lock<Mutex> lock(mutex_);
+
+        if (!cond_.wait_for(lock, timeout, [this]() { return size_ || stop_; }) || stop_)
+        {
+            return false;
+        }
+
+        v = dequeue(clock::now());
+        return true;
+    }
+
+    /**
+    * @brief 一次取出多个元素 队列为空的时候最多等待timeout
+    * @return 取出的个数 超时或者停止之后返回0
+    */
+    template <typename Rep, typename Period>
+    std::size_t getFor(std::vector<T>& out, std::size_t maxCount, std::chrono::duration<Rep, Period> const& timeout)
+    {
+        std::unique_lock<Mutex> lock(mutex_);
+
+        if (!cond_.wait_for(lock, timeout, [this]() { return size_ || stop_; }) || stop_)
+        {
+            return 0;
+        }
+
+        clock::time_point now = clock::now();
+        std::size_t count = std::min(maxCount, size_);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out.push_back(dequeue(now));
+        }
+
+        return count;
+    }
+
+    /**
+    * @brief 获取队列大小
+    * @return 队列大小
+    */
+    std::size_t size()
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+        return size_;
+    }
+
+    //是否已经停止
+    bool isStopped()
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+        return stop_;
+    }
+
+    //某个优先级排队的元素个数 不加锁
+    std::size_t size(std::size_t priority) const
+    {
+        return depth_[std::min(priority, Classes - 1)].load(std::memory_order_relaxed);
+    }
+
+    //某个优先级因为老化被提前取出的次数 不加锁
+    uint64_t getAgedCount(std::size_t priority) const
+    {
+        return agedCount_[std::min(priority, Classes - 1)].load(std::memory_order_relaxed);
+    }
+
+    /**
+    * @brief 停止队列 并清空任务
+    */
+    void stop()
+    {
+        {
+            std::lock_guard<Mutex> lock(mutex_);
+            stop_ = true;
+
+            for (std::size_t i = 0; i < Classes; ++i)
+            {
+                for (Entry& entry : queues_[i])
+                {
+                    if constexpr (std::is_pointer_v<T>)
+                    {
+                        delete entry.value_;
+                    }
+                }
+
+                queues_[i].clear();
+                depth_[i] = 0;
+            }
+            size_ = 0;
+        }
+
+        cond_.notify_all();
+    }
+
+private:
+    struct Entry
+    {
+        T value_;
+        clock::time_point enqueueTime_;
+    };
+
+    //已经持有mutex_
+    void enqueue(T&& v, clock::time_point now)
+    {
+        std::size_t priority = std::min<std::size_t>(PriorityOf()(v), Classes - 1);
+        queues_[priority].push_back(Entry{ std::move(v), now });
+        depth_[priority].fetch_add(1, std::memory_order_relaxed);
+        ++size_;
+    }
+
+    //已经持有mutex_ 并且队列不为空
+    T dequeue(clock::time_point now)
+    {
+        std::size_t highest = 0;
+        while (queues_[highest].empty())
+        {
+            ++highest;
+        }
+
+        //比最高非空级别低的级别里 找超过老化时间并且等得最久的 插队的配额用完之前不找
+        std::size_t chosen = highest;
+        std::size_t first = picksSinceAged_ >= agedPickInterval_ ? highest + 1 : Classes;
+        for (std::size_t i = first; i < Classes; ++i)
+        {
+            if (queues_[i].empty() || agingThresholds_[i] == clock::duration::max())
+            {
+                continue;
+            }
+
+            clock::time_point enqueueTime = queues_[i].front().enqueueTime_;
+            if (now - enqueueTime < agingThresholds_[i])
+            {
+                continue;
+            }
+
+            if (chosen == highest || enqueueTime < queues_[chosen].front().enqueueTime_)
+            {
+                chosen = i;
+            }
+        }
+
+        if (chosen != highest)
+        {
+            agedCount_[chosen].fetch_add(1, std::memory_order_relaxed);
+            picksSinceAged_ = 0;
+        }
+        else if (picksSinceAged_ < agedPickInterval_)
+        {
+            ++picksSinceAged_;
+        }
+
+        T v = std::move(queues_[chosen].front().value_);
+        queues_[chosen].pop_front();
+        depth_[chosen].fetch_sub(1, std::memory_order_relaxed);
+        --size_;
+        return v;
+    }
+
+private:
+    Mutex mutex_;
+    ConditionVariable cond_;
+    std::array<std::deque<Entry>, Classes> queues_;     //每个优先级一个FIFO
+    std::array<clock::duration, Classes> agingThresholds_;
+    std::array<std::atomic<std::size_t>, Classes> depth_;
+    std::array<std::atomic<uint64_t>, Classes> agedCount_;
+    bool stop_;
+    std::size_t size_;  //所有优先级的元素总数
+    std::size_t agedPickInterval_;  //两次老化插队之间至少正常取出的个数
+    std::size_t picksSinceAged_;    //上一次老化插队之后正常取出的个数
+};
+
+
+}
@@ -2,11 +2,14 @@
 
 
 #include <algorithm>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <type_traits>
+#include <vector>
+#include "ProfiledMutex.h"
 
 namespace THREADING 
 {
@@ -26,34 +29,76 @@ public:
     * @brief 构造函数
     */
     ProducerConsumerQueue() : stop_(false)
-    {}
+    {
+        nameMutex(mutex_, "ProducerConsumerQueue");
+    }
 
     /**
     * @brief 放入一个元素
     * @param v 元素
+    * @return 已经停止的时候返回false v保持不变 由调用者释放
     */
-    void push(T&& v)
+    bool push(T&& v)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (!stop_) 
+        std::lock_guard<Mutex> lock(mutex_);
+        if (stop_) 
         {
-            queue_.push(std::move(v));
-            cond_.notify_one();
+            return false;
         }
+
+        queue_.push(std::move(v));
+        cond_.notify_one();
+        return true;
     }
 
     /**
     * @brief 放入一个元素
     * @param v 元素
+    * @return 已经停止的时候返回false
+    */
+    bool push(const T& v)
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+        if (stop_) 
+        {
+            return false;
+        }
+
+        queue_.push(v);
+        cond_.notify_one();
+        return true;
+    }
+
+    /**
+    * @brief 一次放入一批元素 只加一次锁 只唤醒一次
+    * @param first 第一个元素
+    * @param last 最后一个元素的下一个
     */
-    void push(const T& v)
+    template <typename Iterator>
+    void push(Iterator first, Iterator last)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (!stop_) 
+        std::size_t count = 0;
+        {
+            std::lock_guard<Mutex> lock(mutex_);
+            if (stop_)
+            {
+                return;
+            }
+
+            for (; first != last; ++first, ++count)
+            {
+                queue_.push(std::move(*first));
+            }
+        }
+
+        if (count == 1)
         {
-            queue_.push(v);
             cond_.notify_one();
         }
+        else if (count > 1)
+        {
+            cond_.notify_all();
+        }
     }
 
     /**
@@ -64,7 +109,33 @@ public:
 
     bool get(T& v)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
+        std::unique_lock<Mutex> lock(mutex_);
+
+        while (queue_.empty() && !stop_) 
+        {
+            cond_.wait(lock);
+        }
+
+        if (queue_.empty() || stop_) 
+        {
+            return false;
+        }
+
+        v = std::move(queue_.front());
+        queue_.pop();
+
+        return true;
+    }
+
+    /**
+    * @brief 一次取出多个元素 队列为空的时候等待
+    * @param out 取出的元素追加到后面
+    * @param maxCount 最多取出的个数
+    * @return 取出的个数 停止之后返回0
+    */
+    std::size_t get(std::vector<T>& out, std::size_t maxCount)
+    {
+        std::unique_lock<Mutex> lock(mutex_);
 
         while (queue_.empty() && !stop_) 
         {
@@ -72,6 +143,49 @@ public:
         }
 
         if (queue_.empty() || stop_) 
+        {
+            return 0;
+        }
+
+        std::size_t count = std::min(maxCount, queue_.size());
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out.push_back(std::move(queue_.front()));
+            queue_.pop();
+        }
+
+        return count;
+    }
+
+    /**
+    * @brief 尝试获取一个元素 不等待
+    * @return 队列为空或者已经停止的时候返回false
+    */
+    bool tryGet(T& v)
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+
+        if (queue_.empty() || stop_) 
+        {
+            return false;
+        }
+
+        v = std::move(queue_.front());
+        queue_.pop();
+
+        return true;
+    }
+
+    /**
+    * @brief 获取一个元素 最多等待timeout
+    * @return 超时或者已经停止的时候返回false 用isStopped区分
+    */
+    template <typename Rep, typename Period>
+    bool getFor(T& v, std::chrono::duration<Rep, Period> const& timeout)
+    {
+        std::unique_lock<Mutex> lock(mutex_);
+
+        if (!cond_.wait_for(lock, timeout, [this]() { return !queue_.empty() || stop_; }) || stop_) 
         {
             return false;
         }
@@ -82,23 +196,54 @@ public:
         return true;
     }
 
+    /**
+    * @brief 一次取出多个元素 队列为空的时候最多等待timeout
+    * @return 取出的个数 超时或者停止之后返回0
+    */
+    template <typename Rep, typename Period>
+    std::size_t getFor(std::vector<T>& out, std::size_t maxCount, std::chrono::duration<Rep, Period> const& timeout)
+    {
+        std::unique_lock<Mutex> lock(mutex_);
+
+        if (!cond_.wait_for(lock, timeout, [this]() { return !queue_.empty() || stop_; }) || stop_) 
+        {
+            return 0;
+        }
+
+        std::size_t count = std::min(maxCount, queue_.size());
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out.push_back(std::move(queue_.front()));
+            queue_.pop();
+        }
+
+        return count;
+    }
+
     /**
     * @brief 获取队列大小
     * @return 队列大小
     */
     std::size_t size()
     {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<Mutex> lock(mutex_);
         return queue_.size();
     }
 
+    //是否已经停止
+    bool isStopped()
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+        return stop_;
+    }
+
     /**
     * @brief 停止队列 并清空任务
     */
     void stop()
     {
         {
-            std::lock_guard<std::mutex> lock(mutex_);
+            std::lock_guard<Mutex> lock(mutex_);
             stop_ = true;
 
             while (!queue_.empty()) 
@@ -119,8 +264,8 @@ public:
 private:
 
 private:
-    std::mutex mutex_;
-    std::condition_variable cond_;
+    Mutex mutex_;
+    ConditionVariable cond_;
     std::queue<T> queue_;
     bool stop_;
 }; 
@@ -0,0 +1,283 @@
+#pragma once
+
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#define LOCK_PROFILE_BUCKETS 40     //直方图按2的幂分桶 第i个桶是[2^i, 2^(i+1))纳秒
+
+/**
+* @file ProfiledMutex.h
+* @brief 统计锁竞争的互斥锁
+* @details 定义ENABLE_LOCK_PROFILING之后THREADING::Mutex是ProfiledMutex 否则就是std::mutex 没有任何额外开销
+*          需要统计的类用THREADING::Mutex和THREADING::ConditionVariable代替std::mutex和std::condition_variable
+*          在构造函数里用nameMutex给锁起名字 同名的锁(比如所有ProducerConsumerQueue)统计合并在一起
+*          LockProfiler::getInstance()->dump(std::cout)输出每个锁的获取次数 竞争次数 等待时间和持有时间分布
+*/
+
+namespace THREADING
+{
+
+
+/**
+* @class LockStats
+* @brief 一个名字的锁的统计 所有字段都是原子的 不需要额外加锁
+*/
+class LockStats
+{
+public:
+    explicit LockStats(std::string name) :
+        name_(std::move(name)),
+        acquisitions_(0),
+        contended_(0),
+        waitNs_(0),
+        holdNs_(0)
+    {
+        for (std::size_t i = 0; i < LOCK_PROFILE_BUCKETS; ++i)
+        {
+            waitHistogram_[i] = 0;
+            holdHistogram_[i] = 0;
+        }
+    }
+
+    uint64_t getAcquisitions() const { return acquisitions_.load(std::memory_order_relaxed); }
+    uint64_t getContended() const { return contended_.load(std::memory_order_relaxed); }
+
+    void recordAcquire(bool contended, uint64_t waitNs)
+    {
+        acquisitions_.fetch_add(1, std::memory_order_relaxed);
+        if (!contended)
+            return;
+
+        contended_.fetch_add(1, std::memory_order_relaxed);
+        waitNs_.fetch_add(waitNs, std::memory_order_relaxed);
+        waitHistogram_[bucket(waitNs)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void recordHold(uint64_t holdNs)
+    {
+        holdNs_.fetch_add(holdNs, std::memory_order_relaxed);
+        holdHistogram_[bucket(holdNs)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        acquisitions_ = 0;
+        contended_ = 0;
+        waitNs_ = 0;
+        holdNs_ = 0;
+        for (std::size_t i = 0; i < LOCK_PROFILE_BUCKETS; ++i)
+        {
+            waitHistogram_[i] = 0;
+            holdHistogram_[i] = 0;
+        }
+    }
+
+    /**
+    * @brief 输出一行统计 和两行直方图的分位数
+    */
+    void dump(std::ostream& out) const
+    {
+        uint64_t acquisitions = acquisitions_.load(std::memory_order_relaxed);
+        uint64_t contended = contended_.load(std::memory_order_relaxed);
+        uint64_t waitNs = waitNs_.load(std::memory_order_relaxed);
+        uint64_t holdNs = holdNs_.load(std::memory_order_relaxed);
+
+        out << std::left << std::setw(32) << name_ << std::right
+            << " acquire " << acquisitions
+            << " contended " << contended
+            << " (" << std::fixed << std::setprecision(2) << (acquisitions ? 100.0 * contended / acquisitions : 0.0) << "%)"
+            << " wait " << waitNs / 1000 << "us"
+            << " avgWait " << (contended ? waitNs / contended : 0) << "ns"
+            << " avgHold " << (acquisitions ? holdNs / acquisitions : 0) << "ns\n";
+
+        out << "    wait(contended) p50<" << percentile(waitHistogram_, 0.5) << "ns p99<" << percentile(waitHistogram_, 0.99)
+            << "ns max<" << percentile(waitHistogram_, 1.0) << "ns\n";
+        out << "    hold            p50<" << percentile(holdHistogram_, 0.5) << "ns p99<" << percentile(holdHistogram_, 0.99)
+            << "ns max<" << percentile(holdHistogram_, 1.0) << "ns\n";
+    }
+
+private:
+    using Histogram = std::array<std::atomic<uint64_t>, LOCK_PROFILE_BUCKETS>;
+
+    static std::size_t bucket(uint64_t ns)
+    {
+        std::size_t index = ns ? 63 - __builtin_clzll(ns) : 0;
+        return index < LOCK_PROFILE_BUCKETS ? index : LOCK_PROFILE_BUCKETS - 1;
+    }
+
+    //返回分位数所在桶的上界
+    static uint64_t percentile(Histogram const& histogram, double p)
+    {
+        uint64_t total = 0;
+        for (auto const& count : histogram)
+            total += count.load(std::memory_order_relaxed);
+
+        if (!total)
+            return 0;
+
+        uint64_t target = uint64_t(p * total);
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < LOCK_PROFILE_BUCKETS; ++i)
+        {
+            seen += histogram[i].load(std::memory_order_relaxed);
+            if (seen && seen >= target)
+                return uint64_t(1) << (i + 1);
+        }
+
+        return uint64_t(1) << LOCK_PROFILE_BUCKETS;
+    }
+
+private:
+    std::string name_;
+    std::atomic<uint64_t> acquisitions_;    //获取次数
+    std::atomic<uint64_t> contended_;       //第一次try_lock失败 需要等待的次数
+    std::atomic<uint64_t> waitNs_;          //等待的总时间
+    std::atomic<uint64_t> holdNs_;          //持有的总时间
+    Histogram waitHistogram_;
+    Histogram holdHistogram_;
+};
+
+
+/**
+* @class LockProfiler
+* @brief 按名字保存所有锁的统计
+*/
+class LockProfiler
+{
+public:
+    static LockProfiler* getInstance()
+    {
+        static LockProfiler instance;
+        return &instance;
+    }
+
+    //同名的锁共用一份统计 统计对象一直保留到进程退出
+    LockStats* getStats(std::string const& name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& stats = stats_[name];
+        if (!stats)
+            stats = std::make_unique<LockStats>(name);
+        return stats.get();
+    }
+
+    void dump(std::ostream& out)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto const& [name, stats] : stats_)
+        {
+            if (stats->getAcquisitions())
+                stats->dump(out);
+        }
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto const& [name, stats] : stats_)
+            stats->reset();
+    }
+
+private:
+    LockProfiler() = default;
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<LockStats>> stats_;
+};
+
+
+/**
+* @class ProfiledMutex
+* @brief 接口和std::mutex一样 记录获取次数 竞争 等待时间和持有时间
+* @details 先try_lock 成功就是没有竞争 不计等待时间 失败才计时等待
+*          持有时间从拿到锁开始 到unlock为止 和condition_variable_any一起用的时候wait期间不算持有
+*/
+class ProfiledMutex
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+public:
+    explicit ProfiledMutex(std::string const& name = "unnamed") :
+        stats_(LockProfiler::getInstance()->getStats(name))
+    {}
+
+    ProfiledMutex(ProfiledMutex const&) = delete;
+    ProfiledMutex& operator=(ProfiledMutex const&) = delete;
+
+    void setName(std::string const& name)
+    {
+        stats_ = LockProfiler::getInstance()->getStats(name);
+    }
+
+    void lock()
+    {
+        if (mutex_.try_lock())
+        {
+            stats_->recordAcquire(false, 0);
+        }
+        else
+        {
+            clock::time_point begin = clock::now();
+            mutex_.lock();
+            stats_->recordAcquire(true, nanoseconds(clock::now() - begin));
+        }
+
+        lockedAt_ = clock::now();
+    }
+
+    bool try_lock()
+    {
+        if (!mutex_.try_lock())
+            return false;
+
+        stats_->recordAcquire(false, 0);
+        lockedAt_ = clock::now();
+        return true;
+    }
+
+    void unlock()
+    {
+        //只有持有锁的线程写lockedAt_ 在解锁之前读出来
+        stats_->recordHold(nanoseconds(clock::now() - lockedAt_));
+        mutex_.unlock();
+    }
+
+private:
+    static uint64_t nanoseconds(clock::duration d)
+    {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    }
+
+private:
+    std::mutex mutex_;
+    LockStats* stats_;
+    clock::time_point lockedAt_;
+};
+
+
+#ifdef ENABLE_LOCK_PROFILING
+using Mutex = ProfiledMutex;
+using ConditionVariable = std::condition_variable_any;
+#else
+using Mutex = std::mutex;
+using ConditionVariable = std::condition_variable;
+#endif
+
+//给锁起名字 没有打开统计的时候什么都不做
+inline void nameMutex(std::mutex& /*mutex*/, char const* /*name*/) {}
+inline void nameMutex(ProfiledMutex& mutex, char const* name) { mutex.setName(name); }
+
+
+}
@@ -0,0 +1,337 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define SPSC_QUEUE_DEFAULT_CAPACITY 4096    //默认容量 向上取整到2的幂
+#define SPSC_QUEUE_SPIN_COUNT 256           //get取不到元素时先忙等的次数 之后让出cpu或者等eventfd
+
+namespace THREADING
+{
+
+
+/**
+* @class SpscQueue
+* @brief 单生产者单消费者的环形队列
+* @details 只能有一个线程push 一个线程get 两边都不加锁 不用CAS
+*          读写位置放在不同的缓存行 每边缓存对方的位置 只有缓存的值显示满/空的时候才去读对方的缓存行
+*          可以打开eventfd 消费者取空之后arm 生产者下一次放入的时候写eventfd
+*          eventfd可以注册到io_context(stream_descriptor) 或者epoll 消费者不需要忙等
+*/
+template <typename T>
+class SpscQueue
+{
+public:
+    using ptr = std::shared_ptr<SpscQueue>;
+
+public:
+    /**
+    * @brief 构造函数
+    * @param capacity 容量 向上取整到2的幂
+    * @param useEventFd 是否创建eventfd通知消费者
+    */
+    explicit SpscQueue(std::size_t capacity = SPSC_QUEUE_DEFAULT_CAPACITY, bool useEventFd = false) :
+        eventFd_(-1),
+        stop_(false),
+        armed_(false),
+        tail_(0),
+        cachedHead_(0),
+        head_(0),
+        cachedTail_(0)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        mask_ = size - 1;
+        slots_.reset(new T[size]);
+
+        if (useEventFd)
+            eventFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    ~SpscQueue()
+    {
+        if constexpr (std::is_pointer_v<T>)
+        {
+            T v;
+            while (tryGet(v))
+                delete v;
+        }
+
+        if (eventFd_ >= 0)
+            ::close(eventFd_);
+    }
+
+    SpscQueue(SpscQueue const&) = delete;
+    SpscQueue& operator=(SpscQueue const&) = delete;
+
+    /**
+    * @brief 尝试放入一个元素 只能在生产者线程调用
+    * @return 队列满或者已经停止的时候返回false v保持不变
+    */
+    bool tryPush(T&& v)
+    {
+        if (stop_.load(std::memory_order_relaxed))
+            return false;
+
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ > mask_)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ > mask_)
+                return false;
+        }
+
+        slots_[tail & mask_] = std::move(v);
+        tail_.store(tail + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    /**
+    * @brief 放入一个元素 队列满的时候等待空位
+    */
+    void push(T&& v)
+    {
+        while (!tryPush(std::move(v)))
+        {
+            if (stop_.load(std::memory_order_relaxed))
+                return;
+
+            std::this_thread::yield();
+        }
+    }
+
+    void push(const T& v)
+    {
+        T copy(v);
+        push(std::move(copy));
+    }
+
+    /**
+    * @brief 放入尽可能多的元素 只发布一次写位置 只通知一次
+    * @return 放入的个数 队列满的时候可能小于last - first
+    */
+    template <typename Iterator>
+    std::size_t tryPush(Iterator first, Iterator last)
+    {
+        if (stop_.load(std::memory_order_relaxed))
+            return 0;
+
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        std::size_t count = std::size_t(std::distance(first, last));
+        std::size_t space = mask_ + 1 - (tail - cachedHead_);
+        if (space < count)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            space = mask_ + 1 - (tail - cachedHead_);
+        }
+
+        count = std::min(count, space);
+        for (std::size_t i = 0; i < count; ++i, ++first)
+            slots_[(tail + i) & mask_] = std::move(*first);
+
+        if (count)
+        {
+            tail_.store(tail + count, std::memory_order_release);
+            signal();
+        }
+
+        return count;
+    }
+
+    /**
+    * @brief 放入全部元素 队列满的时候等待空位
+    */
+    template <typename Iterator>
+    void push(Iterator first, Iterator last)
+    {
+        while (first != last && !stop_.load(std::memory_order_relaxed))
+        {
+            std::size_t count = tryPush(first, last);
+            std::advance(first, count);
+
+            if (!count)
+                std::this_thread::yield();
+        }
+    }
+
+    /**
+    * @brief 尝试取出一个元素 只能在消费者线程调用
+    * @return 队列为空的时候返回false
+    */
+    bool tryGet(T& v)
+    {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+                return false;
+        }
+
+        v = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+    * @brief 一次取出最多maxCount个元素 不等待 只发布一次读位置
+    * @param out 取出的元素追加到后面
+    * @return 取出的个数
+    */
+    std::size_t tryGet(std::vector<T>& out, std::size_t maxCount)
+    {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (cachedTail_ - head < maxCount)
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+
+        std::size_t count = std::min(maxCount, cachedTail_ - head);
+        for (std::size_t i = 0; i < count; ++i)
+            out.push_back(std::move(slots_[(head + i) & mask_]));
+
+        if (count)
+            head_.store(head + count, std::memory_order_release);
+
+        return count;
+    }
+
+    /**
+    * @brief 获取一个元素 队列为空的时候等待
+    * @details 先忙等 之后没有eventfd的时候让出cpu 有eventfd的时候arm之后在eventfd上睡眠
+    * @return 是否成功获取 停止之后返回false
+    */
+    bool get(T& v)
+    {
+        uint32_t idle = 0;
+        while (!stop_.load(std::memory_order_relaxed))
+        {
+            if (tryGet(v))
+                return true;
+
+            if (++idle < SPSC_QUEUE_SPIN_COUNT)
+                continue;
+
+            if (eventFd_ < 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (arm())
+            {
+                pollfd pfd{ eventFd_, POLLIN, 0 };
+                ::poll(&pfd, 1, -1);
+                clearEvent();
+            }
+            idle = 0;
+        }
+
+        return false;
+    }
+
+    /**
+    * @brief 消费者取空之后调用 之后的第一次push会写eventfd
+    * @return 队列又有元素或者已经停止的时候返回false 这时不要等待 直接继续取
+    */
+    bool arm()
+    {
+        armed_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!empty() || stop_.load(std::memory_order_relaxed))
+        {
+            armed_.store(false, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+    * @brief eventfd可读之后由消费者调用 清除计数
+    */
+    void clearEvent()
+    {
+        uint64_t value;
+        while (::read(eventFd_, &value, sizeof(value)) < 0 && errno == EINTR)
+        {}
+    }
+
+    //eventfd 没有打开的时候返回-1 由消费者注册到io_context或者epoll
+    int getEventFd() const { return eventFd_; }
+
+    //近似的元素个数
+    std::size_t size() const
+    {
+        std::size_t head = head_.load(std::memory_order_acquire);
+        std::size_t tail = tail_.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    /**
+    * @brief 停止队列 叫醒在eventfd上等待的消费者 队列里剩下的指针在析构时释放
+    */
+    void stop()
+    {
+        stop_ = true;
+        if (eventFd_ >= 0)
+            writeEvent();
+    }
+
+    bool isStopped() const { return stop_.load(std::memory_order_relaxed); }
+
+private:
+    //生产者发布之后 消费者arm过才写eventfd 大多数push不需要系统调用
+    void signal()
+    {
+        if (eventFd_ < 0)
+            return;
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (armed_.load(std::memory_order_relaxed) && armed_.exchange(false, std::memory_order_relaxed))
+            writeEvent();
+    }
+
+    void writeEvent()
+    {
+        uint64_t value = 1;
+        while (::write(eventFd_, &value, sizeof(value)) < 0 && errno == EINTR)
+        {}
+    }
+
+private:
+    std::unique_ptr<T[]> slots_;
+    std::size_t mask_;
+    int eventFd_;
+    std::atomic<bool> stop_;
+    std::atomic<bool> armed_;   //消费者在等eventfd
+
+    //生产者的缓存行
+    alignas(64) std::atomic<std::size_t> tail_;
+    std::size_t cachedHead_;    //生产者看到的读位置
+
+    //消费者的缓存行
+    alignas(64) std::atomic<std::size_t> head_;
+    std::size_t cachedTail_;    //消费者看到的写位置
+};
+
+
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "Future.h"
+#include "ThreadPool.h"
+
+namespace THREADING
+{
+
+
+/**
+* @class TaskGraph
+* @brief 有依赖关系的任务图
+* @details 先用add添加任务 用precede指定先后关系 然后run在线程池里执行
+*          一个任务的所有前驱完成之后马上提交 没有依赖关系的任务并行执行 不需要按层同步
+*          任务抛出异常之后 还没有开始的任务都跳过 run返回的Future里是第一个异常
+*          图可以反复run 比如每帧的世界更新 同一个图同时只能有一个run 并且要活到run完成
+*/
+class TaskGraph
+{
+public:
+    using ptr = std::shared_ptr<TaskGraph>;
+    using NodeId = std::size_t;
+
+public:
+    TaskGraph() :
+        checked_(false)
+    {}
+
+    TaskGraph(TaskGraph const&) = delete;
+    TaskGraph& operator=(TaskGraph const&) = delete;
+
+    /**
+    * @brief 添加一个任务
+    * @return 任务的编号 用于precede
+    */
+    NodeId add(std::function<void()> func)
+    {
+        nodes_.push_back(std::make_unique<Node>(std::move(func)));
+        checked_ = false;
+        return nodes_.size() - 1;
+    }
+
+    /**
+    * @brief before完成之后才执行after
+    */
+    void precede(NodeId before, NodeId after)
+    {
+        nodes_.at(before)->successors_.push_back(after);
+        ++nodes_.at(after)->dependencies_;
+        checked_ = false;
+    }
+
+    std::size_t size() const { return nodes_.size(); }
+
+    /**
+    * @brief 在线程池里执行整个图
+    * @return 所有任务完成之后完成 有环的时候抛出std::logic_error
+    */
+    Future<void> run(ThreadPool& pool)
+    {
+        //图没有改过就不用重新检查 每帧run的时候省掉一次遍历
+        if (!checked_)
+        {
+            checkAcyclic();
+            checked_ = true;
+        }
+
+        auto state = std::make_shared<detail::SharedState<void>>(&pool);
+        if (nodes_.empty())
+        {
+            state->setValue(detail::Unit());
+            return Future<void>(state);
+        }
+
+        auto run = std::make_shared<Run>(state, nodes_.size());
+        for (auto& node : nodes_)
+            node->remaining_.store(node->dependencies_, std::memory_order_relaxed);
+
+        for (NodeId id = 0; id < nodes_.size(); ++id)
+        {
+            if (!nodes_[id]->dependencies_)
+                schedule(pool, run, id);
+        }
+
+        return Future<void>(state);
+    }
+
+private:
+    struct Node
+    {
+        explicit Node(std::function<void()> func) :
+            func_(std::move(func)),
+            dependencies_(0),
+            remaining_(0)
+        {}
+
+        std::function<void()> func_;
+        std::vector<NodeId> successors_;
+        std::size_t dependencies_;              //前驱的个数
+        std::atomic<std::size_t> remaining_;    //这次run还没有完成的前驱
+    };
+
+    //一次run的状态
+    struct Run
+    {
+        Run(detail::SharedState<void>::ptr state, std::size_t count) :
+            state_(std::move(state)),
+            unfinished_(count),
+            failed_(false)
+        {}
+
+        detail::SharedState<void>::ptr state_;
+        std::atomic<std::size_t> unfinished_;
+        std::atomic<bool> failed_;
+        std::mutex mutex_;
+        std::exception_ptr exception_;
+    };
+
+    void schedule(ThreadPool& pool, std::shared_ptr<Run> const& run, NodeId id)
+    {
+        pool.post([this, &pool, run, id]() { execute(pool, run, id); });
+    }
+
+    void execute(ThreadPool& pool, std::shared_ptr<Run> const& run, NodeId id)
+    {
+        Node& node = *nodes_[id];
+        if (!run->failed_.load(std::memory_order_acquire))
+        {
+            try
+            {
+                node.func_();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(run->mutex_);
+                if (!run->exception_)
+                    run->exception_ = std::current_exception();
+                run->failed_.store(true, std::memory_order_release);
+            }
+        }
+
+        for (NodeId successor : node.successors_)
+        {
+            if (nodes_[successor]->remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                schedule(pool, run, successor);
+        }
+
+        if (run->unfinished_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        //最后一个任务完成 这之后不能再访问图 调用者可能马上销毁它
+        std::exception_ptr exception;
+        {
+            std::lock_guard<std::mutex> lock(run->mutex_);
+            exception = run->exception_;
+        }
+
+        if (exception)
+            run->state_->setException(exception);
+        else
+            run->state_->setValue(detail::Unit());
+    }
+
+    //拓扑排序 排不完说明有环 有环的图run永远不会完成
+    void checkAcyclic() const
+    {
+        std::vector<std::size_t> indegree(nodes_.size());
+        std::vector<NodeId> ready;
+        for (NodeId id = 0; id < nodes_.size(); ++id)
+        {
+            indegree[id] = nodes_[id]->dependencies_;
+            if (!indegree[id])
+                ready.push_back(id);
+        }
+
+        std::size_t visited = 0;
+        while (!ready.empty())
+        {
+            NodeId id = ready.back();
+            ready.pop_back();
+            ++visited;
+
+            for (NodeId successor : nodes_[id]->successors_)
+            {
+                if (!--indegree[successor])
+                    ready.push_back(successor);
+            }
+        }
+
+        if (visited != nodes_.size())
+            throw std::logic_error("TaskGraph has a cycle");
+    }
+
+private:
+    std::vector<std::unique_ptr<Node>> nodes_;
+    bool checked_;      //上次检查之后图没有改过
+};
+
+
+}
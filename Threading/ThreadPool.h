@@ -1,20 +1,72 @@
 #pragma once
 
 
-#include <boost/asio/post.hpp>
-#include <boost/asio/thread_pool.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <type_traits>
 #include <utility>
+#include <vector>
+#include "WorkStealingDeque.h"
 
-namespace THREADING 
+#define THREAD_POOL_SPIN_COUNT 64      //找不到任务时睡眠之前重试的次数
+
+namespace THREADING
 {
 
 
+class ThreadPool;
+
 /**
-* @class ThreadPool
-* @brief boost::asio::thread_pool的简单封装
+* @class TaskGroup
+* @brief 一组通过ThreadPool::spawn提交的任务 ThreadPool::wait等待它们全部完成
+* @details 任务里面可以继续往同一个组spawn子任务 第一个抛出的异常在wait里重新抛出
 */
+class TaskGroup
+{
+public:
+    TaskGroup() :
+        pending_(0)
+    {}
+
+    TaskGroup(TaskGroup const&) = delete;
+    TaskGroup& operator=(TaskGroup const&) = delete;
+
+    //还没有完成的任务数
+    std::size_t pending() const { return pending_.load(std::memory_order_acquire); }
+
+private:
+    friend class ThreadPool;
+
+    void setException(std::exception_ptr exception)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!exception_)
+            exception_ = exception;
+    }
+
+private:
+    std::atomic<std::size_t> pending_;
+    std::mutex mutex_;
+    std::exception_ptr exception_;
+};
+
 
+/**
+* @class ThreadPool
+* @brief 工作窃取线程池
+* @details 每个工作线程有自己的Chase-Lev双端队列 在工作线程里post/spawn的任务放进自己的队列 不和其他线程竞争
+*          其他线程提交的任务先放进共享的注入队列 空闲的工作线程依次从自己的队列 注入队列 其他线程的队列里取任务
+*          都没有的时候才在条件变量上睡眠 提交任务只有在有线程睡眠的时候才加锁唤醒
+*          wait的线程自己也执行任务 所以在任务里面等待子任务不会把线程耗尽 游戏主循环这样的非工作线程也会帮忙
+*          非工作线程找不到可以执行的任务时才在条件变量上睡眠 由任务的提交和完成唤醒
+*/
 class ThreadPool
 {
 public:
@@ -25,9 +77,41 @@ public:
     * @brief 构造函数
     * @param numThreads 开启多少个线程
     */
+    explicit ThreadPool(std::size_t numThreads) :
+        stopped_(false),
+        joining_(false),
+        pending_(0),
+        injectedCount_(0),
+        sleepers_(0),
+        doneWaiters_(0)
+    {
+        numThreads = numThreads ? numThreads : 1;
+        for (std::size_t i = 0; i < numThreads; ++i)
+            workers_.push_back(std::make_unique<Worker>(uint32_t(i) * 2654435761u + 1));
 
-    explicit ThreadPool(std::size_t numThreads) : pool_(numThreads)
-    {}
+        for (std::size_t i = 0; i < numThreads; ++i)
+            workers_[i]->thread_ = std::thread(&ThreadPool::run, this, i);
+    }
+
+    ~ThreadPool()
+    {
+        stop();
+        joinThreads();
+
+        //停止之后没有执行的任务直接释放
+        Task* task;
+        for (auto& worker : workers_)
+        {
+            while (worker->deque_.pop(task))
+                delete task;
+        }
+
+        for (Task* injected : injected_)
+            delete injected;
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
 
 
     /**
@@ -35,9 +119,83 @@ public:
     * @param task 任务
     */
     template<typename T>
-    decltype(auto) post(T&& task)
+    void post(T&& task)
+    {
+        submit(new TaskImpl<std::decay_t<T>>(std::forward<T>(task), nullptr));
+    }
+
+    /**
+    * @brief 提交一个属于group的任务 用wait(group)等待
+    * @details 在工作线程里调用的时候放进当前线程的队列 空闲的线程会来偷
+    */
+    template<typename T>
+    void spawn(TaskGroup& group, T&& task)
     {
-        return boost::asio::post(pool_, std::forward<T>(task));
+        group.pending_.fetch_add(1, std::memory_order_relaxed);
+        submit(new TaskImpl<std::decay_t<T>>(std::forward<T>(task), &group));
+    }
+
+    /**
+    * @brief 等待group里的任务全部完成 在工作线程里等待的时候也执行任务
+    * @details 任务抛出的第一个异常在这里重新抛出
+    */
+    void wait(TaskGroup& group)
+    {
+        waitUntil([&group]() { return !group.pending(); });
+
+        std::exception_ptr exception;
+        {
+            std::lock_guard<std::mutex> lock(group.mutex_);
+            std::swap(exception, group.exception_);
+        }
+
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+
+    /**
+    * @brief 等到done()返回true
+    * @details 等待的时候从注入队列取任务或者从工作线程偷任务执行 等待别的任务的结果也不会占着线程不干活
+    *          非工作线程自旋THREAD_POOL_SPIN_COUNT次都没有任务可以执行之后睡眠 提交任务和任务完成的时候唤醒重新检查
+    *          done()因为线程池以外的原因变成true的时候 要调用notifyWaiters
+    */
+    template<typename Predicate>
+    void waitUntil(Predicate done)
+    {
+        bool isWorker = isWorkerThread();
+        uint32_t idle = 0;
+        while (!done())
+        {
+            if (runOne())
+            {
+                idle = 0;
+                continue;
+            }
+
+            //剩下的任务都在别的线程上执行
+            if (++idle <= THREAD_POOL_SPIN_COUNT || isWorker)
+            {
+                if (idle > THREAD_POOL_SPIN_COUNT)
+                    std::this_thread::yield();
+                continue;
+            }
+
+            //登记之后再检查 和wakeDoneWaiters配合保证不会丢失唤醒
+            std::unique_lock<std::mutex> lock(doneMutex_);
+            doneWaiters_.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!done() && !hasWork())
+                doneCond_.wait(lock);
+            doneWaiters_.fetch_sub(1);
+            idle = 0;
+        }
+    }
+
+    //唤醒在waitUntil里睡眠的线程重新检查条件 比如promise在线程池以外完成
+    void notifyWaiters()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wakeDoneWaiters();
     }
 
     /**
@@ -45,7 +203,9 @@ public:
     */
     void join()
     {
-        pool_.join();
+        joining_ = true;
+        wakeAll();
+        joinThreads();
     }
 
     /**
@@ -53,11 +213,278 @@ public:
     */
     void stop()
     {
-        pool_.stop();
+        stopped_ = true;
+        wakeAll();
+    }
+
+    std::size_t getThreadCount() const
+    {
+        return workers_.size();
+    }
+
+    //当前线程是否是这个线程池的工作线程
+    bool isWorkerThread() const
+    {
+        return currentWorker().pool_ == this;
+    }
+
+private:
+    //类型擦除的任务 支持只能移动的可调用对象
+    struct Task
+    {
+        explicit Task(TaskGroup* group) : group_(group) {}
+        virtual ~Task() = default;
+        virtual void run() = 0;
+
+        TaskGroup* group_;
+    };
+
+    template <typename F>
+    struct TaskImpl : Task
+    {
+        template <typename U>
+        TaskImpl(U&& func, TaskGroup* group) : Task(group), func_(std::forward<U>(func)) {}
+        void run() override { func_(); }
+
+        F func_;
+    };
+
+    struct Worker
+    {
+        explicit Worker(uint32_t seed) : seed_(seed) {}
+
+        WorkStealingDeque<Task*> deque_;
+        std::thread thread_;
+        uint32_t seed_;     //选择窃取对象的随机数
+    };
+
+    struct WorkerContext
+    {
+        ThreadPool const* pool_ = nullptr;
+        std::size_t index_ = 0;
+    };
+
+    static WorkerContext& currentWorker()
+    {
+        static thread_local WorkerContext context;
+        return context;
+    }
+
+    void submit(Task* task)
+    {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+
+        WorkerContext& context = currentWorker();
+        if (context.pool_ == this)
+        {
+            workers_[context.index_]->deque_.push(task);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(injectMutex_);
+            injected_.push_back(task);
+            injectedCount_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        wakeOne();
+    }
+
+    //找一个任务执行 找不到返回false
+    bool runOne()
+    {
+        Task* task = findTask();
+        if (!task)
+            return false;
+
+        execute(task);
+        return true;
+    }
+
+    void execute(Task* task)
+    {
+        TaskGroup* group = task->group_;
+        if (group)
+        {
+            try
+            {
+                task->run();
+            }
+            catch (...)
+            {
+                group->setException(std::current_exception());
+            }
+        }
+        else
+        {
+            task->run();
+        }
+
+        delete task;
+        if (group)
+            group->pending_.fetch_sub(1, std::memory_order_acq_rel);
+
+        //有非工作线程在waitUntil里睡眠的时候唤醒它们重新检查 group此后可能已经被释放
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wakeDoneWaiters();
+
+        //最后一个任务完成 join的线程可以退出了
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1 && joining_)
+            wakeAll();
+    }
+
+    Task* findTask()
+    {
+        Task* task = nullptr;
+        WorkerContext& context = currentWorker();
+        bool isWorker = context.pool_ == this;
+
+        if (isWorker && workers_[context.index_]->deque_.pop(task))
+            return task;
+
+        if (injectedCount_.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(injectMutex_);
+            if (!injected_.empty())
+            {
+                task = injected_.front();
+                injected_.pop_front();
+                injectedCount_.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+
+        //从随机的位置开始偷 避免所有线程都去偷同一个
+        std::size_t count = workers_.size();
+        std::size_t start = isWorker ? nextRandom(workers_[context.index_]->seed_) % count : 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::size_t victim = (start + i) % count;
+            if (isWorker && victim == context.index_)
+                continue;
+
+            if (workers_[victim]->deque_.steal(task))
+                return task;
+        }
+
+        return nullptr;
+    }
+
+    bool hasWork() const
+    {
+        if (injectedCount_.load(std::memory_order_relaxed))
+            return true;
+
+        for (auto const& worker : workers_)
+        {
+            if (!worker->deque_.empty())
+                return true;
+        }
+
+        return false;
+    }
+
+    void run(std::size_t index)
+    {
+        WorkerContext& context = currentWorker();
+        context.pool_ = this;
+        context.index_ = index;
+
+        uint32_t idle = 0;
+        while (!stopped_)
+        {
+            if (runOne())
+            {
+                idle = 0;
+                continue;
+            }
+
+            if (joining_ && !pending_.load(std::memory_order_acquire))
+                break;
+
+            if (++idle < THREAD_POOL_SPIN_COUNT)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            //登记睡眠之后再检查一次 和wakeOne配合保证不会丢失唤醒
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            sleepers_.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!stopped_ && !hasWork() && !(joining_ && !pending_.load()))
+                sleepCond_.wait(lock);
+            sleepers_.fetch_sub(1);
+            idle = 0;
+        }
+
+        context.pool_ = nullptr;
+    }
+
+    void wakeOne()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        //在waitUntil里睡眠的非工作线程也来帮忙
+        wakeDoneWaiters();
+
+        if (!sleepers_.load(std::memory_order_relaxed))
+            return;
+
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        sleepCond_.notify_one();
+    }
+
+    //调用之前要有seq_cst的fence
+    void wakeDoneWaiters()
+    {
+        if (!doneWaiters_.load(std::memory_order_relaxed))
+            return;
+
+        std::lock_guard<std::mutex> lock(doneMutex_);
+        doneCond_.notify_all();
+    }
+
+    void wakeAll()
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        sleepCond_.notify_all();
+    }
+
+    void joinThreads()
+    {
+        for (auto& worker : workers_)
+        {
+            if (worker->thread_.joinable() && worker->thread_.get_id() != std::this_thread::get_id())
+                worker->thread_.join();
+        }
+    }
+
+    static uint32_t nextRandom(uint32_t& seed)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
     }
 
 private:
-    boost::asio::thread_pool pool_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::atomic<bool> stopped_;
+    std::atomic<bool> joining_;
+    std::atomic<std::size_t> pending_;      //已经提交还没有执行完的任务数
+
+    std::mutex injectMutex_;
+    std::deque<Task*> injected_;            //非工作线程提交的任务
+    std::atomic<std::size_t> injectedCount_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable sleepCond_;
+    std::atomic<uint32_t> sleepers_;        //睡眠的工作线程数
+
+    std::mutex doneMutex_;
+    std::condition_variable doneCond_;      //任务提交和完成的时候唤醒waitUntil里睡眠的非工作线程
+    std::atomic<uint32_t> doneWaiters_;
 };
 
-}// end  namespace Threading
\ No newline at end of file
+}// end  namespace Threading
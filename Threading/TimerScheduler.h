@@ -0,0 +1,326 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+#define TIMER_SCHEDULER_SLACK_US 500    //到期时间相差不到这么多的定时器在同一次唤醒里一起触发
+
+namespace THREADING
+{
+
+
+/**
+* @class TimerHandle
+* @brief 定时器的取消句柄 可以复制 所有副本控制同一个定时器
+*/
+class TimerHandle
+{
+public:
+    TimerHandle() = default;
+
+    /**
+    * @brief 取消定时器 已经提交出去正在执行的这一次不受影响
+    */
+    void cancel()
+    {
+        if (cancelled_)
+            cancelled_->store(true, std::memory_order_release);
+    }
+
+    bool isCancelled() const
+    {
+        return !cancelled_ || cancelled_->load(std::memory_order_acquire);
+    }
+
+private:
+    friend class TimerScheduler;
+
+    explicit TimerHandle(std::shared_ptr<std::atomic<bool>> cancelled) :
+        cancelled_(std::move(cancelled))
+    {}
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+
+/**
+* @class TimerScheduler
+* @brief 延时任务和周期任务的调度器
+* @details 所有定时器放在一个最小堆里 由一个定时器线程睡到最早的到期时间
+*          到期的任务提交到ThreadPool或者io_context执行 定时器线程自己不执行任务
+*          到期时间相差不到TIMER_SCHEDULER_SLACK_US的定时器合并到同一次唤醒 没有定时器的时候线程一直睡眠
+*          周期任务按计划时间累加周期 不按实际执行时间 所以不会越来越晚
+*          落后超过一个周期的时候跳过错过的次数 上一次还没有执行完的时候也跳过这一次 同一个周期任务不会并发执行
+*          取消只是打标记 堆里的定时器到期的时候才丢掉
+*/
+class TimerScheduler
+{
+public:
+    using ptr = std::shared_ptr<TimerScheduler>;
+    using clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+
+public:
+    /**
+    * @brief 构造函数
+    * @param pool 默认执行任务的线程池 为nullptr的时候在定时器线程上直接执行 任务必须很短
+    */
+    explicit TimerScheduler(ThreadPool* pool = nullptr) :
+        pool_(pool),
+        stop_(false),
+        sequence_(0)
+    {
+        thread_ = std::thread(&TimerScheduler::run, this);
+    }
+
+    ~TimerScheduler()
+    {
+        stop();
+    }
+
+    TimerScheduler(TimerScheduler const&) = delete;
+    TimerScheduler& operator=(TimerScheduler const&) = delete;
+
+    /**
+    * @brief delay之后执行一次 在默认的线程池里执行
+    */
+    template <typename Rep, typename Period>
+    TimerHandle scheduleAfter(std::chrono::duration<Rep, Period> const& delay, Task task)
+    {
+        return add(clock::now() + delay, clock::duration::zero(), std::move(task), defaultDispatcher());
+    }
+
+    /**
+    * @brief delay之后执行一次 在context里执行
+    * @param context ThreadPool或者boost::asio::io_context
+    */
+    template <typename Context, typename Rep, typename Period>
+    TimerHandle scheduleAfter(Context& context, std::chrono::duration<Rep, Period> const& delay, Task task)
+    {
+        return add(clock::now() + delay, clock::duration::zero(), std::move(task), dispatcherFor(context));
+    }
+
+    /**
+    * @brief 每隔period执行一次 第一次在firstDelay之后 在默认的线程池里执行
+    * @param firstDelay 第一次执行的延时 负数表示等于period
+    */
+    template <typename Rep, typename Period>
+    TimerHandle schedulePeriodic(std::chrono::duration<Rep, Period> const& period, Task task,
+        clock::duration firstDelay = clock::duration(-1))
+    {
+        auto interval = std::chrono::duration_cast<clock::duration>(period);
+        return add(clock::now() + (firstDelay.count() < 0 ? interval : firstDelay), interval, std::move(task), defaultDispatcher());
+    }
+
+    /**
+    * @brief 每隔period执行一次 在context里执行
+    * @param context ThreadPool或者boost::asio::io_context
+    */
+    template <typename Context, typename Rep, typename Period>
+    TimerHandle schedulePeriodic(Context& context, std::chrono::duration<Rep, Period> const& period, Task task,
+        clock::duration firstDelay = clock::duration(-1))
+    {
+        auto interval = std::chrono::duration_cast<clock::duration>(period);
+        return add(clock::now() + (firstDelay.count() < 0 ? interval : firstDelay), interval, std::move(task), dispatcherFor(context));
+    }
+
+    /**
+    * @brief 停止定时器线程 还没有到期的定时器全部丢弃
+    */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_)
+                return;
+            stop_ = true;
+        }
+        cond_.notify_all();
+
+        if (thread_.joinable())
+            thread_.join();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        timers_ = Heap();
+    }
+
+    //堆里的定时器个数 包括已经取消还没有到期的
+    std::size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return timers_.size();
+    }
+
+private:
+    using Dispatcher = std::function<void(Task)>;
+
+    struct Timer
+    {
+        Task task_;
+        Dispatcher dispatcher_;
+        clock::duration period_;                        //0表示只执行一次
+        std::shared_ptr<std::atomic<bool>> cancelled_;
+        std::atomic<bool> running_{ false };            //周期任务上一次还没有执行完
+    };
+
+    struct Entry
+    {
+        clock::time_point when_;
+        uint64_t sequence_;             //到期时间相同的按添加顺序触发
+        std::shared_ptr<Timer> timer_;
+
+        bool operator>(Entry const& other) const
+        {
+            return when_ != other.when_ ? when_ > other.when_ : sequence_ > other.sequence_;
+        }
+    };
+
+    using Heap = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>;
+
+    TimerHandle add(clock::time_point when, clock::duration period, Task task, Dispatcher dispatcher)
+    {
+        auto timer = std::make_shared<Timer>();
+        timer->task_ = std::move(task);
+        timer->dispatcher_ = std::move(dispatcher);
+        timer->period_ = period;
+        timer->cancelled_ = std::make_shared<std::atomic<bool>>(false);
+
+        TimerHandle handle(timer->cancelled_);
+
+        bool earliest;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_)
+                return TimerHandle();
+
+            earliest = timers_.empty() || when < timers_.top().when_;
+            timers_.push(Entry{ when, sequence_++, std::move(timer) });
+        }
+
+        //比当前最早的还早才需要叫醒定时器线程重新计算睡眠时间
+        if (earliest)
+            cond_.notify_one();
+
+        return handle;
+    }
+
+    Dispatcher defaultDispatcher()
+    {
+        if (pool_)
+            return dispatcherFor(*pool_);
+
+        return [](Task task) { task(); };
+    }
+
+    template <typename Context>
+    static Dispatcher dispatcherFor(Context& context)
+    {
+        if constexpr (std::is_same_v<Context, ThreadPool>)
+        {
+            return [&context](Task task) { context.post(std::move(task)); };
+        }
+        else
+        {
+            //通过ADL找到boost::asio::post 这里不需要包含asio的头文件
+            return [&context](Task task) { post(context, std::move(task)); };
+        }
+    }
+
+    void run()
+    {
+        std::vector<std::shared_ptr<Timer>> due;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_)
+        {
+            if (timers_.empty())
+            {
+                cond_.wait(lock);
+                continue;
+            }
+
+            clock::time_point now = clock::now();
+            if (timers_.top().when_ > now)
+            {
+                cond_.wait_until(lock, timers_.top().when_);
+                continue;
+            }
+
+            //顺便把马上就要到期的也取出来 合并成一次唤醒
+            clock::time_point limit = now + std::chrono::microseconds(TIMER_SCHEDULER_SLACK_US);
+            while (!timers_.empty() && timers_.top().when_ <= limit)
+            {
+                Entry entry = timers_.top();
+                timers_.pop();
+
+                Timer& timer = *entry.timer_;
+                if (timer.cancelled_->load(std::memory_order_acquire))
+                    continue;
+
+                if (timer.period_ != clock::duration::zero())
+                {
+                    //按计划时间累加 落后太多的时候跳过错过的次数
+                    clock::time_point next = entry.when_ + timer.period_;
+                    if (next <= now)
+                        next += timer.period_ * ((now - next) / timer.period_ + 1);
+
+                    timers_.push(Entry{ next, sequence_++, entry.timer_ });
+                }
+
+                due.push_back(std::move(entry.timer_));
+            }
+
+            //提交任务的时候不持有锁 任务里可以继续添加定时器
+            lock.unlock();
+            for (auto& timer : due)
+                fire(timer);
+            due.clear();
+            lock.lock();
+        }
+    }
+
+    static void fire(std::shared_ptr<Timer> const& timer)
+    {
+        if (timer->period_ == clock::duration::zero())
+        {
+            timer->dispatcher_(std::move(timer->task_));
+            return;
+        }
+
+        //上一次还在执行 这一次跳过
+        if (timer->running_.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        timer->dispatcher_([timer]() {
+            if (!timer->cancelled_->load(std::memory_order_acquire))
+                timer->task_();
+            timer->running_.store(false, std::memory_order_release);
+        });
+    }
+
+private:
+    ThreadPool* pool_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    Heap timers_;
+    bool stop_;
+    uint64_t sequence_;
+    std::thread thread_;    //放在最后 其他成员初始化完成之后才启动
+};
+
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#define WORK_STEALING_DEQUE_INITIAL_CAPACITY 1024   //初始容量 满了之后翻倍
+
+namespace THREADING
+{
+
+
+/**
+* @class WorkStealingDeque
+* @brief Chase-Lev工作窃取双端队列
+* @details 只有所属的线程可以push/pop 在底部操作 后进先出 缓存更热
+*          其他线程从顶部steal 先进先出 偷走的是最早放入的(通常也是最大的)任务
+*          owner和thief只在剩最后一个元素的时候用CAS竞争top
+*          扩容之后旧的数组可能还有thief在读 所以保留到析构时再释放
+*          元素在并发读写 所以T必须是可以原子读写的简单类型 一般是指针
+*/
+template <typename T>
+class WorkStealingDeque
+{
+    static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque element must be trivially copyable");
+
+public:
+    explicit WorkStealingDeque(std::size_t capacity = WORK_STEALING_DEQUE_INITIAL_CAPACITY) :
+        top_(0),
+        bottom_(0)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        arrays_.push_back(std::make_unique<Array>(size));
+        array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(WorkStealingDeque const&) = delete;
+    WorkStealingDeque& operator=(WorkStealingDeque const&) = delete;
+
+    /**
+    * @brief 放入底部 只能由所属线程调用
+    */
+    void push(T v)
+    {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Array* array = array_.load(std::memory_order_relaxed);
+
+        if (bottom - top > int64_t(array->mask_))
+            array = grow(array, top, bottom);
+
+        array->put(bottom, v);
+        bottom_.store(bottom + 1, std::memory_order_release);
+    }
+
+    /**
+    * @brief 从底部取出 只能由所属线程调用
+    * @return 为空或者最后一个元素被偷走的时候返回false
+    */
+    bool pop(T& v)
+    {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* array = array_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        v = array->get(bottom);
+        if (top == bottom)
+        {
+            //最后一个元素 和thief抢
+            bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    /**
+    * @brief 从顶部偷一个 任意线程都可以调用
+    * @return 为空或者和其他线程竞争失败的时候返回false
+    */
+    bool steal(T& v)
+    {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+            return false;
+
+        Array* array = array_.load(std::memory_order_acquire);
+        v = array->get(top);
+        return top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    //近似的元素个数
+    std::size_t size() const
+    {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        return bottom > top ? std::size_t(bottom - top) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    struct Array
+    {
+        explicit Array(std::size_t size) :
+            mask_(size - 1),
+            slots_(new std::atomic<T>[size])
+        {}
+
+        T get(int64_t index) const { return slots_[std::size_t(index) & mask_].load(std::memory_order_relaxed); }
+        void put(int64_t index, T v) { slots_[std::size_t(index) & mask_].store(v, std::memory_order_relaxed); }
+
+        std::size_t mask_;
+        std::unique_ptr<std::atomic<T>[]> slots_;
+    };
+
+    Array* grow(Array* array, int64_t top, int64_t bottom)
+    {
+        arrays_.push_back(std::make_unique<Array>((array->mask_ + 1) * 2));
+        Array* bigger = arrays_.back().get();
+        for (int64_t i = top; i < bottom; ++i)
+            bigger->put(i, array->get(i));
+
+        array_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top_;      //thief竞争的位置
+    alignas(64) std::atomic<int64_t> bottom_;   //只有owner修改
+    std::atomic<Array*> array_;
+    std::vector<std::unique_ptr<Array>> arrays_;    //包括扩容之前的数组 只有owner修改
+};
+
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -101,7 +102,8 @@ public:
     {
         if (getRemainingSpace() < bytes) 
         {
-            buffer_.resize(buffer_.size() *1.5);
+            //一般扩大1.5倍 一次写入超过1.5倍的时候直接扩到刚好够用
+            buffer_.resize(std::max<sizeType>(buffer_.size() * 3 / 2, wPos_ + bytes));
         }
     }
 
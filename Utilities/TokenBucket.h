@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace UTIL
+{
+
+
+/**
+* @class TokenBucket
+* @brief 令牌桶 按固定速率补充令牌 最多累积burst个
+* @details 允许透支: consume之后令牌数可以是负数 在补回正数之前getDelay返回需要等待的时间
+*          非线程安全 多线程共享的时候需要外部加锁
+*/
+class TokenBucket
+{
+public:
+    using ptr = std::shared_ptr<TokenBucket>;
+    using clock = std::chrono::steady_clock;
+
+public:
+    TokenBucket() :
+        rate_(0),
+        burst_(0),
+        tokens_(0),
+        last_(clock::now())
+    {}
+
+    /**
+    * @brief 构造函数
+    * @param rate 每秒补充的令牌数 0表示不限速
+    * @param burst 桶的容量 0表示与rate相同
+    */
+    TokenBucket(double rate, double burst)
+    {
+        reset(rate, burst);
+    }
+
+    void reset(double rate, double burst)
+    {
+        rate_ = rate;
+        burst_ = burst > 0 ? burst : rate;
+        tokens_ = burst_;
+        last_ = clock::now();
+    }
+
+    bool isEnabled() const { return rate_ > 0; }
+
+    //消费n个令牌 令牌不足的时候记为透支
+    void consume(double n)
+    {
+        if (!isEnabled())
+            return;
+
+        refill();
+        tokens_ -= n;
+    }
+
+    /**
+    * @brief 获取令牌恢复为正数还需要等待的时间
+    * @return 0表示现在就可以继续消费
+    */
+    clock::duration getDelay()
+    {
+        if (!isEnabled())
+            return clock::duration::zero();
+
+        refill();
+        if (tokens_ > 0)
+            return clock::duration::zero();
+
+        //多等一个令牌 避免刚好补到0的时候又被唤醒
+        return std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>((1 - tokens_) / rate_));
+    }
+
+    double getTokens() const { return tokens_; }
+
+private:
+    void refill()
+    {
+        clock::time_point now = clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_).count();
+        last_ = now;
+        tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+    }
+
+private:
+    double rate_;       //每秒补充的令牌数
+    double burst_;      //桶的容量
+    double tokens_;     //当前的令牌数 可以为负数
+    clock::time_point last_;    //上一次补充令牌的时间
+};
+
+
+}// namespace UTIL
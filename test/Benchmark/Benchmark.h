@@ -0,0 +1,124 @@
+#pragma once
+
+
+/**
+* @file Benchmark.h
+* @brief 基准测试的公共工具 计时 延时分位数 输出格式
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace BENCH
+{
+
+
+using clock = std::chrono::steady_clock;
+
+inline uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+}
+
+//防止编译器把结果没有用到的计算优化掉
+template <typename T>
+inline void doNotOptimize(T const& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+
+/**
+* @class Latency
+* @brief 记录每次操作的耗时 最后排序求分位数
+* @details 每个线程用自己的Latency记录 结束之后merge到一起 记录的时候不加锁
+*/
+class Latency
+{
+public:
+    explicit Latency(std::size_t reserve = 0)
+    {
+        samples_.reserve(reserve);
+    }
+
+    void record(uint64_t ns) { samples_.push_back(ns); }
+
+    void merge(Latency const& other)
+    {
+        samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+    }
+
+    std::size_t count() const { return samples_.size(); }
+
+    //p在0到1之间 调用之前先sort
+    uint64_t percentile(double p) const
+    {
+        if (samples_.empty())
+            return 0;
+
+        std::size_t index = std::size_t(p * (samples_.size() - 1));
+        return samples_[index];
+    }
+
+    void sort() { std::sort(samples_.begin(), samples_.end()); }
+
+private:
+    std::vector<uint64_t> samples_;
+};
+
+
+inline void printHeader()
+{
+    printf("%-44s %14s %9s %9s %9s %9s %9s\n", "benchmark", "ops/s", "p50(ns)", "p90", "p99", "p99.9", "max");
+}
+
+/**
+* @brief 输出一行结果
+* @param ops 完成的操作数
+* @param seconds 总耗时
+*/
+inline void report(std::string const& name, uint64_t ops, double seconds, Latency& latency)
+{
+    latency.sort();
+    printf("%-44s %14.0f %9lu %9lu %9lu %9lu %9lu\n", name.c_str(), ops / seconds,
+        (unsigned long)latency.percentile(0.5),
+        (unsigned long)latency.percentile(0.9),
+        (unsigned long)latency.percentile(0.99),
+        (unsigned long)latency.percentile(0.999),
+        (unsigned long)latency.percentile(1.0));
+}
+
+/**
+* @brief 单线程执行ops次op
+* @details 先不计时跑一遍算吞吐量 再每次单独计时跑一遍算延时
+*          计时本身大约有二三十纳秒的开销 很快的操作看吞吐量更准确
+*/
+template <typename Op>
+void measure(std::string const& name, uint64_t ops, Op&& op)
+{
+    //先预热 让缓存和分支预测稳定下来
+    for (uint64_t i = 0; i < ops / 10; ++i)
+        op(i);
+
+    auto start = clock::now();
+    for (uint64_t i = 0; i < ops; ++i)
+        op(i);
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    Latency latency(ops);
+    for (uint64_t i = 0; i < ops; ++i)
+    {
+        uint64_t begin = nowNs();
+        op(i);
+        latency.record(nowNs() - begin);
+    }
+
+    report(name, ops, seconds, latency);
+}
+
+
+}// namespace BENCH
@@ -0,0 +1,34 @@
+#include "Benchmark.h"
+#include "../../Utilities/MessageBuffer.h"
+#include <string>
+#include <vector>
+
+#define OPS 1000000
+
+int main()
+{
+    BENCH::printHeader();
+
+    std::vector<uint8_t> payload(4096, 0x5a);
+
+    //写入 读掉大部分 再normalize 模拟收包之后解析 剩下半个包
+    for (std::size_t size : { std::size_t(64), std::size_t(512), std::size_t(4096) })
+    {
+        UTIL::MessageBuffer buffer(16384);
+        BENCH::measure("MessageBuffer write+normalize " + std::to_string(size) + "B", OPS, [&](uint64_t) {
+            buffer.write(payload.data(), size);
+            buffer.readCommit(buffer.getActiveSize() - size / 2);
+            buffer.normalize();
+            BENCH::doNotOptimize(buffer.getReadPoint());
+        });
+    }
+
+    //从很小的缓冲区开始写一个大包 测试扩容
+    BENCH::measure("MessageBuffer grow 64B->4096B", OPS / 10, [&](uint64_t) {
+        UTIL::MessageBuffer buffer(64);
+        buffer.write(payload.data(), payload.size());
+        BENCH::doNotOptimize(buffer.getReadPoint());
+    });
+
+    return 0;
+}
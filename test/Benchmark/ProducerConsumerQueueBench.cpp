@@ -0,0 +1,136 @@
+#include "Benchmark.h"
+#include "../../Threading/ProducerConsumerQueue.h"
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define OPS_PER_PRODUCER 200000
+#define ROUND_TRIPS_PER_PRODUCER 20000
+
+//生产者全速push 吞吐量是队列饱和时的 延时是每次push调用本身的耗时
+void runSaturated(int producers, int consumers)
+{
+    THREADING::ProducerConsumerQueue<uint64_t> queue;
+    std::vector<BENCH::Latency> latencies(producers, BENCH::Latency(OPS_PER_PRODUCER));
+    std::atomic<uint64_t> received(0);
+    uint64_t total = uint64_t(producers) * OPS_PER_PRODUCER;
+
+    auto start = BENCH::clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < consumers; ++i)
+    {
+        threads.emplace_back([&]() {
+            uint64_t v;
+            while (queue.get(v))
+            {
+                if (received.fetch_add(1, std::memory_order_relaxed) + 1 == total)
+                    queue.stop();
+            }
+        });
+    }
+
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back([&, i]() {
+            BENCH::Latency& latency = latencies[i];
+            for (uint64_t j = 0; j < OPS_PER_PRODUCER; ++j)
+            {
+                uint64_t begin = BENCH::nowNs();
+                queue.push(j);
+                latency.record(BENCH::nowNs() - begin);
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(BENCH::clock::now() - start).count();
+
+    BENCH::Latency latency;
+    for (auto const& l : latencies)
+        latency.merge(l);
+
+    std::string name = "ProducerConsumerQueue " + std::to_string(producers) + "P" + std::to_string(consumers) + "C push";
+    BENCH::report(name, total, seconds, latency);
+}
+
+//每个生产者同时只有一个元素在队列里 等消费者取走之后才放下一个 延时是push到get返回的交接时间 不含排队
+void runClosedLoop(int producers, int consumers)
+{
+    struct Item
+    {
+        uint64_t pushed;
+        int producer;
+    };
+
+    THREADING::ProducerConsumerQueue<Item> queue;
+    std::unique_ptr<std::atomic<bool>[]> taken(new std::atomic<bool>[producers]);
+    std::vector<BENCH::Latency> latencies(consumers);
+    std::atomic<uint64_t> received(0);
+    uint64_t total = uint64_t(producers) * ROUND_TRIPS_PER_PRODUCER;
+
+    auto start = BENCH::clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < consumers; ++i)
+    {
+        threads.emplace_back([&, i]() {
+            BENCH::Latency& latency = latencies[i];
+            Item item;
+            while (queue.get(item))
+            {
+                latency.record(BENCH::nowNs() - item.pushed);
+                taken[item.producer].store(true, std::memory_order_release);
+                if (received.fetch_add(1, std::memory_order_relaxed) + 1 == total)
+                    queue.stop();
+            }
+        });
+    }
+
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back([&, i]() {
+            for (uint64_t j = 0; j < ROUND_TRIPS_PER_PRODUCER; ++j)
+            {
+                taken[i].store(false, std::memory_order_relaxed);
+                queue.push(Item{ BENCH::nowNs(), i });
+                while (!taken[i].load(std::memory_order_acquire))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(BENCH::clock::now() - start).count();
+
+    BENCH::Latency latency;
+    for (auto const& l : latencies)
+        latency.merge(l);
+
+    std::string name = "ProducerConsumerQueue " + std::to_string(producers) + "P" + std::to_string(consumers) + "C push->get closed";
+    BENCH::report(name, total, seconds, latency);
+}
+
+int main()
+{
+    BENCH::printHeader();
+    for (auto [producers, consumers] : { std::pair(1, 1), std::pair(1, 4), std::pair(4, 1), std::pair(4, 4), std::pair(8, 8) })
+    {
+        runSaturated(producers, consumers);
+        runClosedLoop(producers, consumers);
+    }
+
+#ifdef ENABLE_LOCK_PROFILING
+    //打开锁统计编译的时候 输出队列锁的竞争情况
+    THREADING::LockProfiler::getInstance()->dump(std::cout);
+#endif
+
+    return 0;
+}
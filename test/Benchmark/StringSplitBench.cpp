@@ -0,0 +1,32 @@
+#include "Benchmark.h"
+#include "../../Utilities/Util.h"
+#include <string>
+#include <vector>
+
+#define OPS 500000
+
+int main()
+{
+    BENCH::printHeader();
+
+    //连接字符串 配置项 长的逗号分隔列表
+    std::string connectionInfo = "127.0.0.1;3306;root;password;world";
+    std::string withEmpty = "a,,b,,c,,d,,e";
+    std::string longList;
+    for (int i = 0; i < 256; ++i)
+        longList += std::to_string(i * 7919) + ",";
+
+    BENCH::measure("stringSplit connection info", OPS, [&](uint64_t) {
+        BENCH::doNotOptimize(UTIL::stringSplit(connectionInfo, ';'));
+    });
+
+    BENCH::measure("stringSplit keepEmpty", OPS, [&](uint64_t) {
+        BENCH::doNotOptimize(UTIL::stringSplit(withEmpty, ',', true));
+    });
+
+    BENCH::measure("stringSplit 256 fields", OPS / 10, [&](uint64_t) {
+        BENCH::doNotOptimize(UTIL::stringSplit(longList, ','));
+    });
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "Benchmark.h"
+#include "../../Threading/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define TASK_COUNT 200000
+#define ROUND_TRIPS 20000
+
+//外部线程全速post 吞吐量是饱和时的 延时是每次post调用本身的耗时
+void postFromOutside(std::size_t threads)
+{
+    THREADING::ThreadPool pool(threads);
+    std::atomic<uint64_t> done(0);
+    BENCH::Latency latency(TASK_COUNT);
+
+    auto start = BENCH::clock::now();
+    for (uint64_t i = 0; i < TASK_COUNT; ++i)
+    {
+        uint64_t begin = BENCH::nowNs();
+        pool.post([&done]() { done.fetch_add(1, std::memory_order_release); });
+        latency.record(BENCH::nowNs() - begin);
+    }
+
+    while (done.load(std::memory_order_acquire) != TASK_COUNT)
+        std::this_thread::yield();
+    double seconds = std::chrono::duration<double>(BENCH::clock::now() - start).count();
+
+    BENCH::report("ThreadPool::post " + std::to_string(threads) + " threads", TASK_COUNT, seconds, latency);
+    pool.join();
+}
+
+//外部线程每次只post一个任务 等它开始执行之后再post下一个 延时是post到任务开始执行 不含排队
+void postRoundTrip(std::size_t threads)
+{
+    THREADING::ThreadPool pool(threads);
+    std::atomic<uint64_t> startedAt(0);
+    BENCH::Latency latency(ROUND_TRIPS);
+
+    auto start = BENCH::clock::now();
+    for (uint64_t i = 0; i < ROUND_TRIPS; ++i)
+    {
+        startedAt.store(0, std::memory_order_relaxed);
+        uint64_t posted = BENCH::nowNs();
+        pool.post([&startedAt]() { startedAt.store(BENCH::nowNs(), std::memory_order_release); });
+
+        uint64_t started;
+        while (!(started = startedAt.load(std::memory_order_acquire)))
+            std::this_thread::yield();
+        latency.record(started - posted);
+    }
+    double seconds = std::chrono::duration<double>(BENCH::clock::now() - start).count();
+
+    BENCH::report("ThreadPool::post->start closed " + std::to_string(threads) + " threads", ROUND_TRIPS, seconds, latency);
+    pool.join();
+}
+
+//工作线程里spawn 任务放进自己的队列 其他线程来偷 延时是每次spawn调用本身的耗时 吞吐量包括wait
+void spawnFromWorker(std::size_t threads)
+{
+    THREADING::ThreadPool pool(threads);
+    BENCH::Latency latency(TASK_COUNT);
+    double seconds = 0;
+
+    THREADING::TaskGroup outer;
+    pool.spawn(outer, [&]() {
+        auto start = BENCH::clock::now();
+
+        std::atomic<uint64_t> sum(0);
+        THREADING::TaskGroup group;
+        for (uint64_t i = 0; i < TASK_COUNT; ++i)
+        {
+            uint64_t begin = BENCH::nowNs();
+            pool.spawn(group, [&sum, i]() { sum.fetch_add(i, std::memory_order_relaxed); });
+            latency.record(BENCH::nowNs() - begin);
+        }
+        pool.wait(group);
+        BENCH::doNotOptimize(sum.load());
+
+        seconds = std::chrono::duration<double>(BENCH::clock::now() - start).count();
+    });
+    pool.wait(outer);
+
+    BENCH::report("ThreadPool::spawn/wait " + std::to_string(threads) + " threads", TASK_COUNT, seconds, latency);
+    pool.join();
+}
+
+int main()
+{
+    BENCH::printHeader();
+
+    std::vector<std::size_t> threadCounts = { 1, 2, std::max(1u, std::thread::hardware_concurrency()) };
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    for (std::size_t threads : threadCounts)
+    {
+        postFromOutside(threads);
+        postRoundTrip(threads);
+        spawnFromWorker(threads);
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "../Database/DatabaseWorkerPool.h"
+#include "../Database/DatabaseWorkerPool.cpp"
+#include <iostream>
+#include <vector>
+
+
+//不连接数据库的连接 工作线程照常运行 执行查询的时候因为没有句柄立刻返回空结果
+//用来测试连接池和工作线程本身 不需要mysql服务器
+class IdleConnection : public DATABASE::MysqlConnection
+{
+public:
+    using DATABASE::MysqlConnection::MysqlConnection;
+
+    uint32_t open() override
+    {
+        startWorker();
+        return 0;
+    }
+};
+
+
+#define QUERY_COUNT 20000
+
+
+int main()
+{
+    DATABASE::DatabaseWorkerPool<IdleConnection> pool;
+    pool.setConnectionInfo("127.0.0.1;3306;test;test;test", 2, 0);
+    if (pool.open())
+    {
+        std::cout << "open failed" << std::endl;
+        return 1;
+    }
+
+    //工作线程空闲的时候入队 任务可能在AsyncQuery返回之前就执行完并释放了
+    std::vector<DATABASE::QueryCallback> callbacks;
+    callbacks.reserve(QUERY_COUNT);
+    int invoked = 0;
+    for (int i = 0; i < QUERY_COUNT; ++i)
+    {
+        if (i % 2)
+        {
+            callbacks.push_back(pool.AsyncQuery("SELECT 1").WithCallback(
+                [&invoked](DATABASE::QueryResult result) { invoked += result ? 0 : 1; }));
+        }
+        else
+        {
+            auto* stmt = new DATABASE::PreparedStatement<IdleConnection>(0, 0);
+            callbacks.push_back(pool.AsyncQuery(stmt).WithPreparedCallback(
+                [&invoked](DATABASE::PreparedQueryResult result) { invoked += result ? 0 : 1; }));
+        }
+    }
+
+    //和逻辑线程一样轮询 直到所有回调都执行
+    std::vector<bool> done(callbacks.size(), false);
+    for (std::size_t remaining = callbacks.size(); remaining; )
+    {
+        for (std::size_t i = 0; i < callbacks.size(); ++i)
+        {
+            if (!done[i] && callbacks[i].InvokeIfReady())
+            {
+                done[i] = true;
+                --remaining;
+            }
+        }
+    }
+
+    std::cout << "callbacks invoked " << invoked << "/" << QUERY_COUNT << std::endl;
+    pool.close();
+    return invoked == QUERY_COUNT ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+#include "../Threading/LockFreeQueue.h"
+#include "../Threading/ProducerConsumerQueue.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static bool failed = false;
+
+//多个生产者和消费者同时收发 检查每个元素只被取出一次 返回每秒处理的元素数
+template <typename Queue>
+double bench(Queue& queue, int producers, int consumers, uint64_t countPerProducer)
+{
+    std::atomic<uint64_t> received(0);
+    std::atomic<uint64_t> sum(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < consumers; ++i)
+    {
+        threads.push_back(std::thread([&](){
+            uint64_t v;
+            uint64_t localSum = 0;
+            uint64_t localCount = 0;
+            while (queue.get(v))
+            {
+                localSum += v;
+                ++localCount;
+            }
+
+            sum += localSum;
+            received += localCount;
+        }));
+    }
+
+    std::vector<std::thread> producerThreads;
+    for (int i = 0; i < producers; ++i)
+    {
+        producerThreads.push_back(std::thread([&, i](){
+            for (uint64_t j = 0; j < countPerProducer; ++j)
+                queue.push(uint64_t(i) * countPerProducer + j);
+        }));
+    }
+
+    for (auto& t : producerThreads)
+        t.join();
+
+    //等消费者取完再停止 stop会丢弃剩下的元素
+    while (queue.size())
+        std::this_thread::yield();
+
+    queue.stop();
+    for (auto& t : threads)
+        t.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t total = producers * countPerProducer;
+    uint64_t expected = total * (total - 1) / 2;
+    if (received != total || sum != expected)
+    {
+        std::cout << "ERROR received " << received << "/" << total << std::endl;
+        failed = true;
+    }
+
+    return total / seconds;
+}
+
+//计数存活对象 检查stop之后没有泄漏
+struct Tracked
+{
+    Tracked() { ++alive; }
+    ~Tracked() { --alive; }
+
+    static std::atomic<int> alive;
+};
+
+std::atomic<int> Tracked::alive(0);
+
+//生产者和stop同时进行 队列接收的指针由stop释放 拒绝的由调用者释放 最后都不能剩下
+template <typename Queue>
+void stopWhilePushing(Queue& queue, const char* name)
+{
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; ++i)
+    {
+        producers.push_back(std::thread([&](){
+            for (int j = 0; j < 20000; ++j)
+            {
+                Tracked* v = new Tracked();
+                if (!queue.push(v))
+                    delete v;
+            }
+        }));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    queue.stop();
+    for (auto& t : producers)
+        t.join();
+
+    Tracked* v = new Tracked();
+    if (queue.push(v))
+    {
+        std::cout << "ERROR " << name << " accepted a push after stop" << std::endl;
+        failed = true;
+    }
+    delete v;
+
+    if (Tracked::alive != 0)
+    {
+        std::cout << "ERROR " << name << " leaked " << Tracked::alive << " elements pushed around stop" << std::endl;
+        failed = true;
+        Tracked::alive = 0;
+    }
+}
+
+int main()
+{
+    const uint64_t count = 200000;
+
+    for (auto [producers, consumers] : { std::pair(1, 1), std::pair(4, 1), std::pair(4, 4), std::pair(8, 8) })
+    {
+        THREADING::ProducerConsumerQueue<uint64_t> mutexQueue;
+        double mutexRate = bench(mutexQueue, producers, consumers, count);
+
+        THREADING::LockFreeQueue<uint64_t> lockFreeQueue(4096);
+        double lockFreeRate = bench(lockFreeQueue, producers, consumers, count);
+
+        std::cout << producers << " producers " << consumers << " consumers: "
+            << "ProducerConsumerQueue " << uint64_t(mutexRate) << " ops/s, "
+            << "LockFreeQueue " << uint64_t(lockFreeRate) << " ops/s" << std::endl;
+    }
+
+    THREADING::ProducerConsumerQueue<Tracked*> mutexQueue;
+    stopWhilePushing(mutexQueue, "ProducerConsumerQueue");
+    THREADING::LockFreeQueue<Tracked*> lockFreeQueue(4096);
+    stopWhilePushing(lockFreeQueue, "LockFreeQueue");
+
+    return failed ? 1 : 0;
+}
@@ -35,6 +35,7 @@ public:
         UTIL::MessageBuffer msg(readBuf.getActiveSize());
         msg.write(readBuf.getWritePoint(), readBuf.getActiveSize());
         readBuf.readCommit(readBuf.getActiveSize());
+        consumeInboundPackets(1);
         this->queuePacket(std::move(msg));
         asyncRead();
     }
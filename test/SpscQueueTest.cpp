@@ -0,0 +1,113 @@
+#include "../Threading/LockFreeQueue.h"
+#include "../Threading/ProducerConsumerQueue.h"
+#include "../Threading/SpscQueue.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#define BATCH_SIZE 64
+
+static bool failed = false;
+
+//一个生产者一个消费者 检查顺序和总和 返回每秒处理的元素数
+template <typename Queue>
+double bench(Queue& queue, uint64_t count)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t sum = 0;
+    bool ordered = true;
+    std::thread consumer([&](){
+        uint64_t v;
+        for (uint64_t i = 0; i < count && queue.get(v); ++i)
+        {
+            ordered = ordered && v == i;
+            sum += v;
+        }
+    });
+
+    for (uint64_t i = 0; i < count; ++i)
+        queue.push(uint64_t(i));
+
+    consumer.join();
+    queue.stop();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!ordered || sum != count * (count - 1) / 2)
+    {
+        std::cout << "ERROR wrong order or sum" << std::endl;
+        failed = true;
+    }
+
+    return count / seconds;
+}
+
+//批量放入和取出 每批只发布一次位置
+double benchBatch(THREADING::SpscQueue<uint64_t>& queue, uint64_t count)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t sum = 0;
+    std::thread consumer([&](){
+        std::vector<uint64_t> batch;
+        uint64_t received = 0;
+        while (received < count)
+        {
+            batch.clear();
+            if (!queue.tryGet(batch, BATCH_SIZE))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            for (uint64_t v : batch)
+                sum += v;
+            received += batch.size();
+        }
+    });
+
+    std::vector<uint64_t> batch;
+    for (uint64_t i = 0; i < count; i += BATCH_SIZE)
+    {
+        batch.clear();
+        for (uint64_t j = i; j < i + BATCH_SIZE && j < count; ++j)
+            batch.push_back(j);
+        queue.push(batch.begin(), batch.end());
+    }
+
+    consumer.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (sum != count * (count - 1) / 2)
+    {
+        std::cout << "ERROR wrong sum" << std::endl;
+        failed = true;
+    }
+
+    return count / seconds;
+}
+
+int main()
+{
+    const uint64_t count = 2000000;
+
+    THREADING::ProducerConsumerQueue<uint64_t> mutexQueue;
+    std::cout << "ProducerConsumerQueue " << uint64_t(bench(mutexQueue, count)) << " ops/s" << std::endl;
+
+    THREADING::LockFreeQueue<uint64_t> lockFreeQueue(4096);
+    std::cout << "LockFreeQueue " << uint64_t(bench(lockFreeQueue, count)) << " ops/s" << std::endl;
+
+    THREADING::SpscQueue<uint64_t> spscQueue(4096);
+    std::cout << "SpscQueue " << uint64_t(bench(spscQueue, count)) << " ops/s" << std::endl;
+
+    //消费者取空之后在eventfd上睡眠 不占cpu
+    THREADING::SpscQueue<uint64_t> eventQueue(4096, true);
+    std::cout << "SpscQueue eventfd " << uint64_t(bench(eventQueue, count)) << " ops/s" << std::endl;
+
+    THREADING::SpscQueue<uint64_t> batchQueue(4096);
+    std::cout << "SpscQueue batch " << uint64_t(benchBatch(batchQueue, count)) << " ops/s" << std::endl;
+
+    return failed ? 1 : 0;
+}
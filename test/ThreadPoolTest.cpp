@@ -1,35 +1,329 @@
+#include "../Threading/Future.h"
+#include "../Threading/ParallelAlgorithm.h"
+#include "../Threading/TaskGraph.h"
 #include "../Threading/ThreadPool.h"
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+static bool failed = false;
+
+static void check(bool ok, std::string const& what)
+{
+    if (!ok)
+    {
+        std::cout << "ERROR " << what << std::endl;
+        failed = true;
+    }
+}
 
 
 class Test
 {
 public:
-    Test()
-    {}
-
     void operator()()
     {
-        std::cout << "count_ = "<<++count_ << std::endl;
+        ++count_;
     }
-private:
+
     static std::atomic_int32_t count_;
 };
 
 
 std::atomic_int32_t Test::count_ = 0;
 
+
+//在任务里面继续spawn子任务 wait的时候当前线程也会执行任务
+long parallelSum(THREADING::ThreadPool& pool, const std::vector<long>& values, std::size_t begin, std::size_t end)
+{
+    if (end - begin <= 1000)
+    {
+        return std::accumulate(values.begin() + begin, values.begin() + end, 0L);
+    }
+
+    std::size_t mid = begin + (end - begin) / 2;
+    long left = 0;
+    long right = 0;
+
+    THREADING::TaskGroup group;
+    pool.spawn(group, [&](){ left = parallelSum(pool, values, begin, mid); });
+    pool.spawn(group, [&](){ right = parallelSum(pool, values, mid, end); });
+    pool.wait(group);
+
+    return left + right;
+}
+
+//子任务抛出的第一个异常在wait里重新抛出
+void testTaskGroup(THREADING::ThreadPool& pool)
+{
+    THREADING::TaskGroup group;
+    std::atomic<int> ran(0);
+    for (int i = 0; i < 100; ++i)
+    {
+        pool.spawn(group, [&ran, i]() {
+            ++ran;
+            if (i == 50)
+                throw std::runtime_error("task 50");
+        });
+    }
+
+    bool thrown = false;
+    try
+    {
+        pool.wait(group);
+    }
+    catch (std::runtime_error const& e)
+    {
+        thrown = std::string(e.what()) == "task 50";
+    }
+
+    check(thrown, "TaskGroup did not rethrow the task exception");
+    check(ran == 100, "TaskGroup ran " + std::to_string(ran) + "/100 tasks");
+}
+
+//then的结果和异常 whenAll按输入的顺序 whenAny返回先完成的那个
+void testFuture(THREADING::ThreadPool& pool)
+{
+    auto count = THREADING::async(pool, [](){ return 20; })
+        .then([](int& v){ return v * 2 + 2; })
+        .then([](int& v){ return std::to_string(v); });
+    check(count.get() == "42", "then chain returned " + count.get());
+
+    std::atomic<bool> continued(false);
+    auto broken = THREADING::async(pool, []() -> int { throw std::runtime_error("boom"); })
+        .then([&continued](int& v){ continued = true; return v; });
+    bool thrown = false;
+    try
+    {
+        broken.get();
+    }
+    catch (std::runtime_error const& e)
+    {
+        thrown = std::string(e.what()) == "boom";
+    }
+    check(thrown && !continued, "exception did not skip then and reach get");
+
+    //后面的先完成 结果仍然按输入的顺序
+    std::vector<THREADING::Future<int>> futures;
+    for (int i = 0; i < 8; ++i)
+    {
+        futures.push_back(THREADING::async(pool, [i]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2 * (8 - i)));
+            return i;
+        }));
+    }
+    std::vector<int> all = THREADING::whenAll(futures).get();
+    std::vector<int> expected(8);
+    std::iota(expected.begin(), expected.end(), 0);
+    check(all == expected, "whenAll results are not in input order");
+
+    futures.push_back(THREADING::async(pool, []() -> int { throw std::runtime_error("all"); }));
+    thrown = false;
+    try
+    {
+        THREADING::whenAll(futures).get();
+    }
+    catch (std::runtime_error const&)
+    {
+        thrown = true;
+    }
+    check(thrown, "whenAll did not propagate the exception");
+
+    //第一个睡得比第二个久得多 先完成的是第二个
+    //不用标志位互相等待 等待的线程可能会自己执行第一个任务
+    std::vector<THREADING::Future<int>> race;
+    race.push_back(THREADING::async(pool, []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return 0;
+    }));
+    race.push_back(THREADING::async(pool, [](){ return 1; }));
+    std::size_t first = THREADING::whenAny(race).get();
+    check(first == 1, "whenAny returned " + std::to_string(first));
+    THREADING::whenAll(race).get();
+
+    //promise在线程池以外完成 非工作线程的get也要被唤醒
+    auto state = std::make_shared<THREADING::detail::SharedState<int>>(&pool);
+    std::thread outside([state]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        state->setValue(7);
+    });
+    check(THREADING::Future<int>(state).get() == 7, "future completed outside the pool");
+    outside.join();
+}
+
+//一帧的世界更新 地图之间互不依赖 可以并行 全部更新完之后再统一广播
+void testTaskGraph(THREADING::ThreadPool& pool)
+{
+    std::atomic<int> sequence(0);
+    std::atomic<int> updated(0);
+    int sessionsAt = -1;
+    int broadcastAt = -1;
+    int broadcastSaw = -1;
+    std::vector<int> updateAt(4, -1);
+
+    THREADING::TaskGraph graph;
+    auto sessions = graph.add([&](){ sessionsAt = sequence++; });
+    auto broadcast = graph.add([&](){ broadcastAt = sequence++; broadcastSaw = updated; });
+    for (int map = 0; map < 4; ++map)
+    {
+        auto update = graph.add([&, map](){ updateAt[map] = sequence++; ++updated; });
+        graph.precede(sessions, update);
+        graph.precede(update, broadcast);
+    }
+
+    for (int tick = 0; tick < 100; ++tick)
+    {
+        sequence = 0;
+        updated = 0;
+        graph.run(pool).get();
+
+        bool ordered = sessionsAt == 0 && broadcastAt == 5 && broadcastSaw == 4;
+        for (int at : updateAt)
+            ordered = ordered && at > sessionsAt && at < broadcastAt;
+        if (!ordered)
+        {
+            check(false, "TaskGraph ran out of dependency order on tick " + std::to_string(tick));
+            break;
+        }
+    }
+
+    //失败的节点之后的节点不执行 异常从run的future里抛出
+    THREADING::TaskGraph failing;
+    std::atomic<bool> after(false);
+    auto thrower = failing.add([](){ throw std::runtime_error("node"); });
+    auto successor = failing.add([&after](){ after = true; });
+    failing.precede(thrower, successor);
+    bool thrown = false;
+    try
+    {
+        failing.run(pool).get();
+    }
+    catch (std::runtime_error const&)
+    {
+        thrown = true;
+    }
+    check(thrown && !after, "TaskGraph did not stop at the failed node");
+
+    THREADING::TaskGraph cyclic;
+    auto a = cyclic.add([](){});
+    auto b = cyclic.add([](){});
+    cyclic.precede(a, b);
+    cyclic.precede(b, a);
+    thrown = false;
+    try
+    {
+        cyclic.run(pool);
+    }
+    catch (std::logic_error const&)
+    {
+        thrown = true;
+    }
+    check(thrown, "TaskGraph did not detect the cycle");
+}
+
+void testParallelAlgorithm(THREADING::ThreadPool& pool)
+{
+    std::vector<long> values(1000000);
+    std::iota(values.begin(), values.end(), 0L);
+    long expected = long(values.size()) * long(values.size() - 1) / 2;
+    check(parallelSum(pool, values, 0, values.size()) == expected, "parallelSum");
+
+    //同样的求和用parallelReduce 自动选择粒度 调用线程也参与计算
+    long sum = THREADING::parallelReduce(pool, std::size_t(0), values.size(), 0L,
+        [&](std::size_t begin, std::size_t end, long init){ return std::accumulate(values.begin() + begin, values.begin() + end, init); },
+        [](long left, long right){ return left + right; });
+    check(sum == expected, "parallelReduce");
+
+    std::vector<std::atomic<int>> visits(100000);
+    THREADING::parallelFor(pool, std::size_t(0), visits.size(), [&](std::size_t i){ ++visits[i]; });
+    check(std::all_of(visits.begin(), visits.end(), [](std::atomic<int> const& v){ return v == 1; }),
+        "parallelFor did not visit every index exactly once");
+
+    std::vector<uint32_t> random(500000);
+    std::mt19937 generator(1);
+    for (auto& v : random)
+        v = generator();
+    std::vector<uint32_t> sorted = random;
+    std::sort(sorted.begin(), sorted.end());
+    THREADING::parallelSort(pool, random.begin(), random.end());
+    check(random == sorted, "parallelSort");
+
+    std::vector<int> descending(5000);
+    std::iota(descending.begin(), descending.end(), 0);
+    THREADING::parallelSort(pool, descending.begin(), descending.end(), std::greater<>(), 10);
+    check(std::is_sorted(descending.begin(), descending.end(), std::greater<>()), "parallelSort with comparator");
+
+    bool thrown = false;
+    try
+    {
+        THREADING::parallelFor(pool, 0, 1000, [](int i){ if (i == 999) throw std::runtime_error("last"); }, 10);
+    }
+    catch (std::runtime_error const&)
+    {
+        thrown = true;
+    }
+    check(thrown, "parallelFor did not rethrow");
+}
+
+//游戏主循环这样的非工作线程调用parallelFor 工作线程都被占住的时候调用线程自己要把所有块执行完
+void testCallerHelps(THREADING::ThreadPool& pool)
+{
+    const int count = 4096;
+    std::atomic<int> done(0);
+    std::atomic<int> blocked(0);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+
+    //占住工作线程的任务引用了这里的局部变量 返回之前要等它们结束
+    THREADING::TaskGroup blockers;
+    for (std::size_t i = 0; i < pool.getThreadCount(); ++i)
+    {
+        pool.spawn(blockers, [&]() {
+            ++blocked;
+            while (done < count && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::yield();
+        });
+    }
+
+    while (blocked != int(pool.getThreadCount()))
+        std::this_thread::yield();
+
+    auto caller = std::this_thread::get_id();
+    std::atomic<int> onCaller(0);
+    THREADING::parallelFor(pool, 0, count, [&](int) {
+        if (std::this_thread::get_id() == caller)
+            ++onCaller;
+        ++done;
+    });
+    pool.wait(blockers);
+
+    check(onCaller == count, "caller ran " + std::to_string(onCaller) + "/" + std::to_string(count) + " items while workers were busy");
+}
+
 int main()
 {
-    THREADING::ThreadPool pool(2);
-    
-    for (int i = 0; i < 100000; ++i) 
+    THREADING::ThreadPool pool(4);
+
+    testTaskGroup(pool);
+    testFuture(pool);
+    testTaskGraph(pool);
+    testParallelAlgorithm(pool);
+    testCallerHelps(pool);
+
+    for (int i = 0; i < 100000; ++i)
     {
         pool.post(Test());
     }
 
     pool.join();    //等到所有任务完成之后退出
-    return 0;
-}
+    check(Test::count_ == 100000, "join returned before all posted tasks ran");
 
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,72 @@
+#include "../Threading/TimerScheduler.h"
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+
+int main()
+{
+    using namespace std::chrono;
+
+    THREADING::ThreadPool pool(2);
+    THREADING::TimerScheduler scheduler(&pool);
+
+    auto start = steady_clock::now();
+    auto elapsed = [start]() { return duration_cast<milliseconds>(steady_clock::now() - start).count(); };
+
+    //延时任务 在线程池里执行
+    std::atomic<int> delayed(0);
+    scheduler.scheduleAfter(milliseconds(50), [&]() {
+        ++delayed;
+        std::cout << "delayed task at " << elapsed() << "ms" << std::endl;
+    });
+
+    //被取消的任务不会执行
+    std::atomic<bool> cancelledRan(false);
+    auto cancelled = scheduler.scheduleAfter(milliseconds(60), [&]() {
+        cancelledRan = true;
+        std::cout << "ERROR cancelled task executed" << std::endl;
+    });
+    cancelled.cancel();
+
+    //周期任务 每次执行的时间不会越来越晚
+    std::atomic<int> ticks(0);
+    auto periodic = scheduler.schedulePeriodic(milliseconds(20), [&]() {
+        std::cout << "tick " << ++ticks << " at " << elapsed() << "ms" << std::endl;
+    });
+
+    //在io_context里执行 比如放到某个NetworkThread
+    boost::asio::io_context ioc;
+    auto work = boost::asio::make_work_guard(ioc);
+    std::thread ioThread([&ioc]() { ioc.run(); });
+    std::atomic<int> ioTasks(0);
+    scheduler.scheduleAfter(ioc, milliseconds(80), [&]() {
+        ++ioTasks;
+        std::cout << "io_context task at " << elapsed() << "ms" << std::endl;
+    });
+
+    std::this_thread::sleep_for(milliseconds(210));
+    periodic.cancel();
+    std::this_thread::sleep_for(milliseconds(50));
+    int ticksAfterCancel = ticks;
+    std::cout << "ticks = " << ticksAfterCancel << std::endl;
+
+    //取消之后不会再执行
+    std::this_thread::sleep_for(milliseconds(60));
+
+    scheduler.stop();
+    work.reset();
+    ioThread.join();
+    pool.join();
+
+    //机器很忙的时候周期任务会跳过错过的次数 只要求至少执行了几次
+    bool failed = delayed != 1 || cancelledRan || ioTasks != 1 || ticksAfterCancel < 3 || ticks != ticksAfterCancel;
+    if (failed)
+        std::cout << "ERROR delayed " << delayed << " io_context " << ioTasks << " ticks " << ticks << std::endl;
+
+    return failed ? 1 : 0;
+}